@@ -0,0 +1,77 @@
+#include "oktal/octree/CellGrid.hpp"
+#include "oktal/octree/CellOctree.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using oktal::CellOctree, oktal::CellGrid, oktal::AdjacencyOffset;
+
+namespace {
+
+const std::vector<AdjacencyOffset> neighborhood = {
+    {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+// Measures the setup of a uniform CellGrid with a 6-neighborhood on the given
+// refinement level, best of several repetitions
+void benchmark(std::size_t refinementLevel, std::size_t repetitions) {
+  using Clock = std::chrono::steady_clock;
+  const auto octree = CellOctree::createUniformGrid(refinementLevel);
+
+  double bestSeconds = std::numeric_limits<double>::max();
+  std::size_t numCells = 0;
+  for (std::size_t rep = 0; rep < repetitions; ++rep) {
+    const auto start = Clock::now();
+    const auto cells =
+        CellGrid::create(octree).neighborhood(neighborhood).build();
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    bestSeconds = std::min(bestSeconds, elapsed.count());
+    numCells = cells.size();
+  }
+
+  std::cout << std::format(
+      "level {}: {} cells, {} threads, setup {:.3f} s ({:.1f} ns/cell)\n",
+      refinementLevel, numCells, oktal::parallel::numberOfThreads(),
+      bestSeconds, 1e9 * bestSeconds / static_cast<double>(numCells));
+}
+
+inline void run(const std::span<char *> &args) {
+  // Default: level 7 (2M cells) and level 8 (16M cells)
+  std::vector<std::size_t> levels{7, 8};
+  std::size_t repetitions = 3;
+  if (args.size() > 1) {
+    levels.clear();
+    for (const char *arg : args.subspan(1)) {
+      levels.push_back(std::stoul(arg));
+    }
+  }
+  if (const char *reps = std::getenv("OKTAL_BENCHMARK_REPETITIONS")) {
+    repetitions = std::max(1uz, std::stoul(reps));
+  }
+
+  for (const auto level : levels) {
+    benchmark(level, repetitions);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  try {
+    run({argv, std::span<char *>::size_type(argc)});
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    std::exit(EXIT_FAILURE);
+  } catch (...) {
+    std::cerr << "Unknown error";
+    std::exit(EXIT_FAILURE);
+  }
+  return EXIT_SUCCESS;
+}
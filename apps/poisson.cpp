@@ -2,21 +2,40 @@
 #include "oktal/io/VtkExport.hpp"
 #include "oktal/octree/CellGrid.hpp"
 #include "oktal/octree/CellOctree.hpp"
+#include "oktal/octree/GridHierarchy.hpp"
+#include "oktal/octree/Stencil.hpp"
+#include "oktal/solver/DenseStencil.hpp"
+#include "oktal/solver/Krylov.hpp"
+#include "oktal/solver/Multigrid.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <cstdlib>
+#include <format>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <span>
 #include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 using oktal::CellOctree, oktal::CellGrid;
 using namespace oktal;
 
-const std::vector<Vec<std::ptrdiff_t, 3>> neighboorhood = {
-    {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+using Neighborhood =
+    Stencil<Offset<-1, 0, 0>, Offset<1, 0, 0>, Offset<0, -1, 0>,
+            Offset<0, 1, 0>, Offset<0, 0, -1>, Offset<0, 0, 1>>;
 namespace {
 
 void PrintUsage(const char *name) {
   std::cerr << "Usage: " << name
-            << "<refinementLevel> <max-iterations> <epsilon> <output-file> \n";
+            << "<refinementLevel> <max-iterations> <epsilon> <output-file> "
+               "[--solver=jacobi|mg|cg|bicgstab] [--cycle=V|W|F] "
+               "[--precond=none|jacobi|ssor|mg] [--threads=N] "
+               "[--kernel=dense|generic]\n";
 }
 
 double eval_phi(const Vec3D &pos) {
@@ -24,96 +43,392 @@ double eval_phi(const Vec3D &pos) {
          std::cos(M_PI * pos[2]);
 }
 
-void initialise(const CellGrid &cells, std::vector<double> &u,
-                std::vector<double> &f) {
-  for (auto cell : cells) {
-    const Vec3D center = cell.center();
+void initialise(const CellGrid &cells, std::span<double> u,
+                std::span<double> f) {
+  const auto x = cells.centers(0);
+  const auto y = cells.centers(1);
+  const auto z = cells.centers(2);
+  for (size_t cell = 0; cell < cells.size(); ++cell) {
+    const Vec3D center{x[cell], y[cell], z[cell]};
     f[cell] = 3 * M_PI * M_PI * eval_phi(center);
     u[cell] = eval_phi(center);
   }
 }
 
-double compute_residual_norm(const CellGrid &cells,
-                             const std::vector<double> &u,
-                             const std::vector<double> &f,
-                             std::vector<double> &residual, const double h) {
-  const size_t num_cells = cells.size();
+// Smallest number of cells the Jacobi sweep hands to a thread
+constexpr size_t MIN_CELLS_PER_THREAD = 4096;
+
+// Cells of the Jacobi sweep as one index space: the cells of the interior
+// ranges, followed by the boundary cells
+struct SweepCells {
+  // Start of every interior range within the index space, then the total
+  std::vector<size_t> range_offsets;
+  // Boundary cells and the number of neighbors before their first missing
+  // one, which are the only ones their residual sums up
+  std::vector<std::pair<size_t, size_t>> boundary;
+
+  explicit SweepCells(const CellGrid &cells) {
+    range_offsets.push_back(0);
+    for (const auto range : cells.interiorRanges()) {
+      range_offsets.push_back(range_offsets.back() + range.size());
+    }
+    for (const auto &group : cells.boundaryGroups()) {
+      for (const size_t cell : group.cells) {
+        boundary.emplace_back(cell, group.missingSlots.front());
+      }
+    }
+  }
+
+  [[nodiscard]] size_t numInterior() const { return range_offsets.back(); }
+
+  [[nodiscard]] size_t size() const { return numInterior() + boundary.size(); }
+};
+
+// Writes the Jacobi update of u to u_tmp and the residual of u to residual
+// in a single parallel pass; returns the Euclidean norm of the residual
+// divided by the number of cells. Boundary cells keep their values.
+// NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
+double jacobi_sweep(const StencilGrid<Neighborhood> &stencil_grid,
+                    const SweepCells &sweep_cells, std::span<const double> u,
+                    std::span<double> u_tmp, std::span<const double> f,
+                    std::span<double> residual, const double h) {
+  const CellGrid &cells = stencil_grid.grid();
+  const auto ranges = cells.interiorRanges();
+  const double h2 = h * h;
+  const size_t num_threads =
+      parallel::threadsFor(sweep_cells.size(), MIN_CELLS_PER_THREAD);
+  std::vector<double> partial_sums(num_threads, 0.0);
+
+  parallel::forChunks(
+      sweep_cells.size(),
+      [&](size_t begin, size_t end, size_t chunk) {
+        double sum_res = 0.0;
+        // Range holding the first interior cell of the chunk
+        size_t r = static_cast<size_t>(
+            std::ranges::upper_bound(sweep_cells.range_offsets, begin) -
+            sweep_cells.range_offsets.begin() - 1);
+        const size_t interior_end = std::min(end, sweep_cells.numInterior());
+        for (size_t i = begin; i < interior_end;) {
+          const size_t first =
+              ranges[r].begin + (i - sweep_cells.range_offsets[r]);
+          const size_t last =
+              ranges[r].begin +
+              (std::min(interior_end, sweep_cells.range_offsets[r + 1]) -
+               sweep_cells.range_offsets[r]);
+          for (size_t cell = first; cell < last; ++cell) {
+            double neighbor_sum = 0.0;
+            for (const auto nbIdx : stencil_grid.neighbors(cell)) {
+              neighbor_sum += u[nbIdx];
+            }
+            u_tmp[cell] = (h2 * f[cell] + neighbor_sum) / 6.0;
+            residual[cell] = f[cell] + ((-6.0 * u[cell] + neighbor_sum) / h2);
+            sum_res += residual[cell] * residual[cell];
+          }
+          i += last - first;
+          ++r;
+        }
+        for (size_t i = std::max(begin, sweep_cells.numInterior()); i < end;
+             ++i) {
+          const auto [cell, available] =
+              sweep_cells.boundary[i - sweep_cells.numInterior()];
+          double neighbor_sum = 0.0;
+          for (const auto nbIdx :
+               stencil_grid.neighbors(cell).first(available)) {
+            neighbor_sum += u[nbIdx];
+          }
+          u_tmp[cell] = u[cell];
+          residual[cell] = f[cell] + ((-6.0 * u[cell] + neighbor_sum) / h2);
+          sum_res += residual[cell] * residual[cell];
+        }
+        partial_sums[chunk] = sum_res;
+      },
+      num_threads);
+
+  // Adding the chunks in order keeps the norm independent of the timing
   double sum_res = 0.0;
-  for (auto cell : cells) {
-    double neighbor_sum = 0.0;
-    for (const auto &offset : neighboorhood) {
-      const size_t nbIdx = cells.neighborIndices(offset)[cell];
-      if (nbIdx == CellGrid::NO_NEIGHBOR) {
-        break;
+  for (const double partial : partial_sums) {
+    sum_res += partial;
+  }
+  return std::sqrt(sum_res) / static_cast<double>(cells.size());
+}
+
+// Jacobi sweep on dense copies of the fields of a grid that covers a whole
+// level; the interior runs the vectorised kernel, and the boundary cells get
+// the residual of jacobi_sweep
+struct DenseJacobi {
+  UniformLevelView view;
+  std::vector<double> u;
+  std::vector<double> u_tmp;
+  std::vector<double> f;
+  std::vector<double> residual;
+  // Dense indices of the boundary cells and their neighbors in CSR form;
+  // only the cells of the outermost layer of the cube lack neighbors
+  std::vector<size_t> boundary_cells;
+  std::vector<size_t> boundary_start;
+  std::vector<size_t> boundary_neighbors;
+
+  DenseJacobi(UniformLevelView level_view,
+              const StencilGrid<Neighborhood> &stencil_grid,
+              const SweepCells &sweep_cells, std::span<const double> u_cells,
+              std::span<const double> f_cells)
+      : view(std::move(level_view)), u(view.size()), u_tmp(view.size()),
+        f(view.size()), residual(view.size(), 0.0) {
+    view.gather(u_cells, std::span<double>(u));
+    view.gather(u_cells, std::span<double>(u_tmp));
+    view.gather(f_cells, std::span<double>(f));
+    boundary_start.push_back(0);
+    for (const auto &[cell, available] : sweep_cells.boundary) {
+      boundary_cells.push_back(view.denseIndexOf(cell));
+      for (const auto nbIdx : stencil_grid.neighbors(cell).first(available)) {
+        boundary_neighbors.push_back(view.denseIndexOf(nbIdx));
       }
-      neighbor_sum += u[nbIdx];
+      boundary_start.push_back(boundary_neighbors.size());
     }
-    if (cell.isValid()) {
-      residual[cell] = f[cell] + ((-6.0 * u[cell] + neighbor_sum) / (h * h));
+  }
+
+  // Same contract as jacobi_sweep on the dense fields
+  double sweep(std::span<const double> u_dense, std::span<double> u_tmp_dense,
+               const double h) {
+    const double h2 = h * h;
+    const double interior_sum =
+        solver::denseJacobiSweep(view.extent(), h, u_dense, u_tmp_dense, f,
+                                 residual);
+    const size_t num_boundary = boundary_cells.size();
+    const size_t num_threads =
+        parallel::threadsFor(num_boundary, MIN_CELLS_PER_THREAD);
+    std::vector<double> partial_sums(num_threads, 0.0);
+    parallel::forChunks(
+        num_boundary,
+        [&](size_t begin, size_t end, size_t chunk) {
+          double sum_res = 0.0;
+          for (size_t i = begin; i < end; ++i) {
+            const size_t cell = boundary_cells[i];
+            double neighbor_sum = 0.0;
+            for (size_t k = boundary_start[i]; k < boundary_start[i + 1];
+                 ++k) {
+              neighbor_sum += u_dense[boundary_neighbors[k]];
+            }
+            residual[cell] =
+                f[cell] + ((-6.0 * u_dense[cell] + neighbor_sum) / h2);
+            sum_res += residual[cell] * residual[cell];
+          }
+          partial_sums[chunk] = sum_res;
+        },
+        num_threads);
+
+    double sum_res = interior_sum;
+    for (const double partial : partial_sums) {
+      sum_res += partial;
     }
-    sum_res += residual[cell] * residual[cell];
+    return std::sqrt(sum_res) / static_cast<double>(view.size());
   }
-  const double norm = std::sqrt(sum_res) / static_cast<double>(num_cells);
-  return norm;
-}
+};
 
 // NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
 void solve_poisson(const size_t refinement_level, const double epsilon,
-                   const unsigned int max_iters, std::string &output_file) {
+                   const unsigned int max_iters, std::string &output_file,
+                   const bool dense_kernels) {
   auto cell_octree = CellOctree::createUniformGrid(refinement_level);
-  auto cell_grid =
-      CellGrid::create(cell_octree).neighborhood(neighboorhood).build();
-  const size_t numCells = cell_grid.size();
+  auto stencil_grid =
+      CellGrid::create(cell_octree).geometryCache().build(Neighborhood{});
+  const CellGrid &cell_grid = stencil_grid.grid();
   const double h = cell_octree->geometry().dx(refinement_level);
-  std::vector<double> f(numCells);
-  std::vector<double> u(numCells, 0.0);
-  std::vector<double> u_tmp(numCells, 0.0);
-  std::vector<double> residual(numCells, 0.0);
+  const auto u_field = stencil_grid.addField<double>("u");
+  const auto u_tmp_field = stencil_grid.addField<double>("u_tmp");
+  const auto f_field = stencil_grid.addField<double>("f");
+  const auto residual_field = stencil_grid.addField<double>("residual");
+  std::span<double> u = stencil_grid.field(u_field);
+  std::span<double> u_tmp = stencil_grid.field(u_tmp_field);
+  const std::span<double> f = stencil_grid.field(f_field);
+  const std::span<double> residual = stencil_grid.field(residual_field);
 
   initialise(cell_grid, u, f);
 
+  const SweepCells sweep_cells(cell_grid);
+  // A grid covering a whole level iterates on dense copies of the fields.
+  // The squared residuals are added in another order, so the norms agree
+  // with the generic sweep up to rounding only.
+  std::optional<DenseJacobi> dense;
+  if (dense_kernels) {
+    if (auto view = cell_grid.uniformLevel()) {
+      dense.emplace(std::move(*view), stencil_grid, sweep_cells, u, f);
+      u = dense->u;
+      u_tmp = dense->u_tmp;
+    }
+  }
+  const auto sweep = [&]() {
+    return dense ? dense->sweep(u, u_tmp, h)
+                 : jacobi_sweep(stencil_grid, sweep_cells, u, u_tmp, f,
+                                residual, h);
+  };
   int iter = 0;
   double l2_norm = 100;
 
+  // A sweep yields the residual of the iterate it starts from, so the first
+  // sweep only contributes its update and the last one only its residual
+  if (max_iters > 0) {
+    static_cast<void>(sweep());
+  }
   for (unsigned int i = 0; i < max_iters; ++i) {
-    for (auto cell : cell_grid) {
-      bool isBoundary = false;
-      double neighborSum = 0;
-
-      for (const auto &offset : neighboorhood) {
-        const size_t nbIdx = cell_grid.neighborIndices(offset)[cell];
-        if (nbIdx == CellGrid::NO_NEIGHBOR) {
-          isBoundary = true;
-          break;
-        }
-        neighborSum += u[nbIdx];
-      }
-      if (!isBoundary) {
-        u_tmp[cell] = (h * h * f[cell] + neighborSum) / 6.0;
-      } else {
-        u_tmp[cell] = u[cell];
-      }
-    }
-    u.swap(u_tmp);
-    l2_norm = compute_residual_norm(cell_grid, u, f, residual, h);
+    std::swap(u, u_tmp);
+    l2_norm = sweep();
     if (l2_norm < epsilon) {
       break;
     }
     iter++;
   }
+  // Unlike the interior residual of the other solvers, this norm includes
+  // the partial stencils of the boundary cells
   std::cout << "L2 residual norm : " << l2_norm
             << " and numbers of iterations required " << iter << "\n";
+  if (dense) {
+    dense->view.scatter<double>(u, stencil_grid.field(u_field));
+    dense->view.scatter<double>(dense->residual, residual);
+  } else if (u.data() != stencil_grid.field(u_field).data()) {
+    // The sweeps swap the views, so the latest iterate may live in u_tmp
+    std::ranges::copy(u, stencil_grid.field(u_field).begin());
+  }
   io::vtk::exportCellGrid(cell_grid, output_file)
-      .writeGridVector("u", u)
-      .writeGridVector("f", f)
-      .writeGridVector("residual", residual);
+      .writeField(u_field)
+      .writeField(f_field)
+      .writeField(residual_field);
+}
+// Iterates multigrid cycles on the finest level of the octree levels; the
+// iteration count refers to cycles. The boundary cells hold Dirichlet values,
+// so the reported residual covers the interior cells only.
+// NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
+void solve_poisson_multigrid(const size_t refinement_level,
+                             const double epsilon, const unsigned int max_iters,
+                             std::string &output_file, solver::Cycle cycle) {
+  auto cell_octree = CellOctree::createUniformGrid(refinement_level);
+  GridHierarchy hierarchy(CellGrid::create(cell_octree)
+                              .neighborhood(Neighborhood::offsets())
+                              .geometryCache());
+  CellGrid &cell_grid = hierarchy.grid(refinement_level);
+  const auto u_field = cell_grid.addField<double>("u");
+  const auto f_field = cell_grid.addField<double>("f");
+  const auto residual_field = cell_grid.addField<double>("residual");
+  const std::span<double> u = cell_grid.field(u_field);
+  const std::span<double> f = cell_grid.field(f_field);
+  const std::span<double> residual = cell_grid.field(residual_field);
+
+  initialise(cell_grid, u, f);
+  solver::PoissonMultigrid multigrid(hierarchy, {.cycle = cycle});
+
+  const auto num_cells = static_cast<double>(cell_grid.size());
+  int iter = 0;
+  double l2_norm = multigrid.residual(u, f, residual) / num_cells;
+  for (unsigned int i = 0; i < max_iters; ++i) {
+    multigrid.cycle(u, f);
+    l2_norm = multigrid.residual(u, f, residual) / num_cells;
+    if (l2_norm < epsilon) {
+      break;
+    }
+    iter++;
+  }
+  std::cout << "L2 interior residual norm : " << l2_norm
+            << " and numbers of iterations required " << iter << "\n";
+  for (size_t lvl = multigrid.finestLevel() + 1;
+       lvl-- > multigrid.coarsestLevel();) {
+    std::cout << std::format("Level {}: {} cells, {:.3f} ms\n", lvl,
+                             hierarchy.grid(lvl).size(),
+                             1e3 * multigrid.levelSeconds()[lvl]);
+  }
+  io::vtk::exportCellGrid(cell_grid, output_file)
+      .writeField(u_field)
+      .writeField(f_field)
+      .writeField(residual_field);
+}
+
+enum class Solver { Jacobi, Multigrid, Cg, BiCgStab };
+enum class Precond { None, Jacobi, Ssor, Multigrid };
+
+// Solves with a Krylov method on the finest level of the octree levels; only
+// the multigrid preconditioner builds the coarser levels. Like the multigrid
+// solver, it reports the residual of the interior cells.
+// NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
+void solve_poisson_krylov(const size_t refinement_level, const double epsilon,
+                          const unsigned int max_iters,
+                          std::string &output_file, Solver method,
+                          Precond precond, solver::Cycle cycle) {
+  auto cell_octree = CellOctree::createUniformGrid(refinement_level);
+  CellGridBuilder builder = CellGrid::create(cell_octree)
+                                .neighborhood(Neighborhood::offsets())
+                                .geometryCache();
+  std::optional<GridHierarchy> hierarchy;
+  std::optional<CellGrid> single_level;
+  if (precond == Precond::Multigrid) {
+    hierarchy.emplace(builder);
+  } else {
+    single_level.emplace(builder.build());
+  }
+  CellGrid &cell_grid =
+      hierarchy ? hierarchy->grid(refinement_level) : *single_level;
+  const auto u_field = cell_grid.addField<double>("u");
+  const auto f_field = cell_grid.addField<double>("f");
+  const auto residual_field = cell_grid.addField<double>("residual");
+  const std::span<double> u = cell_grid.field(u_field);
+  const std::span<double> f = cell_grid.field(f_field);
+  const std::span<double> residual = cell_grid.field(residual_field);
+
+  initialise(cell_grid, u, f);
+  const solver::PoissonOperator op(cell_grid);
+  std::optional<solver::PoissonMultigrid> multigrid;
+  std::unique_ptr<solver::Preconditioner> preconditioner;
+  switch (precond) {
+  case Precond::None:
+    preconditioner = std::make_unique<solver::IdentityPreconditioner>();
+    break;
+  case Precond::Jacobi:
+    preconditioner = std::make_unique<solver::JacobiPreconditioner>(op);
+    break;
+  case Precond::Ssor:
+    preconditioner = std::make_unique<solver::SsorPreconditioner>(op);
+    break;
+  case Precond::Multigrid:
+    // Constant prolongation is the transpose of the restriction up to a
+    // factor, which keeps the preconditioner symmetric
+    multigrid.emplace(*hierarchy, solver::MultigridOptions{
+                                      .cycle = cycle,
+                                      .prolongation = Prolongation::Constant});
+    preconditioner =
+        std::make_unique<solver::MultigridPreconditioner>(*multigrid);
+    break;
+  }
+
+  // The residual norm is reported divided by the number of cells
+  const auto num_cells = static_cast<double>(cell_grid.size());
+  const solver::KrylovOptions options{.maxIterations = max_iters,
+                                      .tolerance = epsilon * num_cells};
+  const solver::KrylovResult result =
+      method == Solver::Cg
+          ? solver::conjugateGradient(op, u, f, *preconditioner, options)
+          : solver::biCgStab(op, u, f, *preconditioner, options);
+  const double l2_norm = std::sqrt(op.residual(u, f, residual)) / num_cells;
+  std::cout << "L2 interior residual norm : " << l2_norm
+            << " and numbers of iterations required " << result.iterations
+            << "\n";
+  io::vtk::exportCellGrid(cell_grid, output_file)
+      .writeField(u_field)
+      .writeField(f_field)
+      .writeField(residual_field);
 }
 } // namespace
 int main(int argc, char **argv) {
   /*   try{
          std::span<char*> args(argc, argv);
  }*/
-  const std::span<char *> args(argv, static_cast<size_t>(argc));
+  const std::span<char *> all_args(argv, static_cast<size_t>(argc));
+  // Options start with "--", the remaining arguments are positional
+  std::vector<char *> args;
+  std::vector<std::string_view> options;
+  for (char *arg : all_args) {
+    if (std::string_view(arg).starts_with("--")) {
+      options.emplace_back(arg);
+    } else {
+      args.push_back(arg);
+    }
+  }
   if (args.size() != 5) {
     std::cerr << "Error : Invalid number of Arguments ! Expected 4 \n";
     PrintUsage(args[0]);
@@ -146,7 +461,72 @@ int main(int argc, char **argv) {
     if (outputFile.empty()) {
       throw std::invalid_argument("output file cannot be empty.\n");
     }
-    solve_poisson(refinement_level, eps, max_iter, outputFile);
+
+    Solver method = Solver::Jacobi;
+    bool dense_kernels = true;
+    Precond precond = Precond::None;
+    solver::Cycle cycle = solver::Cycle::V;
+    for (const std::string_view option : options) {
+      if (option == "--solver=jacobi") {
+        method = Solver::Jacobi;
+      } else if (option == "--solver=mg") {
+        method = Solver::Multigrid;
+      } else if (option == "--solver=cg") {
+        method = Solver::Cg;
+      } else if (option == "--solver=bicgstab") {
+        method = Solver::BiCgStab;
+      } else if (option == "--kernel=dense" || option == "--kernel=generic") {
+        dense_kernels = option == "--kernel=dense";
+      } else if (option == "--precond=none") {
+        precond = Precond::None;
+      } else if (option == "--precond=jacobi") {
+        precond = Precond::Jacobi;
+      } else if (option == "--precond=ssor") {
+        precond = Precond::Ssor;
+      } else if (option == "--precond=mg") {
+        precond = Precond::Multigrid;
+      } else if (option.starts_with("--threads=")) {
+        const std::string_view value = option.substr(10);
+        size_t num_threads = 0;
+        const auto [end, error] = std::from_chars(
+            value.data(), value.data() + value.size(), num_threads);
+        if (error != std::errc{} || end != value.data() + value.size() ||
+            num_threads == 0) {
+          throw std::invalid_argument("threads must be a positive integer \n");
+        }
+        parallel::setNumberOfThreads(num_threads);
+      } else if (option == "--cycle=V") {
+        cycle = solver::Cycle::V;
+      } else if (option == "--cycle=W") {
+        cycle = solver::Cycle::W;
+      } else if (option == "--cycle=F") {
+        cycle = solver::Cycle::F;
+      } else {
+        throw std::invalid_argument(
+            std::format("unknown option {} \n", option));
+      }
+    }
+    if (method == Solver::Cg && precond == Precond::Multigrid &&
+        cycle == solver::Cycle::F) {
+      throw std::invalid_argument(
+          "the F-cycle is not a symmetric preconditioner for cg, use "
+          "--solver=bicgstab \n");
+    }
+    switch (method) {
+    case Solver::Jacobi:
+      solve_poisson(refinement_level, eps, max_iter, outputFile,
+                    dense_kernels);
+      break;
+    case Solver::Multigrid:
+      solve_poisson_multigrid(refinement_level, eps, max_iter, outputFile,
+                              cycle);
+      break;
+    case Solver::Cg:
+    case Solver::BiCgStab:
+      solve_poisson_krylov(refinement_level, eps, max_iter, outputFile,
+                           method, precond, cycle);
+      break;
+    }
 
   } catch (const std::exception &e) {
     std::cerr << "Error parsing arguments : " << e.what() << "\n";
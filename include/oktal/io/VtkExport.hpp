@@ -4,7 +4,13 @@
 #include "oktal/octree/CellGrid.hpp"
 #include "oktal/octree/CellOctree.hpp"
 
+#include <cstddef>
 #include <filesystem>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using AccessMode = decltype(HighFive::File::ReadOnly);
 
@@ -42,17 +48,69 @@ class CellGridExporter {
   friend CellGridExporter exportCellGrid(const CellGrid &grid,
                                          const std::filesystem::path &filepath);
 
+  template <typename Component>
+  CellGridExporter &writeFieldComponents(std::size_t index,
+                                         const FieldRegistry::FieldInfo &info) {
+    const auto &fields = pGrid->fields();
+    for (std::size_t c = 0; c < info.components; ++c) {
+      const std::string name = info.components == 1
+                                   ? std::string{info.name}
+                                   : std::format("{}_{}", info.name, c);
+      writeGridVector<Component>(name, fields.component<Component>(index, c));
+    }
+    return *this;
+  }
+
 public:
+  /**
+   * @brief writes one value per cell, indexed by enumeration index
+   * @details The file holds one value per node of the octree. Every value is
+   * read once from @p data and placed at the stream position of its cell, so
+   * the output is correct for every Ordering and level selection; nodes that
+   * are not cells of the grid get zero. Values behind the cells, e.g. of
+   * ghost cells, are ignored.
+   *
+   * @throws std::invalid_argument if @p data holds fewer values than the grid
+   * has cells
+   */
   template <typename T>
-  CellGridExporter &writeGridVector(const std::string &name, std::vector<T> data) {
-    const auto &nodes = pGrid->octree().nodesStream();
-    if (data.size() < nodes.size()) {
-      const auto diff = nodes.size() - data.size();
-      data.insert(data.cbegin(), diff, {0});
+  CellGridExporter &writeGridVector(const std::string &name,
+                                    std::span<const T> data) {
+    if (data.size() < pGrid->size()) {
+      throw std::invalid_argument(
+          std::format("Field '{}' holds {} values but the grid has {} cells!",
+                      name, data.size(), pGrid->size()));
     }
-    file.writeCellData<T>(name, data);
+    const std::size_t numNodes = pGrid->octree().numberOfNodes();
+    std::vector<T> nodeData(numNodes, T{0});
+    for (std::size_t streamIdx = 0; streamIdx < numNodes; ++streamIdx) {
+      const std::size_t enumIdx = pGrid->getEnumerationIndex(streamIdx);
+      if (enumIdx != CellGrid::NOT_ENUMERATED) {
+        nodeData[streamIdx] = data[enumIdx];
+      }
+    }
+    file.writeCellData<T>(name, nodeData);
     return *this;
   }
+
+  /**
+   * @brief writes a field of the grid; vector fields are written as one
+   * array per component, suffixed with the component index
+   */
+  template <typename T> CellGridExporter &writeField(FieldHandle<T> handle) {
+    const auto &fields = pGrid->fields();
+    return writeFieldComponents<typename FieldTraits<T>::Component>(
+        handle.index(), fields.info(handle.index()));
+  }
+
+  /**
+   * @brief writes every field of the grid
+   *
+   * @throws std::invalid_argument if a field has a component type other than
+   * double, float, std::int32_t or std::int64_t; the fields before it are
+   * already written
+   */
+  CellGridExporter &writeFields();
 };
 
 [[nodiscard]] CellGridExporter
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "oktal/geometry/Vec.hpp"
+#include "oktal/octree/CellGrid.hpp"
+#include "oktal/octree/CellOctree.hpp"
+#include "oktal/octree/MortonIndex.hpp"
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <span>
+
+namespace oktal {
+
+/**
+ * @brief Brick of root trees covering a non-cubic domain
+ * @details All trees share the node stream of one CellOctree: the trees are
+ * placed on level rootLevel() of an enclosing octree, in the Morton order of
+ * their brick coordinates, and every region outside the brick is a single
+ * phantom leaf on the coarsest possible level. Cells therefore follow one
+ * global Morton ordering across trees, and CellGrid adjacency as well as the
+ * HTG export work on the forest unchanged. Memory and cell counts follow the
+ * brick instead of its bounding cube.
+ */
+class CellForest {
+public:
+  using TreeExtents = std::array<std::size_t, 3>;
+
+  static constexpr std::size_t NO_TREE =
+      std::numeric_limits<std::size_t>::max();
+
+  /**
+   * @brief Creates a forest from one octree per brick position
+   *
+   * @param treesPerAxis number of trees along x, y and z
+   * @param origin minimum corner of the brick
+   * @param treeSidelength sidelength of every root tree
+   * @param trees octrees in lexicographic brick order (x fastest); their own
+   * geometries are ignored
+   * @throws std::invalid_argument if an extent is zero or the number of trees
+   * does not match the brick
+   */
+  CellForest(const TreeExtents &treesPerAxis, const Vec3D &origin,
+             double treeSidelength, std::span<const CellOctree> trees);
+
+  /**
+   * @brief Creates a forest of uniformly refined trees
+   *
+   * @param treesPerAxis number of trees along x, y and z
+   * @param treeLevel refinement level of every tree
+   * @param origin minimum corner of the brick
+   * @param treeSidelength sidelength of every root tree
+   * @return CellForest
+   */
+  [[nodiscard]] static CellForest
+  createUniform(const TreeExtents &treesPerAxis, std::size_t treeLevel,
+                const Vec3D &origin = {}, double treeSidelength = 1.0);
+
+  [[nodiscard]] const TreeExtents &treesPerAxis() const {
+    return treesPerAxis_;
+  }
+
+  [[nodiscard]] std::size_t numberOfTrees() const {
+    return treesPerAxis_[0] * treesPerAxis_[1] * treesPerAxis_[2];
+  }
+
+  /**
+   * @brief returns the level of the shared octree the tree roots live on
+   *
+   * @return std::size_t
+   */
+  [[nodiscard]] std::size_t rootLevel() const { return rootLevel_; }
+
+  /**
+   * @brief converts a level within the trees to a level of the shared octree
+   *
+   * @param treeLevel
+   * @return std::size_t
+   */
+  [[nodiscard]] std::size_t level(std::size_t treeLevel) const {
+    return rootLevel_ + treeLevel;
+  }
+
+  /**
+   * @brief returns the Morton index of the root of tree @p tree within the
+   * shared octree
+   *
+   * @param tree lexicographic brick index
+   * @return MortonIndex
+   */
+  [[nodiscard]] MortonIndex treeRoot(std::size_t tree) const;
+
+  /**
+   * @brief returns the lexicographic brick index of the tree containing @p m
+   *
+   * @param m
+   * @return std::size_t, NO_TREE if @p m lies above the roots or outside the
+   * brick
+   */
+  [[nodiscard]] std::size_t treeOf(const MortonIndex &m) const;
+
+  [[nodiscard]] const std::shared_ptr<const CellOctree> &octree() const {
+    return octree_;
+  }
+
+private:
+  TreeExtents treesPerAxis_;
+  std::size_t rootLevel_;
+  std::shared_ptr<const CellOctree> octree_;
+};
+
+/**
+ * @brief Periodicity along the faces of a brick of root trees
+ * @details Coordinates wrap at the extent of the brick instead of the extent
+ * of the enclosing octree.
+ */
+class ForestTorus : public PeriodicityMapper {
+public:
+  ForestTorus(const CellForest &forest, bool x_periodic, bool y_periodic,
+              bool z_periodic)
+      : treesPerAxis_(forest.treesPerAxis()), rootLevel_(forest.rootLevel()),
+        periodic_{x_periodic, y_periodic, z_periodic} {}
+
+  [[nodiscard]]
+  SignedGridCoordinates getNeighborCoordinates(SignedGridCoordinates goalCoords,
+                                               size_t lvl) const override;
+
+private:
+  CellForest::TreeExtents treesPerAxis_;
+  std::size_t rootLevel_;
+  std::array<bool, 3> periodic_;
+};
+
+} // namespace oktal
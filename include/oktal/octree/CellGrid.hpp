@@ -2,18 +2,29 @@
 
 #include "oktal/geometry/Vec.hpp"
 #include "oktal/octree/CellOctree.hpp"
+#include "oktal/octree/FieldRegistry.hpp"
 #include "oktal/octree/MortonIndex.hpp"
+#include "oktal/octree/Periodicity.hpp"
+#include "oktal/octree/PersistentOctree.hpp"
+#include "oktal/util/AlignedAllocator.hpp"
 #include <algorithm>
 #include <array>
+#include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <filesystem>
 #include <format>
 #include <initializer_list>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <source_location>
+#include <span>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
+#include <vector>
 namespace oktal {
 
 // -------------------------------------------------------------------------
@@ -22,13 +33,259 @@ namespace oktal {
 using AdjacencyOffset = Vec<std::ptrdiff_t, 3>;
 using AdjacencyList = std::vector<size_t>;
 using AdjacencyListView = std::span<const size_t>;
+using CompactNeighborIndex = std::uint32_t;
 
 class CellGridBuilder;
+class PeriodicityMapper;
+template <typename... Offsets> struct Stencil;
+template <typename TStencil> class StencilGrid;
+
+/**
+ * @brief Memory layout of the adjacency of a CellGrid
+ */
+enum class AdjacencyLayout {
+  // One array of size_t indices per adjacency offset
+  PerOffset,
+  // The 32-bit neighbor indices of every cell stored next to each other
+  Interleaved
+};
+
+/**
+ * @brief Contiguous range [begin, end) of enumeration indices
+ */
+struct EnumerationRange {
+  size_t begin;
+  size_t end;
+
+  [[nodiscard]] size_t size() const { return end - begin; }
+
+  [[nodiscard]] bool empty() const { return begin == end; }
+
+  [[nodiscard]] bool contains(size_t enumIdx) const {
+    return enumIdx >= begin && enumIdx < end;
+  }
+
+  [[nodiscard]] bool operator==(const EnumerationRange &) const = default;
+};
+
+/**
+ * @brief Cells of a CellGrid that lack neighbors in the same adjacency slots
+ */
+struct BoundaryGroup {
+  // Slots without a neighbor, ascending
+  std::vector<size_t> missingSlots;
+  // Ascending enumeration indices
+  std::vector<size_t> cells;
+};
+
+/**
+ * @brief Cell appended to a CellGrid in place of a neighbor outside the domain
+ * @details A neighbor is outside the domain if it lies past the grid extent
+ * or inside a phantom leaf, such as the padding around a CellForest brick.
+ */
+struct GhostCell {
+  // Cell whose neighbor is missing and the adjacency slot of the neighbor
+  size_t cell;
+  size_t slot;
+  // Distance between the centers of the cell and the ghost
+  double distance;
+  // Cell at the position of the ghost wrapped into the domain on the same
+  // level, or at the opposite boundary if the wrap lands in phantom padding;
+  // CellGrid::NO_NEIGHBOR if there is none
+  size_t periodicPartner;
+};
+
+/**
+ * @brief Boundary condition imposed through the ghost cells of a CellGrid
+ */
+struct BoundaryCondition {
+  enum class Type {
+    // value on the boundary face
+    Dirichlet,
+    // derivative towards the ghost
+    Neumann,
+    // continuation from the opposite side of the domain
+    Periodic
+  };
+
+  Type type;
+  double value;
+
+  [[nodiscard]] static BoundaryCondition dirichlet(double value) {
+    return {Type::Dirichlet, value};
+  }
+
+  [[nodiscard]] static BoundaryCondition neumann(double derivative) {
+    return {Type::Neumann, derivative};
+  }
+
+  [[nodiscard]] static BoundaryCondition periodic() {
+    return {Type::Periodic, 0.0};
+  }
+};
+
+/**
+ * @brief Numbering of the cells of a CellGrid
+ */
+enum class Ordering {
+  // Level by level, each level in Morton order
+  Morton,
+  // Reverse Cuthill-McKee on the adjacency graph, reducing its bandwidth
+  RCM,
+  // Color by color of CellGrid::coloring(), each color in Morton order
+  Multicolor
+};
+
+/**
+ * @brief Partition of the cells of a CellGrid into color classes such that
+ * no cell is adjacent to another cell of its color
+ */
+struct CellColoring {
+  // The cells of color c are cells[colorStart[c]] to cells[colorStart[c+1]-1]
+  std::vector<size_t> colorStart;
+  // Cells sorted by color, ascending within a color
+  std::vector<size_t> cells;
+
+  [[nodiscard]] size_t numberOfColors() const { return colorStart.size() - 1; }
+
+  [[nodiscard]] std::span<const size_t> cellsOf(size_t color) const {
+    return std::span{cells}.subspan(colorStart[color],
+                                    colorStart[color + 1] - colorStart[color]);
+  }
+};
+
+/**
+ * @brief Bandwidth and profile of the adjacency of a CellGrid, seen as a
+ * sparse matrix with one row per cell
+ */
+struct AdjacencyStatistics {
+  // Largest distance |i - j| between a cell i and one of its neighbors j
+  size_t bandwidth;
+  // Sum over all cells i of i - min(i, smallest neighbor index)
+  size_t profile;
+};
+
+/**
+ * @brief Neighbors of a cell through one face offset, possibly on other levels
+ */
+struct LeafNeighbors {
+  std::span<const size_t> cells;
+  // Fraction of the face of the cell covered by each neighbor: 1 for a
+  // neighbor on the same or a coarser level, 1/4^d for a neighbor d levels
+  // finer
+  std::span<const double> weights;
+
+  [[nodiscard]] size_t size() const { return cells.size(); }
+};
+
+/**
+ * @brief Cells exchanged between one part of a CellGrid and a neighbor part
+ */
+struct GhostExchange {
+  // Index of the neighbor part
+  size_t part;
+  // Sorted owned cells read by the stencil of the neighbor part
+  std::vector<size_t> send;
+  // Sorted cells of the neighbor part read by the stencil of the owned part
+  std::vector<size_t> receive;
+};
+
+/**
+ * @brief Halo of one part of a CellGrid for its adjacency offsets
+ */
+struct GhostLayer {
+  EnumerationRange owned;
+  // Sorted off-part cells read by the owned cells
+  std::vector<size_t> halo;
+  // One entry per part sharing cells with the owned part, ordered by part
+  std::vector<GhostExchange> exchanges;
+};
+
+/**
+ * @brief Dense lexicographic view of a CellGrid that holds every cell of a
+ * single level, see CellGrid::uniformLevel()
+ * @details The cell at grid coordinates (x, y, z) has the dense index
+ * x + n (y + n z) for the extent n = 2^level. Rows along x are contiguous,
+ * and the face neighbors of a cell sit at the strides 1, n and n^2, so
+ * stencils run on dense copies of the fields without adjacency lookups.
+ */
+class UniformLevelView {
+public:
+  [[nodiscard]] size_t level() const { return level_; }
+
+  // Number of cells along every axis
+  [[nodiscard]] size_t extent() const { return extent_; }
+
+  [[nodiscard]] size_t size() const { return cells_.size(); }
+
+  [[nodiscard]] size_t denseIndex(size_t x, size_t y, size_t z) const {
+    return x + (extent_ * (y + (extent_ * z)));
+  }
+
+  // Enumeration index of the cell at @p denseIdx
+  [[nodiscard]] size_t cell(size_t denseIdx) const { return cells_[denseIdx]; }
+
+  [[nodiscard]] size_t denseIndexOf(size_t enumIdx) const {
+    return denseIndices_[enumIdx];
+  }
+
+  /**
+   * @brief copies the cell values of @p field into the dense layout
+   *
+   * @throws std::invalid_argument if a span holds fewer than size() values
+   */
+  template <typename T>
+  void gather(std::span<const T> field, std::span<T> dense) const {
+    requireValues(field.size());
+    requireValues(dense.size());
+    for (size_t denseIdx = 0; denseIdx < size(); ++denseIdx) {
+      dense[denseIdx] = field[cells_[denseIdx]];
+    }
+  }
+
+  /**
+   * @brief copies dense values back to the cells of @p field
+   *
+   * @throws std::invalid_argument if a span holds fewer than size() values
+   */
+  template <typename T>
+  void scatter(std::span<const T> dense, std::span<T> field) const {
+    requireValues(dense.size());
+    requireValues(field.size());
+    for (size_t denseIdx = 0; denseIdx < size(); ++denseIdx) {
+      field[cells_[denseIdx]] = dense[denseIdx];
+    }
+  }
+
+private:
+  friend class CellGrid;
+  size_t level_;
+  size_t extent_;
+  // Enumeration index per dense index and vice versa
+  std::vector<size_t> cells_;
+  std::vector<size_t> denseIndices_;
+
+  UniformLevelView(size_t level, std::vector<size_t> cells,
+                   std::vector<size_t> denseIndices)
+      : level_(level), extent_(size_t{1} << level), cells_(std::move(cells)),
+        denseIndices_(std::move(denseIndices)) {}
+
+  void requireValues(size_t numValues) const {
+    if (numValues < size()) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::invalid_argument(
+          std::format("{}: Span holds {} values but the level has {} cells.",
+                      sourceInfo, numValues, size()));
+    }
+  }
+};
 
 class CellGrid {
 public:
   static constexpr size_t NOT_ENUMERATED = std::numeric_limits<size_t>::max();
   static constexpr size_t NO_NEIGHBOR = NOT_ENUMERATED;
+  static constexpr CompactNeighborIndex NO_COMPACT_NEIGHBOR =
+      std::numeric_limits<CompactNeighborIndex>::max();
 
   // -------------------------------------------------------------------------
   // Nested Cell View Class
@@ -50,7 +307,10 @@ public:
 
     [[nodiscard]]
     CellView neighbor(AdjacencyOffset offset) const {
-      return {grid_, grid_->neighborIndices(offset)[enumIdx_]};
+      const size_t neighbor =
+          grid_->neighborIndex(grid_->adjacencySlot(offset), enumIdx_);
+      // Ghost cells have no view
+      return {grid_, neighbor < grid_->size() ? neighbor : NOT_ENUMERATED};
     }
 
     [[nodiscard]]
@@ -65,16 +325,17 @@ public:
 
     [[nodiscard]]
     Vec3D center() const {
-      // NOLINTNEXTLINE (bugprone-unchecked-optional-access)
-      return grid_->octree_->getCell(grid_->mortonIndices_.at(enumIdx_))
-          ->center();
+      if (grid_->hasGeometryCache()) {
+        return {grid_->centers_[0].at(enumIdx_),
+                grid_->centers_[1].at(enumIdx_),
+                grid_->centers_[2].at(enumIdx_)};
+      }
+      return grid_->octree_->geometry().cellCenter(mortonIndex());
     }
 
     [[nodiscard]]
     Box<double> boundingBox() const {
-      // NOLINTNEXTLINE (bugprone-unchecked-optional-access)
-      return grid_->octree_->getCell(grid_->mortonIndices_.at(enumIdx_))
-          ->boundingBox();
+      return grid_->octree_->geometry().cellBoundingBox(mortonIndex());
     }
 
     // Implicit conversion functions
@@ -134,6 +395,8 @@ public:
 
   static CellGridBuilder create(std::shared_ptr<const CellOctree> octree);
 
+  static CellGridBuilder create(const PersistentOctree &snapshot);
+
   [[nodiscard]]
   size_t size() const {
     return mortonIndices_.size();
@@ -151,7 +414,22 @@ public:
 
   [[nodiscard]]
   std::size_t getEnumerationIndex(std::size_t streamIndex) const {
-    return streamIndexToEnum_[streamIndex];
+    // Cells of a level are enumerated in stream order, hence the enumeration
+    // index follows from the rank of the node among the non-phantom nodes
+    if (streamIndex >= octree_->numberOfNodes() ||
+        octree_->nodesStream()[streamIndex].isPhantom()) {
+      return NOT_ENUMERATED;
+    }
+    const size_t level = octree_->levelOf(streamIndex);
+    const size_t levelEnumStart = levelEnumStart_[level];
+    if (levelEnumStart == NOT_ENUMERATED) {
+      return NOT_ENUMERATED;
+    }
+    const size_t mortonEnumIdx =
+        levelEnumStart + octree_->nonPhantomRank(streamIndex) -
+        octree_->nonPhantomRank(octree_->getLevels()[level].first);
+    return mortonToEnum_.empty() ? mortonEnumIdx
+                                 : mortonToEnum_[mortonEnumIdx];
   }
 
   [[nodiscard]]
@@ -162,20 +440,419 @@ public:
     return getEnumerationIndex(cv.streamIndex());
   }
 
+  [[nodiscard]]
+  std::span<const AdjacencyOffset> adjacencyOffsets() const {
+    return adjacencyOffsets_;
+  }
+
+  [[nodiscard]]
+  Ordering ordering() const {
+    return ordering_;
+  }
+
+  /**
+   * @brief computes bandwidth and profile over all adjacency slots, including
+   * the leaf adjacency if present
+   *
+   * @return AdjacencyStatistics
+   */
+  [[nodiscard]]
+  AdjacencyStatistics adjacencyStatistics() const;
+
+  /**
+   * @brief returns the maximal ranges of cells with a neighbor in every
+   * adjacency slot, ascending
+   * @details Stencil kernels can loop over these ranges without checking for
+   * missing neighbors and treat the cells of boundaryGroups() separately.
+   * Only the same-level adjacency is considered.
+   *
+   * @return std::span<const EnumerationRange>
+   */
+  [[nodiscard]]
+  std::span<const EnumerationRange> interiorRanges() const {
+    return interiorRanges_;
+  }
+
+  /**
+   * @brief returns the cells lacking a neighbor in at least one adjacency
+   * slot, grouped by the slots they lack
+   *
+   * @return std::span<const BoundaryGroup> ordered by missing slots
+   */
+  [[nodiscard]]
+  std::span<const BoundaryGroup> boundaryGroups() const {
+    return boundaryGroups_;
+  }
+
+  /**
+   * @brief colors the cells such that the cells of one color can be updated
+   * concurrently by a stencil over the adjacency of the grid, e.g. in a
+   * Gauss-Seidel sweep
+   * @details Two cells are adjacent if one is a neighbor of the other through
+   * an adjacency offset or the leaf adjacency. Same-level adjacency is
+   * colored by the parity of the grid coordinates, with two colors if every
+   * offset has an odd sum of components and eight colors if every offset has
+   * an odd component. Otherwise the cells are colored greedily in
+   * enumeration order. With Ordering::Multicolor every color is a contiguous
+   * range of cells.
+   *
+   * @return CellColoring without empty colors
+   */
+  [[nodiscard]]
+  CellColoring coloring() const;
+
+  /**
+   * @brief returns the dense view of the grid if its cells are exactly all
+   * cells of one level, as for a single level of
+   * CellOctree::createUniformGrid(); std::nullopt otherwise
+   * @details Ghost cells are not part of the view. Works with every
+   * ordering and runs in O(size()).
+   *
+   * @return std::optional<UniformLevelView>
+   */
+  [[nodiscard]]
+  std::optional<UniformLevelView> uniformLevel() const;
+
+  [[nodiscard]]
+  AdjacencyLayout adjacencyLayout() const {
+    return adjacencyLayout_;
+  }
+
+  /**
+   * @brief returns the position of @p offset in adjacencyOffsets()
+   *
+   * @param offset
+   * @throws std::out_of_range if the grid has no adjacency for @p offset
+   * @return size_t
+   */
+  [[nodiscard]]
+  size_t adjacencySlot(const AdjacencyOffset offset) const {
+    const auto it = std::ranges::find(adjacencyOffsets_, offset);
+    if (it == adjacencyOffsets_.end()) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::out_of_range(
+          std::format("{}: Invalid adjacency offset for octree.", sourceInfo));
+    }
+    return static_cast<size_t>(it - adjacencyOffsets_.begin());
+  }
+
+  /**
+   * @brief returns the neighbor of cell @p enumIdx through the offset in slot
+   * @p slot, in either layout
+   *
+   * @param slot
+   * @param enumIdx
+   * @return size_t, NO_NEIGHBOR if there is none
+   */
+  [[nodiscard]]
+  size_t neighborIndex(size_t slot, size_t enumIdx) const {
+    if (adjacencyLayout_ == AdjacencyLayout::PerOffset) {
+      return adjacencyLists_[slot][enumIdx];
+    }
+    const CompactNeighborIndex neighbor =
+        interleavedAdjacency_[enumIdx * adjacencyOffsets_.size() + slot];
+    return neighbor == NO_COMPACT_NEIGHBOR ? NO_NEIGHBOR : neighbor;
+  }
+
+  /**
+   * @brief returns the neighbor indices of all cells for @p offset
+   *
+   * @param offset
+   * @throws std::out_of_range if the grid has no adjacency for @p offset
+   * @throws std::logic_error if the adjacency is interleaved
+   * @return AdjacencyListView
+   */
   [[nodiscard]]
   AdjacencyListView neighborIndices(const AdjacencyOffset offset) const {
+    const size_t slot = adjacencySlot(offset);
+    if (adjacencyLayout_ != AdjacencyLayout::PerOffset) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::logic_error(std::format(
+          "{}: Interleaved adjacency has no per-offset lists.", sourceInfo));
+    }
+    return adjacencyLists_[slot];
+  }
+
+  [[nodiscard]]
+  bool hasLeafAdjacency() const {
+    return !leafRowStart_.empty();
+  }
+
+  /**
+   * @brief returns the cells sharing the face of cell @p enumIdx in slot
+   * @p slot across levels
+   * @details Requires CellGridBuilder::leafAdjacency().
+   *
+   * @param slot
+   * @param enumIdx
+   * @throws std::logic_error if the grid has no leaf adjacency
+   * @return LeafNeighbors, empty at the domain boundary
+   */
+  [[nodiscard]]
+  LeafNeighbors leafNeighbors(size_t slot, size_t enumIdx) const {
+    if (!hasLeafAdjacency()) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::logic_error(std::format(
+          "{}: Grid was built without leaf adjacency.", sourceInfo));
+    }
+    const size_t row = enumIdx * adjacencyOffsets_.size() + slot;
+    const size_t begin = leafRowStart_[row];
+    const size_t count = leafRowStart_[row + 1] - begin;
+    return {std::span{leafNeighbors_}.subspan(begin, count),
+            std::span{leafWeights_}.subspan(begin, count)};
+  }
+
+  /**
+   * @brief returns the neighbors of cell @p enumIdx in the order of
+   * adjacencyOffsets()
+   *
+   * @param enumIdx
+   * @throws std::logic_error if the adjacency is not interleaved
+   * @return std::span<const CompactNeighborIndex>, NO_COMPACT_NEIGHBOR for
+   * missing neighbors
+   */
+  [[nodiscard]]
+  std::span<const CompactNeighborIndex> neighbors(size_t enumIdx) const {
+    if (adjacencyLayout_ != AdjacencyLayout::Interleaved) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::logic_error(std::format(
+          "{}: Neighbors of a cell require interleaved adjacency.",
+          sourceInfo));
+    }
+    const size_t stride = adjacencyOffsets_.size();
+    return std::span{interleavedAdjacency_}.subspan(enumIdx * stride, stride);
+  }
 
-    for (size_t i = 0; i < adjacencyOffsets_.size(); ++i) {
-      if (adjacencyOffsets_.at(i) == offset) {
-        return adjacencyLists_.at(i);
+  /**
+   * @brief computes the cells part @p owned reads from, and provides to, the
+   * other parts through the adjacency offsets of the grid
+   * @details Runs in O(owned.size()) if every offset comes with its opposite
+   * and the grid wraps like periodicity::Torus, if at all. Otherwise the
+   * readers of the owned cells are found by scanning the whole grid.
+   *
+   * @param owned one of @p parts
+   * @param parts contiguous ranges tiling [0, size()) in ascending order, e.g.
+   * the parts of a CellGridPartition
+   * @throws std::invalid_argument if @p parts do not tile the grid or do not
+   * contain @p owned
+   * @return GhostLayer
+   */
+  [[nodiscard]]
+  GhostLayer ghostLayer(EnumerationRange owned,
+                        std::span<const EnumerationRange> parts) const;
+
+  /**
+   * @brief builds the grid of an adapted octree with the configuration of this
+   * grid, reusing the enumeration, adjacency, ghost cells, classification and
+   * fields of the cells that persist
+   * @details The remap is read once to match the persisting cells. Only the
+   * cells whose stencil reaches an added or removed cell search for their
+   * neighbors again, get new ghost cells and are classified again; the rows,
+   * ghosts and boundary groups of all other cells are taken over with their
+   * indices shifted. The searches thus scale with the size of the change, the
+   * rest is a few parallel copying passes over the grid. Grids with an
+   * ordering other than Ordering::Morton are renumbered, and their ghost cells
+   * and classification recomputed, since their numbering depends on the whole
+   * grid. The fields keep their values on the persisting cells and start at
+   * zero on added cells and ghost cells; their handles remain valid. The
+   * remap must map every cell to the node of the same cell and the
+   * periodicity mapper must wrap coordinates by whole periods, as the mappers
+   * of oktal do.
+   *
+   * @param newOctree adapted octree
+   * @param streamIndexRemap new stream index of every node of octree(), or
+   * CellOctree::NO_STREAM_INDEX for removed nodes, e.g. as returned by
+   * CellOctree::compact()
+   * @throws std::invalid_argument if @p streamIndexRemap does not cover all
+   * nodes of octree() or does not keep the Morton order of the cells
+   * @return CellGrid
+   */
+  [[nodiscard]]
+  CellGrid rebuild(std::shared_ptr<const CellOctree> newOctree,
+                   std::span<const size_t> streamIndexRemap) const;
+
+  // -------------------------------------------------------------------------
+  // Ghost Cells
+  // -------------------------------------------------------------------------
+  [[nodiscard]]
+  bool hasGhostCells() const {
+    return ghostCells_;
+  }
+
+  [[nodiscard]]
+  size_t numberOfGhosts() const {
+    return ghosts_.size();
+  }
+
+  /**
+   * @brief returns the ghost cells; ghost i has the index size() + i in the
+   * adjacency and in the fields of the grid
+   *
+   * @return std::span<const GhostCell>
+   */
+  [[nodiscard]]
+  std::span<const GhostCell> ghosts() const {
+    return ghosts_;
+  }
+
+  /**
+   * @brief sets the ghost values of @p field from the cells they belong to
+   * @details A Dirichlet ghost mirrors the cell about the boundary value g,
+   * 2 g - u, a Neumann ghost extrapolates the cell with the derivative over
+   * GhostCell::distance, and a periodic ghost copies its periodic partner,
+   * or the cell itself if it has none. Runs in O(numberOfGhosts()).
+   *
+   * @param field values of all cells followed by the ghost values
+   * @param condition
+   * @throws std::invalid_argument if @p field does not hold
+   * size() + numberOfGhosts() values
+   */
+  template <std::floating_point T>
+  void fillGhosts(std::span<T> field,
+                  const BoundaryCondition &condition) const {
+    if (field.size() != size() + ghosts_.size()) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::invalid_argument(
+          std::format("{}: Field holds {} instead of {} values.", sourceInfo,
+                      field.size(), size() + ghosts_.size()));
+    }
+    const auto cells = field.first(size());
+    const auto ghostValues = field.subspan(size());
+    const auto boundaryValue = static_cast<T>(condition.value);
+    for (size_t i = 0; i < ghosts_.size(); ++i) {
+      const GhostCell &ghost = ghosts_[i];
+      switch (condition.type) {
+      case BoundaryCondition::Type::Dirichlet:
+        ghostValues[i] = 2 * boundaryValue - cells[ghost.cell];
+        break;
+      case BoundaryCondition::Type::Neumann:
+        ghostValues[i] = cells[ghost.cell] +
+                         boundaryValue * static_cast<T>(ghost.distance);
+        break;
+      case BoundaryCondition::Type::Periodic:
+        ghostValues[i] = cells[ghost.periodicPartner == NO_NEIGHBOR
+                                   ? ghost.cell
+                                   : ghost.periodicPartner];
+        break;
       }
     }
+  }
+
+  template <std::floating_point T>
+  void fillGhosts(FieldHandle<T> handle, const BoundaryCondition &condition) {
+    fillGhosts(field(handle), condition);
+  }
+
+  // -------------------------------------------------------------------------
+  // Geometry Cache
+  // -------------------------------------------------------------------------
+  [[nodiscard]]
+  bool hasGeometryCache() const {
+    return geometryCached_;
+  }
+
+  /**
+   * @brief returns component @p axis of the centers of all cells
+   * @details Requires CellGridBuilder::geometryCache(). The array is 64-byte
+   * aligned and indexed by enumeration index.
+   *
+   * @param axis 0, 1 or 2
+   * @throws std::logic_error if the grid has no geometry cache
+   * @throws std::out_of_range if @p axis exceeds 2
+   * @return std::span<const double>
+   */
+  [[nodiscard]]
+  std::span<const double> centers(size_t axis) const {
+    requireGeometryCache();
+    return centers_.at(axis);
+  }
+
+  /**
+   * @brief returns component @p axis of the grid coordinates of all cells on
+   * their level, see MortonIndex::gridCoordinates()
+   *
+   * @param axis 0, 1 or 2
+   * @throws std::logic_error if the grid has no geometry cache
+   * @throws std::out_of_range if @p axis exceeds 2
+   * @return std::span<const std::uint32_t>
+   */
+  [[nodiscard]]
+  std::span<const std::uint32_t> gridCoordinates(size_t axis) const {
+    requireGeometryCache();
+    return coordinates_.at(axis);
+  }
+
+  /**
+   * @brief returns the level of all cells
+   *
+   * @throws std::logic_error if the grid has no geometry cache
+   * @return std::span<const std::uint8_t>
+   */
+  [[nodiscard]]
+  std::span<const std::uint8_t> levels() const {
+    requireGeometryCache();
+    return cellLevels_;
+  }
+
+  // -------------------------------------------------------------------------
+  // Fields
+  // -------------------------------------------------------------------------
+  [[nodiscard]]
+  FieldRegistry &fields() {
+    return fields_;
+  }
+
+  [[nodiscard]]
+  const FieldRegistry &fields() const {
+    return fields_;
+  }
+
+  /**
+   * @brief adds a zero-initialised per-cell field, see FieldRegistry::add
+   */
+  template <typename T> FieldHandle<T> addField(std::string name) {
+    return fields_.add<T>(std::move(name));
+  }
+
+  /**
+   * @brief returns a view of the field referenced by @p handle: a std::span
+   * for scalar fields, a VectorFieldView for vector fields
+   */
+  template <typename T> [[nodiscard]] auto field(FieldHandle<T> handle) {
+    return fields_.view(handle);
+  }
 
-    const auto sourceInfo = source_info(std::source_location::current());
-    throw std::out_of_range(
-        std::format("{}: Invalid adjacency offset for octree.", sourceInfo));
+  template <typename T> [[nodiscard]] auto field(FieldHandle<T> handle) const {
+    return fields_.view(handle);
   }
 
+  // -------------------------------------------------------------------------
+  // Persistence
+  // -------------------------------------------------------------------------
+  /**
+   * @brief writes the enumeration, adjacency and build configuration of the
+   * grid to @p path
+   * @details The file starts with fingerprints of the node stream of the
+   * octree and of the configuration, followed by one 64-byte aligned section
+   * per array in native byte order, so it can be memory-mapped. Fields are
+   * not saved.
+   *
+   * @throws std::logic_error if the periodicity mapper has no wrappedAxes()
+   * @throws std::runtime_error if the file cannot be written
+   */
+  void save(const std::filesystem::path &path) const;
+
+  /**
+   * @brief reads a grid of @p octree written by save()
+   *
+   * @throws std::runtime_error if the file cannot be read or is malformed
+   * @throws std::invalid_argument if the file holds a grid of another octree
+   * @return CellGrid
+   */
+  [[nodiscard]]
+  static CellGrid load(const std::filesystem::path &path,
+                       std::shared_ptr<const CellOctree> octree);
+
   [[nodiscard]]
   CellOctree::CellView operator[](size_t idx) const {
 
@@ -218,25 +895,122 @@ public:
 
 private:
   friend class CellGridBuilder;
+  template <typename TStencil> friend class StencilGrid;
   std::shared_ptr<const CellOctree> octree_;
   std::vector<MortonIndex> mortonIndices_;
-  std::vector<size_t> streamIndexToEnum_;
-  std::vector<double> scalarFields_;
-  std::vector<Vec3D> vectorFields_;
+  // Enumeration index of the first cell of each octree level, NOT_ENUMERATED
+  // for levels that are not part of the grid
+  std::vector<size_t> levelEnumStart_;
+  // Maps the level-wise Morton enumeration to the cell order; empty for
+  // Ordering::Morton
+  std::vector<size_t> mortonToEnum_;
+  Ordering ordering_ = Ordering::Morton;
+  // First cell of every color for Ordering::Multicolor, empty otherwise
+  std::vector<size_t> colorStart_;
+  // Build configuration kept for rebuild(); empty levels select all levels
+  std::vector<size_t> selectedLevels_;
+  std::shared_ptr<const PeriodicityMapper> periodicity_;
+  FieldRegistry fields_;
 
   // We do not use hash map because the set of offsets is pretty small
   std::vector<AdjacencyOffset> adjacencyOffsets_;
   std::vector<AdjacencyList> adjacencyLists_;
+  AdjacencyLayout adjacencyLayout_ = AdjacencyLayout::PerOffset;
+  // [cell][slot] neighbor indices for AdjacencyLayout::Interleaved
+  std::vector<CompactNeighborIndex> interleavedAdjacency_;
+  // Cross-level face adjacency in CSR form with one row per (cell, slot)
+  std::vector<size_t> leafRowStart_;
+  std::vector<size_t> leafNeighbors_;
+  std::vector<double> leafWeights_;
+
+  // Ghost cells numbered from size() on, appended after any renumbering
+  bool ghostCells_ = false;
+  std::vector<GhostCell> ghosts_;
+
+  // Points every adjacency slot that leaves the domain at a new ghost cell
+  // and resizes the fields to include the ghosts
+  void addGhostCells();
+
+  // Points the adjacency slots of ghosts_ at their ghost cells and resizes
+  // the fields to include the ghosts
+  void linkGhostCells();
+
+  // Cells with complete and incomplete same-level neighborhoods
+  std::vector<EnumerationRange> interiorRanges_;
+  std::vector<BoundaryGroup> boundaryGroups_;
+
+  // Fills interiorRanges_ and boundaryGroups_ from the adjacency
+  void classifyCells();
+
+  // Fills interiorRanges_ and boundaryGroups_ of a grid rebuilt from
+  // @p before, in which only the cells flagged in @p dirty changed their rows
+  void reclassifyCells(const CellGrid &before,
+                       std::span<const size_t> oldToNew,
+                       std::span<const char> dirty,
+                       std::span<const size_t> dirtyCells);
+
+  // Structure-of-arrays geometry of the cells, empty unless cached
+  template <typename T>
+  using GeometryArray = std::vector<T, AlignedAllocator<T>>;
+  bool geometryCached_ = false;
+  std::array<GeometryArray<double>, 3> centers_;
+  std::array<GeometryArray<std::uint32_t>, 3> coordinates_;
+  GeometryArray<std::uint8_t> cellLevels_;
+
+  // Fills the geometry cache from the Morton indices
+  void cacheGeometry();
+
+  void requireGeometryCache() const {
+    if (!geometryCached_) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::logic_error(std::format(
+          "{}: Grid was built without geometry cache.", sourceInfo));
+    }
+  }
+
+  // Renumbers all cells, cell i becoming cell newIndex[i]
+  void renumber(std::span<const size_t> newIndex);
+
+  // Renumbers the cells into ordering and returns the new index of every
+  // cell, empty for Ordering::Morton
+  std::vector<size_t> applyOrdering(Ordering ordering);
+
+  // Fingerprint of the build configuration, see save()
+  [[nodiscard]] std::uint64_t configurationFingerprint() const;
+
+  // Reads a grid written by save(); returns nothing if the file belongs to
+  // another octree or, if given, another configuration fingerprint
+  [[nodiscard]] static std::optional<CellGrid>
+  read(const std::filesystem::path &path,
+       std::shared_ptr<const CellOctree> octree,
+       std::optional<std::uint64_t> configuration);
+
+  // Returns a builder for octree with the configuration of this grid
+  [[nodiscard]] CellGridBuilder
+  sameConfiguration(std::shared_ptr<const CellOctree> octree) const;
 
   CellGrid(std::shared_ptr<const CellOctree> octree,
            std::vector<MortonIndex> mortonIndices,
-           std::vector<size_t> streamIndexMapping,
+           std::vector<size_t> levelEnumStart,
            std::vector<AdjacencyOffset> offsets,
            std::vector<AdjacencyList> neighborLists)
       : octree_(std::move(octree)), mortonIndices_(std::move(mortonIndices)),
-        streamIndexToEnum_(std::move(streamIndexMapping)),
+        levelEnumStart_(std::move(levelEnumStart)),
+        fields_(mortonIndices_.size()),
         adjacencyOffsets_(std::move(offsets)),
         adjacencyLists_(std::move(neighborLists)) {}
+
+  CellGrid(std::shared_ptr<const CellOctree> octree,
+           std::vector<MortonIndex> mortonIndices,
+           std::vector<size_t> levelEnumStart,
+           std::vector<AdjacencyOffset> offsets,
+           std::vector<CompactNeighborIndex> interleavedAdjacency)
+      : octree_(std::move(octree)), mortonIndices_(std::move(mortonIndices)),
+        levelEnumStart_(std::move(levelEnumStart)),
+        fields_(mortonIndices_.size()),
+        adjacencyOffsets_(std::move(offsets)),
+        adjacencyLayout_(AdjacencyLayout::Interleaved),
+        interleavedAdjacency_(std::move(interleavedAdjacency)) {}
 };
 
 // -------------------------------------------------------------------------
@@ -255,6 +1029,18 @@ public:
   virtual SignedGridCoordinates
   getNeighborCoordinates(SignedGridCoordinates goalCoords,
                          size_t lvl) const = 0;
+
+  /**
+   * @brief returns the periodic axes if the mapper behaves like
+   * periodicity::Torus, in which case CellGridBuilder::build() uses the
+   * inlined policy instead of virtual calls
+   *
+   * @return std::optional<std::array<bool, 3>>, empty for other mappings
+   */
+  [[nodiscard]]
+  virtual std::optional<std::array<bool, 3>> wrappedAxes() const {
+    return std::nullopt;
+  }
 };
 
 class NoPeriodicity : public PeriodicityMapper {
@@ -262,6 +1048,11 @@ public:
   [[nodiscard]]
   SignedGridCoordinates getNeighborCoordinates(SignedGridCoordinates goalCoords,
                                                size_t lvl) const override;
+
+  [[nodiscard]]
+  std::optional<std::array<bool, 3>> wrappedAxes() const override {
+    return std::array{false, false, false};
+  }
 };
 
 class Torus : public PeriodicityMapper {
@@ -273,10 +1064,37 @@ public:
   SignedGridCoordinates getNeighborCoordinates(SignedGridCoordinates goalCoords,
                                                size_t lvl) const override;
 
+  [[nodiscard]]
+  std::optional<std::array<bool, 3>> wrappedAxes() const override {
+    return periodic_;
+  }
+
 private:
   std::array<bool, 3> periodic_;
 };
 
+/**
+ * @brief Runtime mapper forwarding to the compile-time policy @p TPolicy
+ */
+template <PeriodicityPolicy TPolicy>
+class PolicyMapper : public PeriodicityMapper {
+public:
+  [[nodiscard]]
+  SignedGridCoordinates getNeighborCoordinates(SignedGridCoordinates goalCoords,
+                                               size_t lvl) const override {
+    return TPolicy::map(goalCoords, lvl);
+  }
+
+  [[nodiscard]]
+  std::optional<std::array<bool, 3>> wrappedAxes() const override {
+    if constexpr (requires { TPolicy::PERIODIC; }) {
+      return TPolicy::PERIODIC;
+    } else {
+      return std::nullopt;
+    }
+  }
+};
+
 // -------------------------------------------------------------------------
 // Cell Grid Builder
 // -------------------------------------------------------------------------
@@ -297,22 +1115,114 @@ public:
   CellGridBuilder &
   neighborhood(std::initializer_list<const AdjacencyOffset> offsets);
 
+  /**
+   * @brief selects the memory layout of the adjacency; defaults to
+   * AdjacencyLayout::PerOffset
+   * @details With AdjacencyLayout::Interleaved, build() throws
+   * std::length_error if the cell indices do not fit into 32 bits.
+   */
+  [[nodiscard]]
+  CellGridBuilder &adjacencyLayout(AdjacencyLayout layout);
+
+  /**
+   * @brief additionally records the neighbors across levels through every
+   * face offset, see CellGrid::leafNeighbors()
+   * @details build() throws std::invalid_argument if the neighborhood
+   * contains an offset that is not a face offset.
+   */
+  [[nodiscard]]
+  CellGridBuilder &leafAdjacency(bool enable = true);
+
+  /**
+   * @brief selects the numbering of the cells; defaults to Ordering::Morton
+   */
+  [[nodiscard]]
+  CellGridBuilder &ordering(Ordering order);
+
+  /**
+   * @brief appends a ghost cell for every adjacency slot that leaves the
+   * domain, so that stencils find a neighbor in every slot, see
+   * CellGrid::fillGhosts()
+   * @details Slots whose neighbor is missing inside the domain keep
+   * CellGrid::NO_NEIGHBOR.
+   */
+  [[nodiscard]]
+  CellGridBuilder &ghostCells(bool enable = true);
+
+  /**
+   * @brief additionally stores centers, grid coordinates and levels of all
+   * cells as arrays, see CellGrid::centers()
+   */
+  [[nodiscard]]
+  CellGridBuilder &geometryCache(bool enable = true);
+
+  /**
+   * @brief selects the compile-time periodicity @p TPolicy, e.g.
+   * periodicity::Torus<true, false, false>
+   */
+  template <PeriodicityPolicy TPolicy>
+  [[nodiscard]]
+  CellGridBuilder &periodicity() {
+    periodicityHandler_ = std::make_shared<PolicyMapper<TPolicy>>();
+    return *this;
+  }
+
+  /**
+   * @brief selects a runtime periodicity mapper
+   * @details Mappers that report their wrappedAxes() are replaced by the
+   * matching periodicity::Torus policy during build(); all others are called
+   * through the virtual interface.
+   */
   template <typename T>
   [[nodiscard]]
   CellGridBuilder &periodicityMapper(T periodicityHandler) {
     static_assert(std::is_base_of_v<PeriodicityMapper, T>,
                   "T must derive from PeriodicityMapper!");
-    periodicityHandler_ = std::make_unique<T>(std::move(periodicityHandler));
+    periodicityHandler_ = std::make_shared<T>(std::move(periodicityHandler));
     return *this;
   }
 
+  /**
+   * @brief makes build() load the grid from @p path if the file holds a grid
+   * of the same octree and configuration, and save the built grid there
+   * otherwise, see CellGrid::save()
+   * @details Grids with periodicity mappers that lack wrappedAxes() are built
+   * without the cache. Failing to write the cache does not fail the build.
+   */
+  [[nodiscard]]
+  CellGridBuilder &cache(std::filesystem::path path);
+
   [[nodiscard]] CellGrid build();
 
+  /**
+   * @brief builds a grid with interleaved adjacency for the offsets of
+   * @p stencil, replacing any previously set neighborhood
+   * @details Defined in oktal/octree/Stencil.hpp.
+   */
+  template <typename... Offsets>
+  [[nodiscard]] StencilGrid<Stencil<Offsets...>>
+  build(Stencil<Offsets...> stencil);
+
 private:
+  friend class CellGrid;
+  friend class GridHierarchy;
   std::shared_ptr<const CellOctree> octree_;
   std::vector<std::size_t> levels_;
   std::vector<AdjacencyOffset> adjacencyOffsets_;
-  std::unique_ptr<PeriodicityMapper> periodicityHandler_;
+  AdjacencyLayout adjacencyLayout_ = AdjacencyLayout::PerOffset;
+  bool leafAdjacency_ = false;
+  Ordering ordering_ = Ordering::Morton;
+  bool geometryCache_ = false;
+  bool ghostCells_ = false;
+  std::shared_ptr<const PeriodicityMapper> periodicityHandler_;
+  std::filesystem::path cachePath_;
+
+  [[nodiscard]] CellGrid buildGrid();
+
+  // Fingerprint of the configuration matching
+  // CellGrid::configurationFingerprint(), nothing if the periodicity cannot
+  // be fingerprinted
+  [[nodiscard]] std::optional<std::uint64_t> configurationFingerprint() const;
 };
 
 } // namespace oktal
\ No newline at end of file
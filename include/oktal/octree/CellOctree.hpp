@@ -3,13 +3,16 @@
 #include "oktal/geometry/Vec.hpp"
 #include "oktal/octree/MortonIndex.hpp"
 #include "oktal/octree/OctreeGeometry.hpp"
+#include <algorithm>
+#include <bit>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <format>
 #include <iterator>
+#include <limits>
 #include <memory>
-#include <numeric>
 #include <optional>
 #include <source_location>
 #include <span>
@@ -56,6 +59,9 @@ public:
 
 class CellOctree {
 public:
+  static constexpr std::size_t NO_STREAM_INDEX =
+      std::numeric_limits<std::size_t>::max();
+
   // ----- Nested Node class -----
   class Node {
   public:
@@ -176,16 +182,37 @@ private:
   std::vector<std::pair<levelStartIndex, levelSize>> levels_;
   OctreeGeometry geometry_;
 
+  // Rank structure over the phantom bits: one bit per node (set if the node
+  // is not a phantom) and the number of set bits before each 64-bit block.
+  std::vector<std::uint64_t> nonPhantomBits_;
+  std::vector<std::size_t> nonPhantomBlockRanks_;
+  // Number of non-phantom nodes before the start of each level (prefix sums,
+  // the last entry holds the total)
+  std::vector<std::size_t> nonPhantomLevelPrefix_;
+  // Same structure over the refined bits, used to find the parent of a node
+  std::vector<std::uint64_t> refinedBits_;
+  std::vector<std::size_t> refinedBlockRanks_;
+
+  void buildRankIndex();
+
+  // Drops the children of every refined node flagged in @p coarsen and
+  // returns the old-to-new stream index mapping
+  std::vector<std::size_t> removeChildren(const std::vector<char> &coarsen);
+
 public:
-  CellOctree() : nodesStream_({{}}), levels_({{0, 1}}) {}
+  CellOctree() : nodesStream_({{}}), levels_({{0, 1}}) { buildRankIndex(); }
 
   explicit CellOctree(const OctreeGeometry &m_geometry)
-      : nodesStream_({{}}), levels_({{0, 1}}), geometry_(m_geometry) {}
+      : nodesStream_({{}}), levels_({{0, 1}}), geometry_(m_geometry) {
+    buildRankIndex();
+  }
 
   CellOctree(decltype(nodesStream_) &&nodesStream, decltype(levels_) &&levels,
              const decltype(geometry_) &geometry)
       : nodesStream_(std::move(nodesStream)), levels_(std::move(levels)),
-        geometry_(geometry) {}
+        geometry_(geometry) {
+    buildRankIndex();
+  }
 
   [[nodiscard]] std::size_t numberOfNodes() const {
     return nodesStream_.size();
@@ -202,17 +229,7 @@ public:
     if (level >= levels_.size()) {
       return 0;
     }
-    const auto [levelStartIdxUnsigned, levelSize] = levels_.at(level);
-    const auto levelStartIdx =
-        static_cast<std::ptrdiff_t>(levelStartIdxUnsigned);
-    const auto levelEndIdx =
-        static_cast<std::ptrdiff_t>(levelStartIdxUnsigned + levelSize);
-    return std::accumulate(nodesStream_.begin() + levelStartIdx,
-                           nodesStream_.begin() + levelEndIdx, size_t{0},
-                           [&](size_t acc, const CellOctree::Node node) {
-                             return acc +
-                                    static_cast<size_t>(!node.isPhantom());
-                           });
+    return nonPhantomLevelPrefix_[level + 1] - nonPhantomLevelPrefix_[level];
   }
 
   [[nodiscard]]
@@ -226,11 +243,76 @@ public:
 
   [[nodiscard]]
   std::size_t numberOfNonPhantomNodes() const {
-    size_t sum = 0;
-    for (size_t i = 0; i < levels_.size(); ++i) {
-      sum += numberOfNonPhantomNodes(i);
-    }
-    return sum;
+    return nonPhantomLevelPrefix_.back();
+  }
+
+  /**
+   * @brief returns the number of non-phantom nodes with a stream index smaller
+   * than @p streamIndex in O(1)
+   *
+   * @param streamIndex may be at most numberOfNodes()
+   * @return std::size_t
+   */
+  [[nodiscard]] std::size_t nonPhantomRank(std::size_t streamIndex) const {
+    const std::size_t block = streamIndex >> 6;
+    const std::uint64_t below =
+        (std::uint64_t{1} << (streamIndex & 63)) - std::uint64_t{1};
+    return nonPhantomBlockRanks_[block] +
+           static_cast<std::size_t>(
+               std::popcount(nonPhantomBits_[block] & below));
+  }
+
+  /**
+   * @brief returns the number of refined nodes with a stream index smaller
+   * than @p streamIndex in O(1)
+   *
+   * @param streamIndex may be at most numberOfNodes()
+   * @return std::size_t
+   */
+  [[nodiscard]] std::size_t refinedRank(std::size_t streamIndex) const {
+    const std::size_t block = streamIndex >> 6;
+    const std::uint64_t below =
+        (std::uint64_t{1} << (streamIndex & 63)) - std::uint64_t{1};
+    return refinedBlockRanks_[block] +
+           static_cast<std::size_t>(std::popcount(refinedBits_[block] & below));
+  }
+
+  /**
+   * @brief returns the stream index of the parent of the node at
+   * @p streamIndex in O(log numberOfNodes())
+   * @details The children of the refined nodes follow the root in the order
+   * of their parents, so the parent is the refined node whose rank matches
+   * the sibling group of the node.
+   *
+   * @param streamIndex
+   * @return std::size_t, NO_STREAM_INDEX for the root
+   */
+  [[nodiscard]] std::size_t parentIndex(std::size_t streamIndex) const;
+
+  /**
+   * @brief returns the Morton index of the node at @p streamIndex by walking
+   * up its ancestors, in O(level * log numberOfNodes())
+   *
+   * @param streamIndex
+   * @return MortonIndex
+   */
+  [[nodiscard]] MortonIndex mortonIndexOf(std::size_t streamIndex) const;
+
+  /**
+   * @brief returns the level the node at @p streamIndex belongs to
+   *
+   * @param streamIndex
+   * @return std::size_t, numberOfLevels() if the index is out of range
+   */
+  [[nodiscard]] std::size_t levelOf(std::size_t streamIndex) const {
+    const auto it = std::ranges::upper_bound(
+        levels_, streamIndex, {},
+        &std::pair<levelStartIndex, levelSize>::first);
+    const auto level = static_cast<std::size_t>(it - levels_.begin()) - 1;
+    if (streamIndex >= levels_[level].first + levels_[level].second) {
+      return levels_.size();
+    }
+    return level;
   }
 
   [[nodiscard]] std::span<const Node> nodesStream() const {
@@ -251,6 +333,49 @@ public:
 
   static CellOctree fromDescriptor(std::string_view descriptor);
 
+  /**
+   * @brief Merges the refinement patterns of two octrees
+   * @details Both node streams are swept level by level at the same time, so
+   * the result is produced in O(n_a + n_b) without Morton lookups. Below a
+   * leaf, an operand behaves as if the leaf were refined into copies of
+   * itself. A node of the result is refined if it is refined in @p a or
+   * @p b, and a phantom if it is a phantom in both.
+   *
+   * @throws std::invalid_argument if the geometries of the octrees differ
+   */
+  [[nodiscard]] static CellOctree unite(const CellOctree &a,
+                                        const CellOctree &b);
+
+  /**
+   * @brief Keeps the refinement common to both octrees
+   * @details A node of the result is refined if it is refined in @p a and
+   * @p b, and a phantom if it is a phantom in either of them. See unite().
+   */
+  [[nodiscard]] static CellOctree intersect(const CellOctree &a,
+                                            const CellOctree &b);
+
+  /**
+   * @brief Removes the refinement of @p b from @p a
+   * @details The result keeps every refinement of @p a that @p b lacks, plus
+   * the refinements of @p a needed to reach them. The phantom flags are taken
+   * from @p a, except that a coarsened node becomes a phantom only if all
+   * leaves below it were phantoms. Runs a top-down sweep over both trees and
+   * one bottom-up pass over @p a.
+   */
+  [[nodiscard]] static CellOctree subtract(const CellOctree &a,
+                                           const CellOctree &b);
+
+  /**
+   * @brief Removes all subtrees that consist of phantom nodes only
+   * @details The root of such a subtree is kept as a phantom leaf, since
+   * siblings are always stored in groups of eight. Runs in a single linear
+   * bottom-up pass followed by a level-by-level renumbering.
+   *
+   * @return std::vector<std::size_t> mapping each old stream index to its new
+   * stream index, or NO_STREAM_INDEX if the node was removed
+   */
+  std::vector<std::size_t> compact();
+
   [[nodiscard]]
   std::optional<CellView> getCell(const MortonIndex &m) const;
 
@@ -0,0 +1,309 @@
+#pragma once
+
+#include "oktal/geometry/Vec.hpp"
+#include "oktal/util/AlignedAllocator.hpp"
+#include <cstddef>
+#include <format>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+
+namespace oktal {
+
+/**
+ * @brief Describes how a field type is stored: scalars as one array, vectors
+ * as one array per component (structure of arrays)
+ */
+template <typename T> struct FieldTraits {
+  static_assert(std::is_arithmetic_v<T>,
+                "Fields hold arithmetic types or Vec of arithmetic types!");
+  using Component = T;
+  static constexpr std::size_t COMPONENTS = 1;
+  static constexpr bool IS_VECTOR = false;
+};
+
+template <typename T, std::size_t DIM> struct FieldTraits<Vec<T, DIM>> {
+  static_assert(std::is_arithmetic_v<T>,
+                "Fields hold arithmetic types or Vec of arithmetic types!");
+  using Component = T;
+  static constexpr std::size_t COMPONENTS = DIM;
+  static constexpr bool IS_VECTOR = true;
+};
+
+class FieldRegistry;
+
+/**
+ * @brief Typed reference to a field of a FieldRegistry
+ * @details A handle is valid for the registry that created it, for its copies
+ * and for its remapped() registries, e.g. the fields of a copied or rebuilt
+ * CellGrid.
+ */
+template <typename T> class FieldHandle {
+public:
+  using ValueType = T;
+
+  [[nodiscard]] std::size_t index() const { return index_; }
+
+private:
+  friend class FieldRegistry;
+  FieldHandle(std::size_t registry, std::size_t index)
+      : registry_(registry), index_(index) {}
+  std::size_t registry_;
+  std::size_t index_;
+};
+
+/**
+ * @brief View of a vector field stored as one array per component
+ *
+ * @tparam T component type, const for read-only views
+ * @tparam DIM
+ */
+template <typename T, std::size_t DIM> class VectorFieldView {
+public:
+  using ValueType = Vec<std::remove_const_t<T>, DIM>;
+
+  VectorFieldView(T *data, std::size_t size, std::size_t stride)
+      : data_(data), size_(size), stride_(stride) {}
+
+  [[nodiscard]] std::size_t size() const { return size_; }
+
+  /**
+   * @brief returns the contiguous, 64-byte aligned array of component @p c
+   */
+  [[nodiscard]] std::span<T> component(std::size_t c) const {
+    return {data_ + c * stride_, size_};
+  }
+
+  [[nodiscard]] ValueType operator[](std::size_t cell) const {
+    ValueType value;
+    for (std::size_t c = 0; c < DIM; ++c) {
+      value[c] = data_[c * stride_ + cell];
+    }
+    return value;
+  }
+
+  void set(std::size_t cell, const ValueType &value) const
+    requires(!std::is_const_v<T>)
+  {
+    for (std::size_t c = 0; c < DIM; ++c) {
+      data_[c * stride_ + cell] = value[c];
+    }
+  }
+
+private:
+  T *data_;
+  std::size_t size_;
+  std::size_t stride_;
+};
+
+/**
+ * @brief Named, typed per-cell fields of a CellGrid
+ * @details Every field owns one zero-initialised buffer. Each component starts
+ * at a 64-byte boundary, so scalar fields and the components of vector fields
+ * are contiguous arrays suitable for vectorised loops. Handles index the
+ * fields directly; names are only looked up when a handle is requested.
+ */
+class FieldRegistry {
+public:
+  static constexpr std::size_t ALIGNMENT = 64;
+  // Source of cells without values in remapped()
+  static constexpr std::size_t NO_SOURCE =
+      std::numeric_limits<std::size_t>::max();
+
+  /**
+   * @brief Type-erased description of a field, e.g. for exporters
+   */
+  struct FieldInfo {
+    std::string_view name;
+    std::type_index componentType;
+    std::size_t components;
+  };
+
+  explicit FieldRegistry(std::size_t numberOfCells = 0)
+      : id_(nextId()), numberOfCells_(numberOfCells) {}
+
+  [[nodiscard]] std::size_t numberOfCells() const { return numberOfCells_; }
+
+  [[nodiscard]] std::size_t size() const { return fields_.size(); }
+
+  /**
+   * @brief requests huge-page backing for fields added afterwards
+   */
+  void useHugePages(bool enable) { hugePages_ = enable; }
+
+  [[nodiscard]] bool contains(std::string_view name) const;
+
+  /**
+   * @brief adds a zero-initialised field of type @p T
+   *
+   * @tparam T arithmetic type or Vec of an arithmetic type
+   * @param name
+   * @throws std::invalid_argument if a field called @p name exists
+   * @return FieldHandle<T>
+   */
+  template <typename T> FieldHandle<T> add(std::string name) {
+    using Traits = FieldTraits<T>;
+    if (contains(name)) {
+      throw std::invalid_argument(
+          std::format("A field called '{}' already exists!", name));
+    }
+    using Component = typename Traits::Component;
+    const std::size_t stride = paddedStride(sizeof(Component));
+    fields_.push_back({std::move(name), typeid(Component), Traits::COMPONENTS,
+                       sizeof(Component), stride,
+                       Buffer(stride * Traits::COMPONENTS * sizeof(Component),
+                              std::byte{0}, Allocator(hugePages_))});
+    return FieldHandle<T>{id_, fields_.size() - 1};
+  }
+
+  /**
+   * @brief returns the handle of the field called @p name
+   *
+   * @throws std::out_of_range if there is no such field
+   * @throws std::invalid_argument if the field does not hold @p T
+   */
+  template <typename T>
+  [[nodiscard]] FieldHandle<T> handle(std::string_view name) const {
+    using Traits = FieldTraits<T>;
+    const std::size_t index = indexOf(name);
+    const auto &field = fields_[index];
+    if (field.componentType != typeid(typename Traits::Component) ||
+        field.components != Traits::COMPONENTS) {
+      throw std::invalid_argument(
+          std::format("Field '{}' holds a different type!", name));
+    }
+    return FieldHandle<T>{id_, index};
+  }
+
+  /**
+   * @brief returns a std::span over a scalar field, or a VectorFieldView over
+   * a vector field
+   *
+   * @throws std::invalid_argument if @p handle stems from another registry,
+   * e.g. that of another CellGrid, or its field does not hold @p T
+   */
+  template <typename T> [[nodiscard]] auto view(FieldHandle<T> handle) {
+    using Component = typename FieldTraits<T>::Component;
+    requireField(handle);
+    return makeView<T>(componentData<Component>(handle.index()),
+                       fields_[handle.index()].stride);
+  }
+
+  template <typename T> [[nodiscard]] auto view(FieldHandle<T> handle) const {
+    using Component = typename FieldTraits<T>::Component;
+    requireField(handle);
+    return makeView<T>(componentData<Component>(handle.index()),
+                       fields_[handle.index()].stride);
+  }
+
+  [[nodiscard]] FieldInfo info(std::size_t index) const {
+    const auto &field = fields_.at(index);
+    return {field.name, field.componentType, field.components};
+  }
+
+  /**
+   * @brief returns component @p c of field @p index without a typed handle
+   *
+   * @throws std::invalid_argument if the field does not hold @p Component
+   */
+  template <typename Component>
+  [[nodiscard]] std::span<const Component> component(std::size_t index,
+                                                     std::size_t c) const {
+    const auto &field = fields_.at(index);
+    if (field.componentType != typeid(Component) || c >= field.components) {
+      throw std::invalid_argument(std::format(
+          "Field '{}' has no component {} of the requested type!", field.name,
+          c));
+    }
+    return {componentData<Component>(index) + c * field.stride,
+            numberOfCells_};
+  }
+
+  /**
+   * @brief returns a registry with the same fields for @p numberOfCells
+   * cells, in which cell i holds the values of cell @p source[i]
+   * @details Cells whose source is NO_SOURCE start at zero. The handles of
+   * this registry stay valid for the result, e.g. when a CellGrid carries its
+   * fields over to the grid it is rebuilt into.
+   *
+   * @param numberOfCells
+   * @param source cell of this registry for each of the @p numberOfCells cells
+   * @return FieldRegistry
+   */
+  [[nodiscard]] FieldRegistry
+  remapped(std::size_t numberOfCells,
+           std::span<const std::size_t> source) const;
+
+private:
+  using Allocator = AlignedAllocator<std::byte, ALIGNMENT>;
+  using Buffer = std::vector<std::byte, Allocator>;
+
+  struct Field {
+    std::string name;
+    std::type_index componentType;
+    std::size_t components;
+    std::size_t componentSize;
+    // Number of elements between the starts of two components
+    std::size_t stride;
+    Buffer data;
+  };
+
+  // Identifies the registry and its copies in the handles
+  std::size_t id_;
+  std::size_t numberOfCells_;
+  bool hugePages_ = false;
+  std::vector<Field> fields_;
+
+  [[nodiscard]] static std::size_t nextId();
+
+  [[nodiscard]] std::size_t indexOf(std::string_view name) const;
+
+  template <typename T> void requireField(FieldHandle<T> handle) const {
+    using Traits = FieldTraits<T>;
+    if (handle.registry_ != id_ || handle.index_ >= fields_.size()) {
+      throw std::invalid_argument(
+          "The field handle belongs to another registry!");
+    }
+    const auto &field = fields_[handle.index_];
+    if (field.componentType != typeid(typename Traits::Component) ||
+        field.components != Traits::COMPONENTS) {
+      throw std::invalid_argument(
+          std::format("Field '{}' holds a different type!", field.name));
+    }
+  }
+
+  [[nodiscard]] std::size_t paddedStride(std::size_t componentSize) const {
+    const std::size_t perLine = ALIGNMENT / componentSize;
+    return (numberOfCells_ + perLine - 1) / perLine * perLine;
+  }
+
+  // The buffers only ever hold arithmetic values, which are implicit-lifetime
+  // types, so their bytes can be accessed as components directly
+  template <typename Component>
+  [[nodiscard]] Component *componentData(std::size_t index) {
+    return reinterpret_cast<Component *>(fields_[index].data.data());
+  }
+
+  template <typename Component>
+  [[nodiscard]] const Component *componentData(std::size_t index) const {
+    return reinterpret_cast<const Component *>(fields_[index].data.data());
+  }
+
+  template <typename T, typename Component>
+  [[nodiscard]] auto makeView(Component *data, std::size_t stride) const {
+    if constexpr (FieldTraits<T>::IS_VECTOR) {
+      return VectorFieldView<Component, FieldTraits<T>::COMPONENTS>{
+          data, numberOfCells_, stride};
+    } else {
+      return std::span<Component>{data, numberOfCells_};
+    }
+  }
+};
+
+} // namespace oktal
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "oktal/octree/CellGrid.hpp"
+#include "oktal/octree/CellOctree.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <concepts>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace oktal {
+
+/**
+ * @brief Interpolation used to transfer values from a level to the next
+ * finer level
+ */
+enum class Prolongation {
+  // Every child takes the value of its parent
+  Constant,
+  // Cell-centered trilinear interpolation from the parent and the seven
+  // coarse cells surrounding the child
+  Trilinear
+};
+
+/**
+ * @brief One CellGrid per level of an octree, connected by parent/child maps
+ * and transfer operators between adjacent levels
+ * @details The grid of level l holds all nodes of level l except phantom
+ * leaves, i.e. refined phantom nodes such as the interior nodes of
+ * CellOctree::createUniformGrid() become cells of their level. Thus the
+ * children of the refined cells of level l make up the grid of level l + 1.
+ * All maps are precomputed, so restriction and prolongation are branch-light
+ * sweeps over contiguous arrays split into parallel chunks.
+ */
+class GridHierarchy {
+public:
+  static constexpr size_t NO_CELL = CellGrid::NOT_ENUMERATED;
+  static constexpr size_t NUM_CHILDREN = 8;
+  // Coarse cells contributing to a trilinear interpolation
+  static constexpr size_t NUM_CONTRIBUTORS = 8;
+  // Smallest number of cells a transfer kernel hands to a thread
+  static constexpr size_t MIN_CELLS_PER_THREAD = 4096;
+
+  /**
+   * @brief builds the grid of every octree level with the configuration of
+   * @p builder
+   * @details Levels selected on @p builder are ignored; a cache path is not
+   * used, since all levels would share the file.
+   *
+   * @param builder
+   */
+  explicit GridHierarchy(const CellGridBuilder &builder);
+
+  /**
+   * @brief returns the octree the grids are built on, a copy of the octree
+   * of the builder without refined phantom nodes
+   */
+  [[nodiscard]] const CellOctree &octree() const { return *octree_; }
+
+  [[nodiscard]] size_t numberOfLevels() const { return grids_.size(); }
+
+  [[nodiscard]] const CellGrid &grid(size_t level) const {
+    return grids_.at(level);
+  }
+
+  [[nodiscard]] CellGrid &grid(size_t level) { return grids_.at(level); }
+
+  /**
+   * @brief returns the parent on level @p level - 1 of every cell of level
+   * @p level, NO_CELL for cells without a parent cell
+   */
+  [[nodiscard]] std::span<const size_t> parents(size_t level) const {
+    return parents_.at(level);
+  }
+
+  /**
+   * @brief returns the children on level @p level + 1 of every cell of level
+   * @p level, NUM_CHILDREN per cell in Morton order, NO_CELL for missing ones
+   */
+  [[nodiscard]] std::span<const size_t> children(size_t level) const {
+    return children_.at(level);
+  }
+
+  [[nodiscard]] std::span<const size_t, NUM_CHILDREN>
+  children(size_t level, size_t cell) const {
+    return std::span<const size_t, NUM_CHILDREN>{
+        children_.at(level).data() + cell * NUM_CHILDREN, NUM_CHILDREN};
+  }
+
+  /**
+   * @brief restricts @p fine on level @p fineLevel to @p coarse on level
+   * @p fineLevel - 1 by full weighting, i.e. every coarse cell takes the
+   * average of its children
+   * @details Coarse cells without children keep their values.
+   *
+   * @param fineLevel at least 1
+   * @param fine at least grid(fineLevel).size() values
+   * @param coarse at least grid(fineLevel - 1).size() values
+   * @throws std::out_of_range if @p fineLevel has no coarser level
+   * @throws std::invalid_argument if a field is too small for its grid
+   */
+  template <std::floating_point T>
+  void restrictField(size_t fineLevel,
+                     std::type_identity_t<std::span<const T>> fine,
+                     std::span<T> coarse) const {
+    const size_t coarseLevel = requireTransfer(fineLevel);
+    requireSize(fineLevel, fine.size());
+    requireSize(coarseLevel, coarse.size());
+    const size_t *children = children_[coarseLevel].data();
+    const size_t numCells = grids_[coarseLevel].size();
+    parallel::forChunks(
+        numCells,
+        [&](size_t begin, size_t end, size_t) {
+          for (size_t cell = begin; cell < end; ++cell) {
+            const size_t *cellChildren = children + cell * NUM_CHILDREN;
+            T sum = 0;
+            size_t count = 0;
+            for (size_t c = 0; c < NUM_CHILDREN; ++c) {
+              if (cellChildren[c] != NO_CELL) {
+                sum += fine[cellChildren[c]];
+                ++count;
+              }
+            }
+            if (count != 0) {
+              coarse[cell] = sum / static_cast<T>(count);
+            }
+          }
+        },
+        parallel::threadsFor(numCells, MIN_CELLS_PER_THREAD));
+  }
+
+  /**
+   * @brief interpolates @p coarse on level @p fineLevel - 1 to @p fine on
+   * level @p fineLevel
+   * @details Coarse cells missing from the trilinear stencil, e.g. outside
+   * the domain, pass their weight on to the parent. Cells without a parent
+   * keep their values.
+   *
+   * @throws std::out_of_range if @p fineLevel has no coarser level
+   * @throws std::invalid_argument if a field is too small for its grid
+   */
+  template <std::floating_point T>
+  void prolongate(size_t fineLevel,
+                  std::type_identity_t<std::span<const T>> coarse,
+                  std::span<T> fine,
+                  Prolongation mode = Prolongation::Trilinear) const {
+    transfer(fineLevel, coarse, fine, mode,
+             [](T &value, T interpolated) { value = interpolated; });
+  }
+
+  /**
+   * @brief adds the interpolation of @p coarse to @p fine, e.g. to apply a
+   * coarse-grid correction, see prolongate()
+   */
+  template <std::floating_point T>
+  void addProlongated(size_t fineLevel,
+                      std::type_identity_t<std::span<const T>> coarse,
+                      std::span<T> fine,
+                      Prolongation mode = Prolongation::Trilinear) const {
+    transfer(fineLevel, coarse, fine, mode,
+             [](T &value, T interpolated) { value += interpolated; });
+  }
+
+private:
+  std::shared_ptr<const CellOctree> octree_;
+  std::vector<CellGrid> grids_;
+  std::vector<std::vector<size_t>> parents_;
+  std::vector<std::vector<size_t>> children_;
+  // Per level NUM_CONTRIBUTORS coarse cells and weights for every cell,
+  // parent first; always valid indices unless the cell has no parent
+  std::vector<std::vector<size_t>> contributors_;
+  std::vector<std::vector<double>> weights_;
+
+  // Returns the coarse level of a transfer to fineLevel
+  [[nodiscard]] size_t requireTransfer(size_t fineLevel) const {
+    if (fineLevel == 0 || fineLevel >= grids_.size()) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::out_of_range(std::format(
+          "{}: Level {} has no coarser level in the hierarchy.", sourceInfo,
+          fineLevel));
+    }
+    return fineLevel - 1;
+  }
+
+  void requireSize(size_t level, size_t fieldSize) const {
+    if (fieldSize < grids_[level].size()) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::invalid_argument(std::format(
+          "{}: Field holds {} values but level {} has {} cells.", sourceInfo,
+          fieldSize, level, grids_[level].size()));
+    }
+  }
+
+  template <std::floating_point T, typename TApply>
+  void transfer(size_t fineLevel, std::span<const T> coarse, std::span<T> fine,
+                Prolongation mode, TApply apply) const {
+    const size_t coarseLevel = requireTransfer(fineLevel);
+    requireSize(fineLevel, fine.size());
+    requireSize(coarseLevel, coarse.size());
+    const size_t *parents = parents_[fineLevel].data();
+    const size_t *contributors = contributors_[fineLevel].data();
+    const double *weights = weights_[fineLevel].data();
+    const size_t numCells = grids_[fineLevel].size();
+    parallel::forChunks(
+        numCells,
+        [&](size_t begin, size_t end, size_t) {
+          for (size_t cell = begin; cell < end; ++cell) {
+            if (parents[cell] == NO_CELL) {
+              continue;
+            }
+            if (mode == Prolongation::Constant) {
+              apply(fine[cell], coarse[parents[cell]]);
+              continue;
+            }
+            const size_t first = cell * NUM_CONTRIBUTORS;
+            T interpolated = 0;
+            for (size_t k = first; k < first + NUM_CONTRIBUTORS; ++k) {
+              interpolated +=
+                  static_cast<T>(weights[k]) * coarse[contributors[k]];
+            }
+            apply(fine[cell], interpolated);
+          }
+        },
+        parallel::threadsFor(numCells, MIN_CELLS_PER_THREAD));
+  }
+};
+
+} // namespace oktal
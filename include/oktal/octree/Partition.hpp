@@ -0,0 +1,61 @@
+#pragma once
+
+#include "oktal/octree/CellGrid.hpp"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace oktal {
+
+/**
+ * @brief Split of a CellGrid into contiguous ranges of the enumeration
+ */
+struct CellGridPartition {
+  // Enumeration range owned by each part
+  std::vector<EnumerationRange> parts;
+  // Sum of the cell weights of each part
+  std::vector<double> partWeights;
+  // Adjacency slots of each part pointing into another part, divided by the
+  // number of cells of the part
+  std::vector<double> surfaceToVolume;
+  // Heaviest part weight divided by the mean part weight
+  double imbalance = 1.0;
+
+  /**
+   * @brief returns the part owning cell @p enumIdx in O(log(parts))
+   *
+   * @param enumIdx
+   * @return std::size_t
+   */
+  [[nodiscard]] std::size_t partOf(std::size_t enumIdx) const;
+
+  [[nodiscard]] double maxSurfaceToVolume() const;
+};
+
+/**
+ * @brief Cuts the enumeration order of @p grid into @p numParts contiguous
+ * ranges of balanced weight
+ * @details The enumeration follows the Morton order on every level, so each
+ * range is a compact region of the domain. The cuts are placed on a parallel
+ * prefix sum of the weights, at the position whose accumulated weight is
+ * closest to an equal share.
+ *
+ * @param grid
+ * @param weights one finite, non-negative weight per cell
+ * @param numParts
+ * @throws std::invalid_argument if the number of weights does not match the
+ * grid, a weight is negative or not finite, or @p numParts is zero
+ * @return CellGridPartition
+ */
+[[nodiscard]] CellGridPartition partition(const CellGrid &grid,
+                                          std::span<const double> weights,
+                                          std::size_t numParts);
+
+/**
+ * @brief Cuts the enumeration order of @p grid into @p numParts contiguous
+ * ranges with equal numbers of cells
+ */
+[[nodiscard]] CellGridPartition partition(const CellGrid &grid,
+                                          std::size_t numParts);
+
+} // namespace oktal
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "oktal/octree/MortonIndex.hpp"
+#include <array>
+#include <concepts>
+#include <cstddef>
+
+namespace oktal {
+
+/**
+ * @brief Compile-time mapping of neighbor coordinates into the domain
+ * @details A policy provides a static map(coords, level) returning the
+ * coordinates to look up on that level. Coordinates that stay outside the
+ * grid of the level denote a missing neighbor.
+ */
+template <typename T>
+concept PeriodicityPolicy =
+    requires(SignedGridCoordinates coords, std::size_t level) {
+      { T::map(coords, level) } -> std::same_as<SignedGridCoordinates>;
+    };
+
+namespace periodicity {
+
+/**
+ * @brief Wraps the axes @p X, @p Y and @p Z at the extent of the level
+ * @details Levels span 1 << level cells per axis, so wrapping reduces to
+ * masking the two's complement coordinates.
+ */
+template <bool X, bool Y, bool Z> struct Torus {
+  static constexpr std::array<bool, 3> PERIODIC{X, Y, Z};
+
+  [[nodiscard]] static SignedGridCoordinates map(SignedGridCoordinates coords,
+                                                 std::size_t level) {
+    const std::ptrdiff_t mask = (std::ptrdiff_t{1} << level) - 1;
+    if constexpr (X) {
+      coords[0] &= mask;
+    }
+    if constexpr (Y) {
+      coords[1] &= mask;
+    }
+    if constexpr (Z) {
+      coords[2] &= mask;
+    }
+    return coords;
+  }
+};
+
+/**
+ * @brief No periodic axes, neighbors outside the domain are missing
+ */
+using None = Torus<false, false, false>;
+
+} // namespace periodicity
+
+} // namespace oktal
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "oktal/octree/CellOctree.hpp"
+#include "oktal/octree/MortonIndex.hpp"
+#include "oktal/octree/OctreeGeometry.hpp"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace oktal {
+
+/**
+ * @brief Octree whose levels are stored in reference-counted, copy-on-write
+ * chunks
+ * @details Children indices are relative to the start of the next level, so
+ * a local change of the refinement only touches the chunks of two levels.
+ * Copying a PersistentOctree (taking a snapshot) copies one pointer per
+ * level, and a modification copies just the chunks it changes. All other
+ * chunks stay shared between the snapshots. Since every level is a single
+ * chunk, refining a leaf of the finest level copies that whole level, which
+ * holds most nodes of the octree, if another snapshot shares it.
+ */
+class PersistentOctree {
+public:
+  using Node = CellOctree::Node;
+  using LevelChunk = std::vector<Node>;
+
+  PersistentOctree() : PersistentOctree(CellOctree{}) {}
+
+  explicit PersistentOctree(const CellOctree &octree);
+
+  /**
+   * @brief returns a snapshot of the current state in O(numberOfLevels())
+   *
+   * @return PersistentOctree
+   */
+  [[nodiscard]] PersistentOctree snapshot() const { return *this; }
+
+  [[nodiscard]] std::size_t numberOfLevels() const { return levels_.size(); }
+
+  [[nodiscard]] std::size_t numberOfNodes() const;
+
+  /**
+   * @brief returns the nodes of level @p level, whose children indices are
+   * relative to the start of the next level
+   *
+   * @param level
+   * @return std::span<const Node>
+   */
+  [[nodiscard]] std::span<const Node> level(std::size_t level) const {
+    if (level >= levels_.size()) {
+      return {};
+    }
+    return {*levels_[level]};
+  }
+
+  /**
+   * @brief checks whether both snapshots still share the chunk of @p level
+   *
+   * @param other
+   * @param level
+   * @return bool
+   */
+  [[nodiscard]] bool sharesLevelWith(const PersistentOctree &other,
+                                     std::size_t level) const {
+    return level < levels_.size() && level < other.levels_.size() &&
+           levels_[level] == other.levels_[level];
+  }
+
+  [[nodiscard]] const OctreeGeometry &geometry() const { return geometry_; }
+
+  /**
+   * @brief splits the leaf @p m into eight non-phantom leaves
+   *
+   * @throws std::out_of_range if the node does not exist
+   * @throws std::logic_error if the node is already refined
+   */
+  void refine(const MortonIndex &m);
+
+  /**
+   * @brief removes the eight children of @p m, which must all be leaves
+   *
+   * @throws std::out_of_range if the node does not exist
+   * @throws std::logic_error if the node is not refined or has refined
+   * children
+   */
+  void coarsen(const MortonIndex &m);
+
+  /**
+   * @brief sets the phantom flag of the node @p m
+   *
+   * @throws std::out_of_range if the node does not exist
+   */
+  void setPhantom(const MortonIndex &m, bool phantom);
+
+  /**
+   * @brief returns the state of this snapshot as a CellOctree
+   * @details The octree is assembled on the first call and shared by all
+   * copies of this snapshot until one of them is modified. Concurrent calls
+   * assemble it once.
+   *
+   * @return std::shared_ptr<const CellOctree>
+   */
+  [[nodiscard]] std::shared_ptr<const CellOctree> octree() const;
+
+private:
+  std::vector<std::shared_ptr<const LevelChunk>> levels_;
+  OctreeGeometry geometry_;
+  // Octree assembled by octree(), shared by the copies of a snapshot
+  struct Materialization {
+    std::once_flag once;
+    std::shared_ptr<const CellOctree> octree;
+  };
+  std::shared_ptr<Materialization> materialized_ =
+      std::make_shared<Materialization>();
+
+  // Returns a writable chunk, copying it first if it is shared
+  LevelChunk &mutableLevel(std::size_t level);
+
+  // Returns the index of @p m within its level
+  [[nodiscard]] std::size_t locate(const MortonIndex &m) const;
+
+  // Assembles the CellOctree of this snapshot into materialized_
+  void materialize() const;
+};
+
+} // namespace oktal
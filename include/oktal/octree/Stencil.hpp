@@ -0,0 +1,164 @@
+#pragma once
+
+#include "oktal/octree/CellGrid.hpp"
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace oktal {
+
+/**
+ * @brief Adjacency offset known at compile time
+ */
+template <std::ptrdiff_t X, std::ptrdiff_t Y, std::ptrdiff_t Z> struct Offset {
+  static constexpr std::ptrdiff_t x = X;
+  static constexpr std::ptrdiff_t y = Y;
+  static constexpr std::ptrdiff_t z = Z;
+
+  [[nodiscard]] static AdjacencyOffset value() { return {X, Y, Z}; }
+};
+
+namespace detail {
+template <typename T> struct IsOffset : std::false_type {};
+
+template <std::ptrdiff_t X, std::ptrdiff_t Y, std::ptrdiff_t Z>
+struct IsOffset<Offset<X, Y, Z>> : std::true_type {};
+
+template <typename... Ts> struct AreDistinct : std::true_type {};
+
+template <typename T, typename... Ts>
+struct AreDistinct<T, Ts...>
+    : std::bool_constant<(!std::is_same_v<T, Ts> && ...) &&
+                         AreDistinct<Ts...>::value> {};
+} // namespace detail
+
+/**
+ * @brief Neighborhood of a cell as a list of compile-time offsets
+ * @details The position of an offset in the list is its adjacency slot, so
+ * slot lookups are resolved by the compiler.
+ *
+ * @tparam Offsets distinct Offset types
+ */
+template <typename... Offsets> struct Stencil {
+  static_assert((detail::IsOffset<Offsets>::value && ...),
+                "Stencil entries must be Offset types!");
+  static_assert(detail::AreDistinct<Offsets...>::value,
+                "Stencil offsets must be distinct!");
+
+  static constexpr std::size_t size = sizeof...(Offsets);
+
+  /**
+   * @brief returns the slot of @p TOffset within the stencil
+   */
+  template <typename TOffset>
+  static consteval std::size_t slotOf() {
+    constexpr std::array<bool, size> matches{
+        std::is_same_v<TOffset, Offsets>...};
+    for (std::size_t slot = 0; slot < size; ++slot) {
+      if (matches[slot]) {
+        return slot;
+      }
+    }
+    throw "Offset is not part of the stencil";
+  }
+
+  [[nodiscard]] static std::array<AdjacencyOffset, size> offsets() {
+    return {Offsets::value()...};
+  }
+};
+
+/**
+ * @brief CellGrid with interleaved adjacency for the stencil @p TStencil
+ * @details Created by CellGridBuilder::build(TStencil). Neighbor accesses
+ * index the interleaved adjacency with slots known at compile time. The grid
+ * itself is read-only, since renumbering or rebuilding it would break the
+ * stencil layout; its fields are accessed through the StencilGrid.
+ *
+ * @tparam TStencil
+ */
+template <typename TStencil> class StencilGrid {
+public:
+  using StencilType = TStencil;
+  static constexpr std::size_t STENCIL_SIZE = TStencil::size;
+
+  explicit StencilGrid(CellGrid grid) : grid_(std::move(grid)) {}
+
+  [[nodiscard]] const CellGrid &grid() const { return grid_; }
+
+  [[nodiscard]] std::size_t size() const { return grid_.size(); }
+
+  [[nodiscard]] FieldRegistry &fields() { return grid_.fields(); }
+
+  [[nodiscard]] const FieldRegistry &fields() const { return grid_.fields(); }
+
+  /**
+   * @brief adds a zero-initialised per-cell field, see CellGrid::addField
+   */
+  template <typename T> FieldHandle<T> addField(std::string name) {
+    return grid_.addField<T>(std::move(name));
+  }
+
+  template <typename T> [[nodiscard]] auto field(FieldHandle<T> handle) {
+    return grid_.field(handle);
+  }
+
+  template <typename T> [[nodiscard]] auto field(FieldHandle<T> handle) const {
+    return grid_.field(handle);
+  }
+
+  /**
+   * @brief returns the neighbor of cell @p enumIdx in slot @p I
+   *
+   * @return CompactNeighborIndex, CellGrid::NO_COMPACT_NEIGHBOR if there is
+   * none
+   */
+  template <std::size_t I>
+  [[nodiscard]] CompactNeighborIndex neighbor(std::size_t enumIdx) const {
+    static_assert(I < STENCIL_SIZE, "Slot exceeds the stencil!");
+    return grid_.interleavedAdjacency_[enumIdx * STENCIL_SIZE + I];
+  }
+
+  /**
+   * @brief returns the neighbor of cell @p enumIdx through offset @p TOffset
+   */
+  template <typename TOffset>
+  [[nodiscard]] CompactNeighborIndex neighbor(std::size_t enumIdx) const {
+    return neighbor<TStencil::template slotOf<TOffset>()>(enumIdx);
+  }
+
+  [[nodiscard]] std::span<const CompactNeighborIndex, STENCIL_SIZE>
+  neighbors(std::size_t enumIdx) const {
+    return std::span<const CompactNeighborIndex, STENCIL_SIZE>{
+        grid_.interleavedAdjacency_.data() + enumIdx * STENCIL_SIZE,
+        STENCIL_SIZE};
+  }
+
+  /**
+   * @brief calls @p func(slot, neighbor) for every slot of cell @p enumIdx,
+   * unrolled at compile time
+   */
+  template <typename TFunc>
+  void forEachNeighbor(std::size_t enumIdx, TFunc &&func) const {
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (func(std::integral_constant<std::size_t, I>{}, neighbor<I>(enumIdx)),
+       ...);
+    }(std::make_index_sequence<STENCIL_SIZE>{});
+  }
+
+private:
+  CellGrid grid_;
+};
+
+template <typename... Offsets>
+StencilGrid<Stencil<Offsets...>>
+CellGridBuilder::build(Stencil<Offsets...> /*stencil*/) {
+  const auto offsets = Stencil<Offsets...>::offsets();
+  adjacencyOffsets_.assign(offsets.begin(), offsets.end());
+  adjacencyLayout_ = AdjacencyLayout::Interleaved;
+  return StencilGrid<Stencil<Offsets...>>{build()};
+}
+
+} // namespace oktal
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace oktal::solver {
+
+/**
+ * @brief returns the instruction set the dense stencil kernels were compiled
+ * for: "AVX-512", "AVX2" or "scalar"
+ * @details The vector kernels need the instruction set at compile time, e.g.
+ * through the CMake option OKTAL_NATIVE_ARCH.
+ */
+[[nodiscard]] std::string_view denseKernelInstructionSet();
+
+/**
+ * @brief Jacobi sweep for -laplace(u) = f on a dense cube of cells, fused
+ * with the residual of u
+ * @details The fields hold extent^3 values in the layout of
+ * UniformLevelView. Every cell off the outermost layer gets
+ * uNext = (h^2 f + s) / 6 and residual = f + (s - 6 u) / h^2, where s sums
+ * the face neighbors of u in the order -x, +x, -y, +y, -z, +z like the
+ * stencils of a CellGrid do. The outermost layer of @p uNext and
+ * @p residual is left untouched. Rows along x are vectorised, and the
+ * z-planes are split between threads; the partial sums of every thread are
+ * added in order.
+ *
+ * @param extent number of cells along every axis
+ * @param h cell width
+ * @param u
+ * @param uNext must not overlap @p u
+ * @param f
+ * @param residual
+ * @throws std::invalid_argument if a field holds fewer than extent^3 values
+ * @return double, the sum of the squared residuals of the updated cells
+ */
+double denseJacobiSweep(std::size_t extent, double h, std::span<const double> u,
+                        std::span<double> uNext, std::span<const double> f,
+                        std::span<double> residual);
+
+} // namespace oktal::solver
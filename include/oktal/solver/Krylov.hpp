@@ -0,0 +1,191 @@
+#pragma once
+
+#include "oktal/octree/CellGrid.hpp"
+#include "oktal/solver/Multigrid.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace oktal::solver {
+
+/**
+ * @brief Matrix-free 7-point discretisation of -laplace(u) on a CellGrid of
+ * one level
+ * @details Applied straight from the face adjacency, which needs
+ * AdjacencyLayout::PerOffset. The unknowns are the cells with all six face
+ * neighbors; the other cells hold Dirichlet values. Vectors cover all cells
+ * of the grid, and the operator maps them to zero on the boundary cells, so
+ * Krylov iterates keep the Dirichlet values when they start from them.
+ */
+class PoissonOperator {
+public:
+  static constexpr std::size_t NUM_FACES = 6;
+
+  /**
+   * @param grid must outlive the operator
+   * @throws std::out_of_range if the grid lacks a face offset
+   * @throws std::logic_error if the grid has interleaved adjacency
+   * @throws std::invalid_argument if the cells span several levels
+   */
+  explicit PoissonOperator(const CellGrid &grid);
+
+  [[nodiscard]] const CellGrid &grid() const { return *grid_; }
+
+  [[nodiscard]] std::size_t size() const { return grid_->size(); }
+
+  [[nodiscard]] double inverseH2() const { return inverseH2_; }
+
+  [[nodiscard]] std::span<const AdjacencyListView, NUM_FACES>
+  neighbors() const {
+    return neighbors_;
+  }
+
+  /**
+   * @brief computes y = A x and returns the dot product of x and y
+   */
+  double apply(std::span<const double> x, std::span<double> y) const;
+
+  /**
+   * @brief computes r = f - A u on the unknowns, zero elsewhere, and returns
+   * the squared Euclidean norm of r
+   */
+  double residual(std::span<const double> u, std::span<const double> f,
+                  std::span<double> r) const;
+
+private:
+  const CellGrid *grid_;
+  double inverseH2_;
+  std::array<AdjacencyListView, NUM_FACES> neighbors_;
+  // One per cell, nonzero for the unknowns
+  std::vector<std::uint8_t> unknown_;
+};
+
+/**
+ * @brief Approximate inverse of a PoissonOperator applied in every Krylov
+ * iteration
+ * @details Implementations map residuals to corrections that vanish on the
+ * boundary cells.
+ */
+class Preconditioner {
+public:
+  Preconditioner() = default;
+  virtual ~Preconditioner() = default;
+  Preconditioner(const Preconditioner &) = default;
+  Preconditioner(Preconditioner &&) = default;
+  Preconditioner &operator=(const Preconditioner &) = default;
+  Preconditioner &operator=(Preconditioner &&) = default;
+
+  /**
+   * @brief computes z = M^-1 r
+   */
+  virtual void apply(std::span<const double> r, std::span<double> z) = 0;
+};
+
+class IdentityPreconditioner : public Preconditioner {
+public:
+  void apply(std::span<const double> r, std::span<double> z) override;
+};
+
+/**
+ * @brief Divides by the diagonal of the operator
+ */
+class JacobiPreconditioner : public Preconditioner {
+public:
+  explicit JacobiPreconditioner(const PoissonOperator &op) : op_(&op) {}
+
+  void apply(std::span<const double> r, std::span<double> z) override;
+
+private:
+  const PoissonOperator *op_;
+};
+
+/**
+ * @brief Symmetric successive over-relaxation in red-black order
+ * @details A forward sweep over the colors of CellGrid::coloring() followed
+ * by a backward sweep, starting from zero. The cells of a color are updated
+ * in parallel, and the result is a symmetric preconditioner.
+ */
+class SsorPreconditioner : public Preconditioner {
+public:
+  explicit SsorPreconditioner(const PoissonOperator &op, double omega = 1.0);
+
+  void apply(std::span<const double> r, std::span<double> z) override;
+
+private:
+  const PoissonOperator *op_;
+  double omega_;
+  // Unknowns per color
+  std::vector<std::vector<std::size_t>> colors_;
+
+  void sweep(const std::vector<std::size_t> &cells, std::span<const double> r,
+             std::span<double> z) const;
+};
+
+/**
+ * @brief One multigrid cycle with zero initial guess
+ * @details The finest level of the multigrid solver has to match the grid of
+ * the operator. The cycle is symmetric, as conjugateGradient() requires, if
+ * the multigrid solver uses Cycle::V or Cycle::W, Prolongation::Constant,
+ * whose transpose is a multiple of the averaging restriction, as many pre-
+ * as post-smoothing sweeps and an even number of coarse sweeps. The
+ * trilinear prolongation and F-cycles are only suited for biCgStab().
+ */
+class MultigridPreconditioner : public Preconditioner {
+public:
+  explicit MultigridPreconditioner(PoissonMultigrid &multigrid)
+      : multigrid_(&multigrid) {}
+
+  void apply(std::span<const double> r, std::span<double> z) override;
+
+private:
+  PoissonMultigrid *multigrid_;
+};
+
+struct KrylovOptions {
+  std::size_t maxIterations = 1000;
+  // Bound on the Euclidean norm of the residual
+  double tolerance = 1e-8;
+};
+
+struct KrylovResult {
+  std::size_t iterations;
+  double residualNorm;
+  bool converged;
+};
+
+/**
+ * @brief solves A u = f with the preconditioned conjugate gradient method
+ * @details Updates of the iterate and the residual share one sweep with the
+ * residual norm, and the operator application computes the curvature
+ * p^T A p on the fly. Reductions are deterministic.
+ *
+ * @param op
+ * @param u initial guess holding the Dirichlet values, overwritten by the
+ * solution
+ * @param f
+ * @param preconditioner symmetric positive definite
+ * @param options
+ * @throws std::invalid_argument if a field does not cover the grid
+ * @return KrylovResult
+ */
+KrylovResult conjugateGradient(const PoissonOperator &op, std::span<double> u,
+                               std::span<const double> f,
+                               Preconditioner &preconditioner,
+                               const KrylovOptions &options = {});
+
+/**
+ * @brief solves A u = f with the right-preconditioned BiCGStab method
+ * @details Applicable with preconditioners that are not symmetric. Dot
+ * products are fused pairwise into single sweeps.
+ *
+ * @throws std::invalid_argument if a field does not cover the grid
+ * @return KrylovResult
+ */
+KrylovResult biCgStab(const PoissonOperator &op, std::span<double> u,
+                      std::span<const double> f,
+                      Preconditioner &preconditioner,
+                      const KrylovOptions &options = {});
+
+} // namespace oktal::solver
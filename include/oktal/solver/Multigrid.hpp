@@ -0,0 +1,137 @@
+#pragma once
+
+#include "oktal/octree/CellGrid.hpp"
+#include "oktal/octree/GridHierarchy.hpp"
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace oktal::solver {
+
+/**
+ * @brief Order in which a multigrid cycle visits the coarser levels
+ */
+enum class Cycle {
+  // One coarse-grid correction per level
+  V,
+  // Two coarse-grid corrections per level
+  W,
+  // An F-cycle followed by a V-cycle on the next coarser level
+  F
+};
+
+struct MultigridOptions {
+  Cycle cycle = Cycle::V;
+  // Red-black Gauss-Seidel sweeps before and after the coarse-grid correction
+  std::size_t preSmoothing = 2;
+  std::size_t postSmoothing = 2;
+  // Red-black Gauss-Seidel sweeps solving the coarsest level, alternating
+  // between forward and backward color order
+  std::size_t coarseSweeps = 64;
+  Prolongation prolongation = Prolongation::Trilinear;
+};
+
+/**
+ * @brief Geometric multigrid for the Poisson equation -laplace(u) = f,
+ * discretised with the 7-point stencil on the levels of a GridHierarchy
+ * @details Every level needs the six face offsets with
+ * AdjacencyLayout::PerOffset. On the finest level of the hierarchy, cells
+ * lacking a face neighbor hold Dirichlet values and are never updated. The
+ * coarse levels solve for the correction on all of their cells; there the
+ * correction vanishes at the centers of the finest boundary cells, which
+ * is imposed through linearly extrapolated ghost values.
+ */
+class PoissonMultigrid {
+public:
+  static constexpr std::size_t NUM_FACES = 6;
+
+  /**
+   * @brief sets up the smoothers and work arrays of all levels
+   *
+   * @param hierarchy must outlive the solver
+   * @param options
+   * @throws std::out_of_range if a level lacks a face offset
+   * @throws std::logic_error if a level has interleaved adjacency
+   * @throws std::invalid_argument if no cell of the finest level has all
+   * face neighbors
+   */
+  explicit PoissonMultigrid(const GridHierarchy &hierarchy,
+                            MultigridOptions options = {});
+
+  [[nodiscard]] std::size_t finestLevel() const { return levels_.back().lvl; }
+
+  [[nodiscard]] std::size_t coarsestLevel() const {
+    return levels_.front().lvl;
+  }
+
+  /**
+   * @brief performs one cycle on the finest level
+   *
+   * @param u solution, holds the Dirichlet values of the boundary cells
+   * @param f right-hand side
+   * @throws std::invalid_argument if a field does not cover the finest grid
+   */
+  void cycle(std::span<double> u, std::span<const double> f);
+
+  /**
+   * @brief computes f + laplace(u) on the finest level, zero on boundary
+   * cells
+   *
+   * @return double, the Euclidean norm of @p residual
+   */
+  double residual(std::span<const double> u, std::span<const double> f,
+                  std::span<double> residual) const;
+
+  /**
+   * @brief returns the wall-clock seconds spent on every level of the
+   * hierarchy, indexed by level, since construction
+   *
+   * @return std::span<const double>
+   */
+  [[nodiscard]] std::span<const double> levelSeconds() const {
+    return seconds_;
+  }
+
+private:
+  struct Level {
+    std::size_t lvl;
+    double inverseH2;
+    // Face neighbors of every cell; missing neighbors refer to the entry
+    // behind the cells of the work arrays, which stays zero
+    std::array<std::vector<std::size_t>, NUM_FACES> neighbors;
+    // Diagonal of the stencil including the ghost values
+    std::vector<double> diagonal;
+    // Cells that are updated, ascending and per color of the red-black
+    // ordering
+    std::vector<std::size_t> unknowns;
+    std::vector<std::vector<std::size_t>> colors;
+    // Work arrays, the finest level uses the caller's fields for u and f
+    std::vector<double> u;
+    std::vector<double> f;
+    std::vector<double> r;
+    std::vector<double> correction;
+  };
+
+  const GridHierarchy *hierarchy_;
+  MultigridOptions options_;
+  // Levels from the coarsest to the finest
+  std::vector<Level> levels_;
+  std::vector<double> seconds_;
+
+  void cycleOn(std::size_t index, std::span<double> u,
+               std::span<const double> f, Cycle type);
+
+  // Post-smoothing visits the colors in reverse order of pre-smoothing
+  enum class SweepOrder { Forward, Backward };
+
+  void smooth(const Level &level, std::span<double> u,
+              std::span<const double> f, std::size_t sweeps,
+              SweepOrder order) const;
+
+  void computeResidual(const Level &level, std::span<const double> u,
+                       std::span<const double> f,
+                       std::span<double> residual) const;
+};
+
+} // namespace oktal::solver
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace oktal {
+
+/**
+ * @brief Allocator returning storage aligned to @p Alignment bytes
+ * @details With huge pages enabled, allocations of at least one huge page are
+ * aligned to the huge page size and, on Linux, advised to be backed by
+ * transparent huge pages. Elsewhere the flag only affects the alignment.
+ *
+ * @tparam T
+ * @tparam Alignment power of two, at least alignof(T)
+ */
+template <typename T, std::size_t Alignment = 64> class AlignedAllocator {
+  static_assert((Alignment & (Alignment - 1)) == 0 && Alignment >= alignof(T),
+                "Alignment must be a power of two of at least alignof(T)!");
+
+public:
+  using value_type = T;
+
+  static constexpr std::size_t HUGE_PAGE_SIZE = 2uz << 20;
+
+  template <typename U> struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() noexcept = default;
+
+  explicit AlignedAllocator(bool hugePages) noexcept : hugePages_(hugePages) {}
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &other) noexcept
+      : hugePages_(other.hugePages()) {}
+
+  [[nodiscard]] bool hugePages() const noexcept { return hugePages_; }
+
+  [[nodiscard]] T *allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    const std::size_t bytes = n * sizeof(T);
+    if (!useHugePages(bytes)) {
+      return static_cast<T *>(
+          ::operator new(bytes, std::align_val_t{Alignment}));
+    }
+
+    const std::size_t rounded =
+        (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void *ptr = ::operator new(rounded, std::align_val_t{HUGE_PAGE_SIZE});
+#ifdef __linux__
+    // Only a hint, the kernel may still use regular pages
+    ::madvise(ptr, rounded, MADV_HUGEPAGE);
+#endif
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, std::size_t n) noexcept {
+    const std::size_t bytes = n * sizeof(T);
+    if (!useHugePages(bytes)) {
+      ::operator delete(ptr, std::align_val_t{Alignment});
+    } else {
+      ::operator delete(ptr, std::align_val_t{HUGE_PAGE_SIZE});
+    }
+  }
+
+  template <typename U>
+  [[nodiscard]] bool
+  operator==(const AlignedAllocator<U, Alignment> &other) const noexcept {
+    return hugePages_ == other.hugePages();
+  }
+
+private:
+  bool hugePages_ = false;
+
+  [[nodiscard]] bool useHugePages(std::size_t bytes) const noexcept {
+    return hugePages_ && bytes >= HUGE_PAGE_SIZE;
+  }
+};
+
+} // namespace oktal
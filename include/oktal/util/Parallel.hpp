@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace oktal::parallel {
+
+namespace detail {
+inline std::atomic<std::size_t> &threadCountSetting() {
+  static std::atomic<std::size_t> setting{0};
+  return setting;
+}
+} // namespace detail
+
+/**
+ * @brief returns the number of threads used by the parallel kernels of the
+ * library; defaults to the number of hardware threads
+ *
+ * @return std::size_t
+ */
+[[nodiscard]] inline std::size_t numberOfThreads() {
+  const std::size_t setting = detail::threadCountSetting().load();
+  if (setting != 0) {
+    return setting;
+  }
+  return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief sets the number of threads used by the parallel kernels of the
+ * library; zero restores the default
+ *
+ * @param numThreads
+ */
+inline void setNumberOfThreads(std::size_t numThreads) {
+  detail::threadCountSetting().store(numThreads);
+}
+
+/**
+ * @brief returns the number of threads for a kernel over @p n items that
+ * gives every thread at least @p minItemsPerThread items, so that small
+ * kernels do not pay for starting threads
+ */
+[[nodiscard]] inline std::size_t threadsFor(std::size_t n,
+                                            std::size_t minItemsPerThread) {
+  return std::clamp<std::size_t>(n / minItemsPerThread, 1, numberOfThreads());
+}
+
+/**
+ * @brief returns the start of chunk @p chunk when [0, n) is split into
+ * @p numChunks contiguous chunks of (almost) equal size
+ */
+[[nodiscard]] inline std::size_t chunkBegin(std::size_t n, std::size_t chunk,
+                                            std::size_t numChunks) {
+  return n / numChunks * chunk + std::min(chunk, n % numChunks);
+}
+
+/**
+ * @brief splits [0, n) into contiguous chunks and calls
+ * @p func(begin, end, chunk) for every chunk on its own thread
+ * @details The calling thread processes the first chunk. The chunks only
+ * depend on @p n and @p numThreads, so reductions over per-chunk results are
+ * deterministic.
+ *
+ * @param n
+ * @param func
+ * @param numThreads
+ */
+template <typename TFunc>
+void forChunks(std::size_t n, TFunc &&func,
+               std::size_t numThreads = numberOfThreads()) {
+  numThreads = std::clamp<std::size_t>(numThreads, 1, std::max(n, 1uz));
+  if (numThreads == 1) {
+    func(0uz, n, 0uz);
+    return;
+  }
+
+  {
+    std::vector<std::jthread> threads;
+    threads.reserve(numThreads - 1);
+    for (std::size_t chunk = 1; chunk < numThreads; ++chunk) {
+      threads.emplace_back([&func, n, chunk, numThreads]() {
+        func(chunkBegin(n, chunk, numThreads),
+             chunkBegin(n, chunk + 1, numThreads), chunk);
+      });
+    }
+    func(0uz, chunkBegin(n, 1, numThreads), 0uz);
+  }
+}
+
+/**
+ * @brief calls @p func(i) for every i in [0, n) in parallel
+ */
+template <typename TFunc>
+void forEach(std::size_t n, TFunc &&func,
+             std::size_t numThreads = numberOfThreads()) {
+  forChunks(
+      n,
+      [&func](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          func(i);
+        }
+      },
+      numThreads);
+}
+
+/**
+ * @brief computes the inclusive prefix sum of @p in into @p out in parallel
+ * @details Every chunk is scanned locally, then the chunk totals are
+ * accumulated and added to the following chunks.
+ *
+ * @param in
+ * @param out may alias @p in
+ * @param numThreads
+ */
+template <typename T>
+void inclusiveScan(std::span<const T> in, std::span<T> out,
+                   std::size_t numThreads = numberOfThreads()) {
+  const std::size_t n = in.size();
+  numThreads = std::clamp<std::size_t>(numThreads, 1, std::max(n, 1uz));
+  std::vector<T> chunkTotals(numThreads, T{});
+
+  forChunks(
+      n,
+      [&](std::size_t begin, std::size_t end, std::size_t chunk) {
+        T sum{};
+        for (std::size_t i = begin; i < end; ++i) {
+          sum += in[i];
+          out[i] = sum;
+        }
+        chunkTotals[chunk] = sum;
+      },
+      numThreads);
+
+  std::vector<T> chunkOffsets(numThreads, T{});
+  for (std::size_t chunk = 1; chunk < numThreads; ++chunk) {
+    chunkOffsets[chunk] = chunkOffsets[chunk - 1] + chunkTotals[chunk - 1];
+  }
+
+  forChunks(
+      n,
+      [&](std::size_t begin, std::size_t end, std::size_t chunk) {
+        if (chunk == 0) {
+          return;
+        }
+        for (std::size_t i = begin; i < end; ++i) {
+          out[i] += chunkOffsets[chunk];
+        }
+      },
+      numThreads);
+}
+
+} // namespace oktal::parallel
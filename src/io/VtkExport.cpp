@@ -1,9 +1,12 @@
 #include "oktal/io/VtkExport.hpp"
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iterator>
 #include <queue>
+#include <stdexcept>
 #include <tuple>
+#include <typeinfo>
 
 using advpt::htgfile::HyperTree;
 using advpt::htgfile::SnapshotHtgFile;
@@ -108,4 +111,26 @@ void exportOctree(const CellOctree &octree,
 exportCellGrid(const CellGrid &grid, const std::filesystem::path &filepath) {
   return {grid, createHtgFile(grid.octree(), filepath)};
 }
+
+CellGridExporter &CellGridExporter::writeFields() {
+  const auto &fields = pGrid->fields();
+  for (std::size_t index = 0; index < fields.size(); ++index) {
+    const auto info = fields.info(index);
+    if (info.componentType == typeid(double)) {
+      writeFieldComponents<double>(index, info);
+    } else if (info.componentType == typeid(float)) {
+      writeFieldComponents<float>(index, info);
+    } else if (info.componentType == typeid(std::int32_t)) {
+      writeFieldComponents<std::int32_t>(index, info);
+    } else if (info.componentType == typeid(std::int64_t)) {
+      writeFieldComponents<std::int64_t>(index, info);
+    } else {
+      throw std::invalid_argument(
+          std::format("Field '{}' has a component type that cannot be "
+                      "exported!",
+                      info.name));
+    }
+  }
+  return *this;
+}
 }; // namespace oktal::io::vtk
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "oktal/octree/CellForest.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <format>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using oktal::CellForest;
+using oktal::CellOctree;
+using oktal::UnsignedGridCoordinates;
+
+// Origin of a node of the shared octree during construction: either a node
+// above the tree roots, identified by its grid coordinates, or a node of one
+// of the trees
+struct NodeSource {
+  std::size_t tree;
+  std::size_t streamIndex;
+  UnsignedGridCoordinates coords;
+};
+
+UnsignedGridCoordinates childCoordinates(const UnsignedGridCoordinates &coords,
+                                         std::size_t branch) {
+  return {(coords[0] << 1) | (branch & 1),
+          (coords[1] << 1) | ((branch >> 1) & 1),
+          (coords[2] << 1) | ((branch >> 2) & 1)};
+}
+
+bool insideBrick(const UnsignedGridCoordinates &coords,
+                 const CellForest::TreeExtents &extents, std::size_t shift) {
+  for (std::size_t i = 0; i < 3; ++i) {
+    if ((coords[i] << shift) >= extents.at(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::size_t lexicographicIndex(const UnsignedGridCoordinates &coords,
+                               const CellForest::TreeExtents &extents) {
+  return coords[0] + extents[0] * (coords[1] + extents[1] * coords[2]);
+}
+
+} // namespace
+
+namespace oktal {
+
+CellForest::CellForest(const TreeExtents &treesPerAxis, const Vec3D &origin,
+                       double treeSidelength, std::span<const CellOctree> trees)
+    : treesPerAxis_(treesPerAxis) {
+  if (treesPerAxis[0] == 0 || treesPerAxis[1] == 0 || treesPerAxis[2] == 0) {
+    throw std::invalid_argument("A forest needs at least one tree per axis!");
+  }
+  if (trees.size() != numberOfTrees()) {
+    throw std::invalid_argument(
+        std::format("Expected {} trees, but {} were passed!", numberOfTrees(),
+                    trees.size()));
+  }
+
+  const std::size_t maxExtent =
+      std::max({treesPerAxis[0], treesPerAxis[1], treesPerAxis[2]});
+  rootLevel_ = static_cast<std::size_t>(std::bit_width(maxExtent - 1));
+
+  // Level by level: nodes above the roots are phantoms refined towards the
+  // brick, and the levels below the roots concatenate the levels of the trees
+  std::vector<CellOctree::Node> nodes;
+  std::vector<std::pair<std::size_t, std::size_t>> levels;
+  std::vector<NodeSource> current{{NO_TREE, 0, {0, 0, 0}}};
+  std::vector<NodeSource> next;
+
+  for (std::size_t level = 0; !current.empty(); ++level) {
+    levels.emplace_back(nodes.size(), current.size());
+    const std::size_t nextLevelStart = nodes.size() + current.size();
+    next.clear();
+
+    for (NodeSource source : current) {
+      if (source.tree == NO_TREE) {
+        const std::size_t shift = rootLevel_ - level;
+        if (!insideBrick(source.coords, treesPerAxis_, shift)) {
+          nodes.emplace_back(false, true);
+          continue;
+        }
+        if (level < rootLevel_) {
+          nodes.emplace_back(true, true, nextLevelStart + next.size());
+          for (std::size_t branch = 0; branch < 8; ++branch) {
+            next.push_back(
+                {NO_TREE, 0, childCoordinates(source.coords, branch)});
+          }
+          continue;
+        }
+        source.tree = lexicographicIndex(source.coords, treesPerAxis_);
+      }
+
+      const auto &node = trees[source.tree].nodesStream()[source.streamIndex];
+      if (!node.isRefined()) {
+        nodes.emplace_back(false, node.isPhantom());
+      } else {
+        nodes.emplace_back(true, node.isPhantom(),
+                           nextLevelStart + next.size());
+        for (std::size_t branch = 0; branch < 8; ++branch) {
+          next.push_back({source.tree, node.childIndex(branch), {}});
+        }
+      }
+    }
+    std::swap(current, next);
+  }
+
+  const OctreeGeometry geometry{
+      origin, treeSidelength * static_cast<double>(1uz << rootLevel_)};
+  octree_ = std::make_shared<const CellOctree>(std::move(nodes),
+                                               std::move(levels), geometry);
+}
+
+CellForest CellForest::createUniform(const TreeExtents &treesPerAxis,
+                                     std::size_t treeLevel, const Vec3D &origin,
+                                     double treeSidelength) {
+  const auto tree = CellOctree::createUniformGrid(treeLevel);
+  const std::vector<CellOctree> trees(
+      treesPerAxis[0] * treesPerAxis[1] * treesPerAxis[2], *tree);
+  return {treesPerAxis, origin, treeSidelength, trees};
+}
+
+MortonIndex CellForest::treeRoot(std::size_t tree) const {
+  const std::size_t x = tree % treesPerAxis_[0];
+  const std::size_t y = (tree / treesPerAxis_[0]) % treesPerAxis_[1];
+  const std::size_t z = tree / (treesPerAxis_[0] * treesPerAxis_[1]);
+  return MortonIndex::fromGridCoordinates(rootLevel_, {x, y, z});
+}
+
+std::size_t CellForest::treeOf(const MortonIndex &m) const {
+  if (m.level() < rootLevel_) {
+    return NO_TREE;
+  }
+  const MortonIndex root{m.getBits() >> (3 * (m.level() - rootLevel_))};
+  const auto coords = root.gridCoordinates();
+  if (!insideBrick(coords, treesPerAxis_, 0)) {
+    return NO_TREE;
+  }
+  return lexicographicIndex(coords, treesPerAxis_);
+}
+
+SignedGridCoordinates
+ForestTorus::getNeighborCoordinates(SignedGridCoordinates goalCoords,
+                                    size_t lvl) const {
+  if (lvl < rootLevel_) {
+    return goalCoords;
+  }
+
+  SignedGridCoordinates resultCoords;
+  for (size_t i = 0; i < goalCoords.size(); ++i) {
+    const auto size =
+        static_cast<std::ptrdiff_t>(treesPerAxis_.at(i) << (lvl - rootLevel_));
+    if (periodic_.at(i)) {
+      // wrap into [0, size)
+      resultCoords[i] = (goalCoords[i] % size + size) % size;
+    } else {
+      resultCoords[i] = goalCoords[i];
+    }
+  }
+  return resultCoords;
+}
+
+} // namespace oktal
@@ -1,24 +1,18 @@
 #include "oktal/octree/CellOctree.hpp"
 #include "oktal/octree/MortonIndex.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <initializer_list>
+#include <limits>
+#include <map>
 #include <numeric>
 #include <oktal/octree/CellGrid.hpp>
-#include <unordered_map>
-
-namespace std {
-
-// This hashing function is necessary to create an unordered map for
-// UnsignedGridCoordinates
-template <> struct hash<oktal::UnsignedGridCoordinates> {
-  size_t operator()(const oktal::UnsignedGridCoordinates &v) const noexcept {
-    const size_t h1 = std::hash<size_t>{}(v[0]);
-    const size_t h2 = std::hash<size_t>{}(v[1]);
-    const size_t h3 = std::hash<size_t>{}(v[2]);
-    return h1 ^ (h2 << 1) ^ (h3 << 2);
-  }
-};
-} // namespace std
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace {
 
@@ -37,11 +31,727 @@ toUnsigned(const oktal::SignedGridCoordinates &coords) {
           static_cast<size_t>(coords[2])};
 }
 
-// Check if signed coordinates are valid (non-negative)
-inline bool isInvalidCoordinates(const oktal::SignedGridCoordinates &coords) {
-  return (coords[0] < 0 || coords[1] < 0 || coords[2] < 0);
+// Check if signed coordinates lie outside the grid of level lvl
+inline bool isInvalidCoordinates(const oktal::SignedGridCoordinates &coords,
+                                 size_t lvl) {
+  const std::ptrdiff_t gridExtent = std::ptrdiff_t{1} << lvl;
+  return std::ranges::any_of(coords, [gridExtent](std::ptrdiff_t coord) {
+    return coord < 0 || coord >= gridExtent;
+  });
+}
+
+// Check if the region at coords on level lvl lies outside the domain of the
+// octree, i.e. past the grid extent or inside a phantom leaf padding it
+bool isOutsideDomain(const oktal::CellOctree &octree,
+                     const oktal::SignedGridCoordinates &coords, size_t lvl) {
+  if (isInvalidCoordinates(coords, lvl)) {
+    return true;
+  }
+  const auto &nodes = octree.nodesStream();
+  const auto goalBits =
+      oktal::MortonIndex::fromGridCoordinates(lvl, toUnsigned(coords))
+          .getBits();
+  size_t streamIndex = 0;
+  for (size_t depth = 0; depth < lvl && nodes[streamIndex].isRefined();
+       ++depth) {
+    const size_t shift = 3 * (lvl - depth - 1);
+    streamIndex = nodes[streamIndex].childIndex((goalBits >> shift) & 7);
+  }
+  return nodes[streamIndex].isPhantom() && !nodes[streamIndex].isRefined();
+}
+
+// Writes the Morton indices of the non-phantom nodes of every enumerated level
+// to mortonIndices, starting at the enumeration start of the level. The levels
+// are swept top-down, deriving the Morton bits of the children from those of
+// their parents, so every node is visited once.
+void enumerateLevels(const oktal::CellOctree &octree,
+                     std::span<const size_t> levelEnumStart,
+                     std::span<oktal::MortonIndex> mortonIndices) {
+  const auto &levels = octree.getLevels();
+  size_t lastLevel = 0;
+  for (size_t lvl = 0; lvl < levelEnumStart.size(); ++lvl) {
+    if (levelEnumStart[lvl] != oktal::CellGrid::NOT_ENUMERATED) {
+      lastLevel = lvl;
+    }
+  }
+
+  const auto &nodes = octree.nodesStream();
+  std::vector<oktal::morton_bits_t> levelBits{1};
+  std::vector<oktal::morton_bits_t> nextBits;
+  for (size_t lvl = 0; lvl <= lastLevel && lvl < levels.size(); ++lvl) {
+    const auto [levelStart, levelSize] = levels[lvl];
+    const size_t enumStart = levelEnumStart[lvl];
+    const size_t rankStart = octree.nonPhantomRank(levelStart);
+    const bool hasNextLevel = lvl < lastLevel && lvl + 1 < levels.size();
+    const size_t nextLevelStart = hasNextLevel ? levels[lvl + 1].first : 0;
+    nextBits.resize(hasNextLevel ? levels[lvl + 1].second : 0);
+
+    oktal::parallel::forEach(levelSize, [&](size_t i) {
+      const auto &node = nodes[levelStart + i];
+      if (enumStart != oktal::CellGrid::NOT_ENUMERATED && !node.isPhantom()) {
+        mortonIndices[enumStart + octree.nonPhantomRank(levelStart + i) -
+                      rankStart] = oktal::MortonIndex{levelBits[i]};
+      }
+      if (hasNextLevel && node.isRefined()) {
+        const size_t firstChild = node.childrenStartIndex() - nextLevelStart;
+        for (size_t branch = 0; branch < 8; ++branch) {
+          nextBits[firstChild + branch] = (levelBits[i] << 3) | branch;
+        }
+      }
+    });
+    std::swap(levelBits, nextBits);
+  }
+}
+
+// Level-wise Morton enumeration of the cells on the selected levels
+struct LevelEnumeration {
+  std::vector<oktal::MortonIndex> mortonIndices;
+  // Enumeration index of the first cell of every octree level and one past
+  // its last cell; NOT_ENUMERATED and 0 for levels that are not selected
+  std::vector<size_t> levelEnumStart;
+  std::vector<size_t> levelEnumEnd;
+
+  // Returns the enumeration index of the node at streamIndex, NOT_ENUMERATED
+  // for phantoms and nodes on levels that are not selected
+  [[nodiscard]] size_t indexOf(const oktal::CellOctree &octree,
+                               size_t streamIndex) const {
+    if (octree.nodesStream()[streamIndex].isPhantom()) {
+      return oktal::CellGrid::NOT_ENUMERATED;
+    }
+    const size_t lvl = octree.levelOf(streamIndex);
+    if (levelEnumStart[lvl] == oktal::CellGrid::NOT_ENUMERATED) {
+      return oktal::CellGrid::NOT_ENUMERATED;
+    }
+    return levelEnumStart[lvl] + octree.nonPhantomRank(streamIndex) -
+           octree.nonPhantomRank(octree.getLevels()[lvl].first);
+  }
+};
+
+// Lays out the level segments of the cells on the selected levels in the
+// order of levels, leaving the Morton indices to be filled in; no levels
+// select all levels of the octree
+LevelEnumeration levelSegments(const oktal::CellOctree &octree,
+                               std::span<const size_t> levels) {
+  LevelEnumeration cells;
+  cells.levelEnumStart.assign(octree.numberOfLevels(),
+                              oktal::CellGrid::NOT_ENUMERATED);
+  cells.levelEnumEnd.assign(octree.numberOfLevels(), 0);
+  size_t idx = 0;
+  auto select = [&](size_t lvl) {
+    if (lvl < octree.numberOfLevels()) {
+      cells.levelEnumStart[lvl] = idx;
+      idx += octree.numberOfNonPhantomNodes(lvl);
+      cells.levelEnumEnd[lvl] = idx;
+    }
+  };
+  if (levels.empty()) {
+    for (size_t lvl = 0; lvl < octree.numberOfLevels(); ++lvl) {
+      select(lvl);
+    }
+  } else {
+    std::ranges::for_each(levels, select);
+  }
+  cells.mortonIndices.resize(idx);
+  return cells;
+}
+
+// Enumerates the cells level by level in the order of levels, each level in
+// Z-order; no levels select all levels of the octree
+LevelEnumeration enumerateCells(const oktal::CellOctree &octree,
+                                std::span<const size_t> levels) {
+  LevelEnumeration cells = levelSegments(octree, levels);
+  enumerateLevels(octree, cells.levelEnumStart, cells.mortonIndices);
+  return cells;
+}
+
+// Mapping through a PeriodicityMapper without a compile-time policy
+struct DynamicPeriodicity {
+  const oktal::PeriodicityMapper *mapper;
+
+  [[nodiscard]] oktal::SignedGridCoordinates
+  map(oktal::SignedGridCoordinates coords, size_t lvl) const {
+    return mapper->getNeighborCoordinates(coords, lvl);
+  }
+};
+
+// Calls func with the periodicity policy matching mapper, so that the
+// neighbor searches inline the wrapping; mappers without wrappedAxes() are
+// passed as DynamicPeriodicity
+template <typename TFunc>
+void visitPeriodicity(const oktal::PeriodicityMapper &mapper, TFunc &&func) {
+  using oktal::periodicity::Torus;
+  const auto axes = mapper.wrappedAxes();
+  if (!axes) {
+    func(DynamicPeriodicity{&mapper});
+    return;
+  }
+  switch (static_cast<unsigned>((*axes)[0]) |
+          static_cast<unsigned>((*axes)[1]) << 1U |
+          static_cast<unsigned>((*axes)[2]) << 2U) {
+  case 0:
+    func(Torus<false, false, false>{});
+    break;
+  case 1:
+    func(Torus<true, false, false>{});
+    break;
+  case 2:
+    func(Torus<false, true, false>{});
+    break;
+  case 3:
+    func(Torus<true, true, false>{});
+    break;
+  case 4:
+    func(Torus<false, false, true>{});
+    break;
+  case 5:
+    func(Torus<true, false, true>{});
+    break;
+  case 6:
+    func(Torus<false, true, true>{});
+    break;
+  default:
+    func(Torus<true, true, true>{});
+    break;
+  }
+}
+
+// Finds same-level neighbors in a level-wise Morton enumeration. The cells of
+// every level form a segment sorted by Morton index, so a neighbor is found by
+// binary search within the segment of its level. On completely refined levels
+// the position follows from the Morton index.
+template <typename TPeriodicity> struct NeighborFinder {
+  const LevelEnumeration &cells;
+  TPeriodicity periodicity;
+
+  // Returns the cell at goalCoords on level lvl after applying the
+  // periodicity, NO_NEIGHBOR if there is none
+  [[nodiscard]] size_t find(size_t lvl,
+                            oktal::SignedGridCoordinates goalCoords) const {
+    if (lvl >= cells.levelEnumStart.size() ||
+        cells.levelEnumStart[lvl] == oktal::CellGrid::NOT_ENUMERATED) {
+      return oktal::CellGrid::NO_NEIGHBOR;
+    }
+    const auto coords = periodicity.map(goalCoords, lvl);
+    if (isInvalidCoordinates(coords, lvl)) {
+      return oktal::CellGrid::NO_NEIGHBOR;
+    }
+    const size_t levelEnumStart = cells.levelEnumStart[lvl];
+    const auto segment = std::span{cells.mortonIndices}.subspan(
+        levelEnumStart, cells.levelEnumEnd[lvl] - levelEnumStart);
+    const oktal::morton_bits_t levelBit = oktal::morton_bits_t{1}
+                                          << (3 * lvl);
+    const oktal::morton_bits_t goalBits =
+        oktal::MortonIndex::fromGridCoordinates(lvl, toUnsigned(coords))
+            .getBits();
+    if (segment.size() == levelBit) {
+      return levelEnumStart + (goalBits - levelBit);
+    }
+    const auto it = std::ranges::lower_bound(segment, goalBits, {},
+                                             &oktal::MortonIndex::getBits);
+    if (it == segment.end() || it->getBits() != goalBits) {
+      return oktal::CellGrid::NO_NEIGHBOR;
+    }
+    return levelEnumStart + static_cast<size_t>(it - segment.begin());
+  }
+
+  // Returns the enumeration range of the cells on the finer level that lie
+  // inside the node at goalCoords on level lvl after applying the periodicity
+  [[nodiscard]] std::pair<size_t, size_t>
+  descendants(size_t lvl, oktal::SignedGridCoordinates goalCoords,
+              size_t finer) const {
+    if (finer >= cells.levelEnumStart.size() ||
+        cells.levelEnumStart[finer] == oktal::CellGrid::NOT_ENUMERATED) {
+      return {0, 0};
+    }
+    const auto coords = periodicity.map(goalCoords, lvl);
+    if (isInvalidCoordinates(coords, lvl)) {
+      return {0, 0};
+    }
+    const size_t levelEnumStart = cells.levelEnumStart[finer];
+    const auto segment = std::span{cells.mortonIndices}.subspan(
+        levelEnumStart, cells.levelEnumEnd[finer] - levelEnumStart);
+    const size_t shift = 3 * (finer - lvl);
+    const oktal::morton_bits_t first =
+        oktal::MortonIndex::fromGridCoordinates(lvl, toUnsigned(coords))
+            .getBits()
+        << shift;
+    const oktal::morton_bits_t last =
+        first + (oktal::morton_bits_t{1} << shift);
+    const auto begin = std::ranges::lower_bound(segment, first, {},
+                                                &oktal::MortonIndex::getBits);
+    const auto end = std::ranges::lower_bound(begin, segment.end(), last, {},
+                                              &oktal::MortonIndex::getBits);
+    return {levelEnumStart + static_cast<size_t>(begin - segment.begin()),
+            levelEnumStart + static_cast<size_t>(end - segment.begin())};
+  }
+};
+
+// Same-level adjacency of a grid under construction in either layout
+struct AdjacencyBuffers {
+  size_t numOffsets;
+  bool interleaved;
+  std::vector<oktal::AdjacencyList> lists;
+  std::vector<oktal::CompactNeighborIndex> compact;
+
+  AdjacencyBuffers(size_t numCells, size_t offsets,
+                   oktal::AdjacencyLayout layout)
+      : numOffsets(offsets),
+        interleaved(layout == oktal::AdjacencyLayout::Interleaved) {
+    if (interleaved && numCells >= oktal::CellGrid::NO_COMPACT_NEIGHBOR) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::length_error(std::format(
+          "{}: {} cells exceed the 32-bit indices of interleaved adjacency.",
+          sourceInfo, numCells));
+    }
+    if (interleaved) {
+      compact.assign(numCells * numOffsets,
+                     oktal::CellGrid::NO_COMPACT_NEIGHBOR);
+    } else {
+      lists.assign(numOffsets, oktal::AdjacencyList(
+                                   numCells, oktal::CellGrid::NO_NEIGHBOR));
+    }
+  }
+
+  void set(size_t cell, size_t slot, size_t neighbor) {
+    if (!interleaved) {
+      lists[slot][cell] = neighbor;
+    } else if (neighbor != oktal::CellGrid::NO_NEIGHBOR) {
+      compact[cell * numOffsets + slot] =
+          static_cast<oktal::CompactNeighborIndex>(neighbor);
+    }
+  }
+};
+
+// Cross-level adjacency in CSR form, one row per (cell, slot)
+struct LeafAdjacencyRows {
+  std::vector<size_t> rowStart;
+  std::vector<size_t> neighbors;
+  std::vector<double> weights;
+};
+
+// Returns the axis of a face offset, i.e. an offset with a single non-zero
+// component of magnitude one, or 3 for any other offset
+size_t faceAxis(const oktal::AdjacencyOffset &offset) {
+  size_t axis = 3;
+  for (size_t i = 0; i < 3; ++i) {
+    if (offset[i] == 0) {
+      continue;
+    }
+    if (axis != 3 || (offset[i] != 1 && offset[i] != -1)) {
+      return 3;
+    }
+    axis = i;
+  }
+  return axis;
+}
+
+// Collects, for every cell in rowCells and face offset, the enumerated cells
+// sharing the face: the neighbor on the same level, else the enumerated
+// descendants of the same-level neighbor that touch the face, else the
+// coarser enumerated cell containing the same-level neighbor. Each neighbor is
+// weighted with the fraction of the face of the cell it covers.
+template <typename TPeriodicity, typename TCells>
+LeafAdjacencyRows
+buildLeafAdjacency(const oktal::CellOctree &octree,
+                   std::span<const oktal::MortonIndex> mortonIndices,
+                   std::span<const size_t> levelEnumStart,
+                   std::span<const oktal::AdjacencyOffset> offsets,
+                   TPeriodicity periodicity, const TCells &rowCells) {
+  using oktal::CellGrid;
+  const auto &nodes = octree.nodesStream();
+  const auto &levels = octree.getLevels();
+  const size_t numOffsets = offsets.size();
+  const size_t numRows = rowCells.size() * numOffsets;
+
+  auto enumerationIndex = [&](size_t streamIndex, size_t lvl) {
+    if (levelEnumStart[lvl] == CellGrid::NOT_ENUMERATED ||
+        nodes[streamIndex].isPhantom()) {
+      return CellGrid::NOT_ENUMERATED;
+    }
+    return levelEnumStart[lvl] + octree.nonPhantomRank(streamIndex) -
+           octree.nonPhantomRank(levels[lvl].first);
+  };
+
+  const size_t numThreads = oktal::parallel::numberOfThreads();
+  std::vector<LeafAdjacencyRows> chunkRows(numThreads);
+
+  oktal::parallel::forChunks(
+      rowCells.size(),
+      [&](size_t begin, size_t end, size_t chunk) {
+        auto &rows = chunkRows[chunk];
+        // Stack of (stream index, level) pairs for the descent to finer cells
+        std::vector<std::pair<size_t, size_t>> pending;
+
+        for (size_t i = begin; i < end; ++i) {
+          const auto mortonIdx = mortonIndices[rowCells[i]];
+          const size_t cellLevel = mortonIdx.level();
+          const auto coords = toSigned(mortonIdx.gridCoordinates());
+
+          for (size_t slot = 0; slot < numOffsets; ++slot) {
+            rows.rowStart.push_back(rows.neighbors.size());
+            const auto goalCoordsSigned =
+                periodicity.map(coords + offsets[slot], cellLevel);
+            if (isInvalidCoordinates(goalCoordsSigned, cellLevel)) {
+              continue;
+            }
+            const auto goalBits = oktal::MortonIndex::fromGridCoordinates(
+                                      cellLevel, toUnsigned(goalCoordsSigned))
+                                      .getBits();
+
+            // Walk down to the same-level neighbor, remembering the deepest
+            // enumerated node that does not contain the cell itself
+            size_t streamIndex = 0;
+            size_t lvl = 0;
+            size_t coarser = CellGrid::NOT_ENUMERATED;
+            while (true) {
+              const size_t shift = 3 * (cellLevel - lvl);
+              const size_t candidate = enumerationIndex(streamIndex, lvl);
+              if (candidate != CellGrid::NOT_ENUMERATED &&
+                  (mortonIdx.getBits() >> shift) != (goalBits >> shift)) {
+                coarser = candidate;
+              }
+              if (lvl == cellLevel || !nodes[streamIndex].isRefined()) {
+                break;
+              }
+              streamIndex =
+                  nodes[streamIndex].childIndex((goalBits >> (shift - 3)) & 7);
+              ++lvl;
+            }
+
+            if (lvl == cellLevel) {
+              const size_t sameLevel = enumerationIndex(streamIndex, lvl);
+              if (sameLevel != CellGrid::NOT_ENUMERATED) {
+                rows.neighbors.push_back(sameLevel);
+                rows.weights.push_back(1.0);
+                continue;
+              }
+
+              // Children touching the face lie on the side facing the cell
+              const size_t axis = faceAxis(offsets[slot]);
+              const size_t faceBit = offsets[slot][axis] > 0 ? 0 : 1;
+              const size_t rowBegin = rows.neighbors.size();
+              pending.assign({{streamIndex, lvl}});
+              while (!pending.empty()) {
+                const auto [parentIndex, parentLevel] = pending.back();
+                pending.pop_back();
+                if (!nodes[parentIndex].isRefined()) {
+                  continue;
+                }
+                for (size_t branch = 0; branch < 8; ++branch) {
+                  if (((branch >> axis) & 1) != faceBit) {
+                    continue;
+                  }
+                  const size_t childIndex =
+                      nodes[parentIndex].childIndex(branch);
+                  const size_t finer =
+                      enumerationIndex(childIndex, parentLevel + 1);
+                  if (finer == CellGrid::NOT_ENUMERATED) {
+                    pending.emplace_back(childIndex, parentLevel + 1);
+                    continue;
+                  }
+                  rows.neighbors.push_back(finer);
+                  rows.weights.push_back(
+                      std::ldexp(1.0, -2 * static_cast<int>(parentLevel + 1 -
+                                                            cellLevel)));
+                }
+              }
+              if (rows.neighbors.size() != rowBegin) {
+                continue;
+              }
+            }
+
+            if (coarser != CellGrid::NOT_ENUMERATED) {
+              rows.neighbors.push_back(coarser);
+              rows.weights.push_back(1.0);
+            }
+          }
+        }
+      },
+      numThreads);
+
+  // Concatenate the rows of all chunks
+  LeafAdjacencyRows result;
+  result.rowStart.reserve(numRows + 1);
+  for (auto &rows : chunkRows) {
+    const size_t base = result.neighbors.size();
+    for (const size_t start : rows.rowStart) {
+      result.rowStart.push_back(base + start);
+    }
+    result.neighbors.insert(result.neighbors.end(), rows.neighbors.begin(),
+                            rows.neighbors.end());
+    result.weights.insert(result.weights.end(), rows.weights.begin(),
+                          rows.weights.end());
+  }
+  result.rowStart.push_back(result.neighbors.size());
+  return result;
+}
+
+// Symmetric adjacency graph of the cells in CSR form, without self loops
+struct CellGraph {
+  std::vector<size_t> rowStart;
+  std::vector<size_t> neighbors;
+
+  [[nodiscard]] size_t degree(size_t cell) const {
+    return rowStart[cell + 1] - rowStart[cell];
+  }
+};
+
+CellGraph symmetricGraph(const oktal::CellGrid &grid) {
+  const size_t numCells = grid.size();
+  const size_t numSlots = grid.adjacencyOffsets().size();
+  std::vector<std::pair<size_t, size_t>> edges;
+  // Missing neighbors and ghost cells are not part of the graph
+  auto addEdge = [&edges, numCells](size_t a, size_t b) {
+    if (a != b && b < numCells) {
+      edges.emplace_back(a, b);
+      edges.emplace_back(b, a);
+    }
+  };
+  for (size_t cell = 0; cell < numCells; ++cell) {
+    for (size_t slot = 0; slot < numSlots; ++slot) {
+      addEdge(cell, grid.neighborIndex(slot, cell));
+      if (grid.hasLeafAdjacency()) {
+        for (const size_t neighbor : grid.leafNeighbors(slot, cell).cells) {
+          addEdge(cell, neighbor);
+        }
+      }
+    }
+  }
+  std::ranges::sort(edges);
+  const auto duplicates = std::ranges::unique(edges);
+  edges.erase(duplicates.begin(), duplicates.end());
+
+  CellGraph graph;
+  graph.rowStart.assign(numCells + 1, 0);
+  graph.neighbors.reserve(edges.size());
+  for (const auto &[from, to] : edges) {
+    ++graph.rowStart[from + 1];
+    graph.neighbors.push_back(to);
+  }
+  std::partial_sum(graph.rowStart.begin(), graph.rowStart.end(),
+                   graph.rowStart.begin());
+  return graph;
+}
+
+// Level structure of a breadth-first search
+struct SweepLevels {
+  size_t depth;
+  // Position of the first cell of the deepest level in the visiting order
+  size_t lastLevelBegin;
+};
+
+// Marks of cells that are part of the final ordering
+constexpr size_t ORDERED = std::numeric_limits<size_t>::max();
+
+// Breadth-first search from start over the cells that are neither ordered nor
+// carry mark, visiting the neighbors of every cell by increasing degree;
+// marks the visited cells and appends them to order
+SweepLevels cuthillMcKeeSweep(const CellGraph &graph, size_t start,
+                              std::vector<size_t> &marks, size_t mark,
+                              std::vector<size_t> &order) {
+  const size_t first = order.size();
+  order.push_back(start);
+  marks[start] = mark;
+  size_t depth = 0;
+  size_t levelBegin = first;
+  size_t levelEnd = order.size();
+  std::vector<size_t> candidates;
+  for (size_t head = first; head < order.size(); ++head) {
+    if (head == levelEnd) {
+      ++depth;
+      levelBegin = levelEnd;
+      levelEnd = order.size();
+    }
+    const size_t cell = order[head];
+    candidates.clear();
+    for (size_t i = graph.rowStart[cell]; i < graph.rowStart[cell + 1]; ++i) {
+      const size_t neighbor = graph.neighbors[i];
+      if (marks[neighbor] != mark && marks[neighbor] != ORDERED) {
+        marks[neighbor] = mark;
+        candidates.push_back(neighbor);
+      }
+    }
+    std::ranges::sort(candidates, [&graph](size_t a, size_t b) {
+      return std::pair{graph.degree(a), a} < std::pair{graph.degree(b), b};
+    });
+    order.insert(order.end(), candidates.begin(), candidates.end());
+  }
+  return {depth, levelBegin};
+}
+
+// Reverse Cuthill-McKee ordering; every connected component starts at a
+// pseudo-peripheral cell found by repeated breadth-first searches
+std::vector<size_t> reverseCuthillMcKee(const CellGraph &graph) {
+  const size_t numCells = graph.rowStart.size() - 1;
+  std::vector<size_t> marks(numCells, 0);
+  size_t probeMark = 0;
+  std::vector<size_t> probe;
+  std::vector<size_t> order;
+  order.reserve(numCells);
+
+  for (size_t seed = 0; seed < numCells; ++seed) {
+    if (marks[seed] == ORDERED) {
+      continue;
+    }
+    // Move the start to a cell of minimal degree in the deepest level as
+    // long as this deepens the level structure
+    size_t start = seed;
+    probe.clear();
+    SweepLevels levels =
+        cuthillMcKeeSweep(graph, start, marks, ++probeMark, probe);
+    while (true) {
+      const size_t candidate = *std::ranges::min_element(
+          std::span{probe}.subspan(levels.lastLevelBegin), {},
+          [&graph](size_t cell) { return graph.degree(cell); });
+      probe.clear();
+      const SweepLevels candidateLevels =
+          cuthillMcKeeSweep(graph, candidate, marks, ++probeMark, probe);
+      if (candidateLevels.depth <= levels.depth) {
+        break;
+      }
+      start = candidate;
+      levels = candidateLevels;
+    }
+    cuthillMcKeeSweep(graph, start, marks, ORDERED, order);
+  }
+
+  std::vector<size_t> newIndex(numCells);
+  for (size_t i = 0; i < numCells; ++i) {
+    newIndex[order[numCells - 1 - i]] = i;
+  }
+  return newIndex;
+}
+
+// Returns true if no two adjacent cells share a color
+bool isProperColoring(const CellGraph &graph, std::span<const size_t> colors) {
+  for (size_t cell = 0; cell + 1 < graph.rowStart.size(); ++cell) {
+    for (size_t i = graph.rowStart[cell]; i < graph.rowStart[cell + 1]; ++i) {
+      if (colors[graph.neighbors[i]] == colors[cell]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Colors every cell by the parities of its grid coordinates, either with
+// two colors by the parity of their sum or with one color per combination
+std::vector<size_t> parityColors(const oktal::CellGrid &grid, bool redBlack) {
+  std::vector<size_t> colors(grid.size());
+  const auto mortonIndices = grid.mortonIndices();
+  oktal::parallel::forEach(grid.size(), [&](size_t cell) {
+    const auto coords = mortonIndices[cell].gridCoordinates();
+    colors[cell] = redBlack
+                       ? (coords[0] + coords[1] + coords[2]) & 1
+                       : (coords[0] & 1) | (coords[1] & 1) << 1 |
+                             (coords[2] & 1) << 2;
+  });
+  return colors;
+}
+
+// Assigns every cell, in enumeration order, the smallest color none of its
+// already colored neighbors has
+std::vector<size_t> greedyColors(const CellGraph &graph) {
+  const size_t numCells = graph.rowStart.size() - 1;
+  constexpr size_t UNCOLORED = std::numeric_limits<size_t>::max();
+  std::vector<size_t> colors(numCells, UNCOLORED);
+  // Cell that last marked a color as taken
+  std::vector<size_t> takenBy;
+  for (size_t cell = 0; cell < numCells; ++cell) {
+    for (size_t i = graph.rowStart[cell]; i < graph.rowStart[cell + 1]; ++i) {
+      const size_t color = colors[graph.neighbors[i]];
+      if (color != UNCOLORED) {
+        takenBy[color] = cell;
+      }
+    }
+    size_t color = 0;
+    while (color < takenBy.size() && takenBy[color] == cell) {
+      ++color;
+    }
+    if (color == takenBy.size()) {
+      takenBy.push_back(UNCOLORED);
+    }
+    colors[cell] = color;
+  }
+  return colors;
 }
 
+// Sorts the cells into their colors, dropping colors without cells
+oktal::CellColoring colorClasses(std::span<const size_t> colors) {
+  const size_t numColors =
+      colors.empty() ? 0 : *std::ranges::max_element(colors) + 1;
+  std::vector<size_t> classSize(numColors, 0);
+  for (const size_t color : colors) {
+    ++classSize[color];
+  }
+  // Position of each non-empty color in the result
+  std::vector<size_t> classIndex(numColors);
+  oktal::CellColoring coloring;
+  coloring.colorStart.push_back(0);
+  for (size_t color = 0; color < numColors; ++color) {
+    classIndex[color] = coloring.colorStart.size() - 1;
+    if (classSize[color] != 0) {
+      coloring.colorStart.push_back(coloring.colorStart.back() +
+                                    classSize[color]);
+    }
+  }
+  coloring.cells.resize(colors.size());
+  std::vector<size_t> next(coloring.colorStart.begin(),
+                           coloring.colorStart.end() - 1);
+  for (size_t cell = 0; cell < colors.size(); ++cell) {
+    coloring.cells[next[classIndex[colors[cell]]]++] = cell;
+  }
+  return coloring;
+}
+// Cell of grid on level lvl at coords wrapped into the domain. Where the grid
+// extent wraps into phantom padding, walks back against the offset to the
+// opposite boundary of the domain instead.
+size_t periodicPartner(const oktal::CellGrid &grid, size_t lvl,
+                       const oktal::SignedGridCoordinates &coords,
+                       const oktal::AdjacencyOffset &offset) {
+  const auto &octree = grid.octree();
+  const std::ptrdiff_t extent = std::ptrdiff_t{1} << lvl;
+  oktal::SignedGridCoordinates wrapped;
+  for (size_t axis = 0; axis < 3; ++axis) {
+    wrapped[axis] = (coords[axis] % extent + extent) % extent;
+  }
+  if (isOutsideDomain(octree, wrapped, lvl)) {
+    wrapped = coords - offset;
+    while (!isOutsideDomain(octree, wrapped - offset, lvl)) {
+      wrapped -= offset;
+    }
+  }
+  const auto cell = octree.getCell(
+      oktal::MortonIndex::fromGridCoordinates(lvl, toUnsigned(wrapped)));
+  return cell ? grid.getEnumerationIndex(*cell) : oktal::CellGrid::NO_NEIGHBOR;
+}
+
+// Appends a ghost for every slot of cell without a neighbor whose position,
+// after applying the periodicity, lies outside the domain
+void appendGhosts(const oktal::CellGrid &grid,
+                  const oktal::PeriodicityMapper &periodicity, size_t cell,
+                  std::vector<oktal::GhostCell> &ghosts) {
+  const auto &geometry = grid.octree().geometry();
+  const auto mortonIdx = grid.mortonIndices()[cell];
+  const size_t lvl = mortonIdx.level();
+  const auto coords = toSigned(mortonIdx.gridCoordinates());
+  const auto offsets = grid.adjacencyOffsets();
+  for (size_t slot = 0; slot < offsets.size(); ++slot) {
+    const auto &offset = offsets[slot];
+    const auto goalCoords = coords + offset;
+    if (grid.neighborIndex(slot, cell) != oktal::CellGrid::NO_NEIGHBOR ||
+        !isOutsideDomain(grid.octree(),
+                         periodicity.getNeighborCoordinates(goalCoords, lvl),
+                         lvl)) {
+      continue;
+    }
+    const auto squaredLength =
+        static_cast<double>(offset[0] * offset[0] + offset[1] * offset[1] +
+                            offset[2] * offset[2]);
+    ghosts.push_back({cell, slot, geometry.dx(lvl) * std::sqrt(squaredLength),
+                      periodicPartner(grid, lvl, goalCoords, offset)});
+  }
+}
 } // namespace
 
 namespace oktal {
@@ -54,6 +764,884 @@ CellGrid::create(std::shared_ptr<const CellOctree> octree) {
   return {std::move(octree)};
 }
 
+oktal::CellGridBuilder CellGrid::create(const PersistentOctree &snapshot) {
+  return {snapshot.octree()};
+}
+
+GhostLayer CellGrid::ghostLayer(EnumerationRange owned,
+                                std::span<const EnumerationRange> parts) const {
+  size_t expectedBegin = 0;
+  for (const auto &part : parts) {
+    if (part.begin != expectedBegin || part.end < part.begin) {
+      break;
+    }
+    expectedBegin = part.end;
+  }
+  const auto ownedIt = std::ranges::find(parts, owned);
+  if (expectedBegin != size() || ownedIt == parts.end()) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(std::format(
+        "{}: Parts must tile the grid and contain the owned range.",
+        sourceInfo));
+  }
+
+  const auto partOf = [&parts](size_t cell) {
+    return static_cast<size_t>(
+        std::ranges::upper_bound(parts, cell, {}, &EnumerationRange::begin) -
+        parts.begin() - 1);
+  };
+
+  // A cell reading an owned cell through an offset is reached from the owned
+  // cell through the opposite offset, unless the periodic wrapping of a
+  // custom mapper cannot be inverted
+  const size_t numSlots = adjacencyOffsets_.size();
+  std::vector<size_t> opposite(numSlots);
+  bool symmetric = !periodicity_ || periodicity_->wrappedAxes().has_value();
+  for (size_t slot = 0; slot < numSlots && symmetric; ++slot) {
+    const AdjacencyOffset &offset = adjacencyOffsets_[slot];
+    const auto it = std::ranges::find(
+        adjacencyOffsets_, AdjacencyOffset{-offset[0], -offset[1], -offset[2]});
+    symmetric = it != adjacencyOffsets_.end();
+    opposite[slot] = static_cast<size_t>(it - adjacencyOffsets_.begin());
+  }
+
+  // Every chunk collects (part, cell) pairs: halo cells read by the owned
+  // part, and owned cells read by the other parts
+  const size_t numThreads = parallel::numberOfThreads();
+  std::vector<std::vector<std::pair<size_t, size_t>>> chunkReceives(
+      numThreads);
+  std::vector<std::vector<std::pair<size_t, size_t>>> chunkSends(numThreads);
+
+  if (symmetric) {
+    // Only the owned cells are visited
+    parallel::forChunks(
+        owned.size(),
+        [&](size_t begin, size_t end, size_t chunk) {
+          for (size_t cell = owned.begin + begin; cell < owned.begin + end;
+               ++cell) {
+            for (size_t slot = 0; slot < numSlots; ++slot) {
+              const size_t neighbor = neighborIndex(slot, cell);
+              if (neighbor < size() && !owned.contains(neighbor)) {
+                chunkReceives[chunk].emplace_back(partOf(neighbor), neighbor);
+              }
+              const size_t reader = neighborIndex(opposite[slot], cell);
+              if (reader < size() && !owned.contains(reader) &&
+                  neighborIndex(slot, reader) == cell) {
+                chunkSends[chunk].emplace_back(partOf(reader), cell);
+              }
+            }
+          }
+        },
+        numThreads);
+  } else {
+    // Readers of the owned cells are only known from their own adjacency
+    parallel::forChunks(
+        size(),
+        [&](size_t begin, size_t end, size_t chunk) {
+          for (size_t cell = begin; cell < end; ++cell) {
+            const bool cellOwned = owned.contains(cell);
+            for (size_t slot = 0; slot < numSlots; ++slot) {
+              const size_t neighbor = neighborIndex(slot, cell);
+              if (neighbor >= size() || cellOwned == owned.contains(neighbor)) {
+                continue;
+              }
+              if (cellOwned) {
+                chunkReceives[chunk].emplace_back(partOf(neighbor), neighbor);
+              } else {
+                chunkSends[chunk].emplace_back(partOf(cell), neighbor);
+              }
+            }
+          }
+        },
+        numThreads);
+  }
+
+  auto mergeChunks =
+      [](std::vector<std::vector<std::pair<size_t, size_t>>> &chunks) {
+        std::vector<std::pair<size_t, size_t>> merged;
+        for (const auto &chunk : chunks) {
+          merged.insert(merged.end(), chunk.begin(), chunk.end());
+        }
+        std::ranges::sort(merged);
+        const auto duplicates = std::ranges::unique(merged);
+        merged.erase(duplicates.begin(), duplicates.end());
+        return merged;
+      };
+  const auto receives = mergeChunks(chunkReceives);
+  const auto sends = mergeChunks(chunkSends);
+
+  GhostLayer layer{owned, {}, {}};
+  // Parts are ascending, so sorting by part keeps the halo sorted
+  layer.halo.reserve(receives.size());
+  for (const auto &[part, cell] : receives) {
+    layer.halo.push_back(cell);
+  }
+
+  auto exchangeWith = [&layer](size_t part) -> GhostExchange & {
+    if (layer.exchanges.empty() || layer.exchanges.back().part != part) {
+      const auto it = std::ranges::lower_bound(layer.exchanges, part, {},
+                                               &GhostExchange::part);
+      if (it == layer.exchanges.end() || it->part != part) {
+        return *layer.exchanges.insert(it, {part, {}, {}});
+      }
+      return *it;
+    }
+    return layer.exchanges.back();
+  };
+  for (const auto &[part, cell] : receives) {
+    exchangeWith(part).receive.push_back(cell);
+  }
+  for (const auto &[part, cell] : sends) {
+    exchangeWith(part).send.push_back(cell);
+  }
+
+  return layer;
+}
+
+AdjacencyStatistics CellGrid::adjacencyStatistics() const {
+  AdjacencyStatistics statistics{0, 0};
+  for (size_t cell = 0; cell < size(); ++cell) {
+    size_t firstInRow = cell;
+    auto visit = [&](size_t neighbor) {
+      if (neighbor >= size()) {
+        return;
+      }
+      statistics.bandwidth = std::max(statistics.bandwidth,
+                                      neighbor > cell ? neighbor - cell
+                                                      : cell - neighbor);
+      firstInRow = std::min(firstInRow, neighbor);
+    };
+    for (size_t slot = 0; slot < adjacencyOffsets_.size(); ++slot) {
+      visit(neighborIndex(slot, cell));
+      if (hasLeafAdjacency()) {
+        std::ranges::for_each(leafNeighbors(slot, cell).cells, visit);
+      }
+    }
+    statistics.profile += cell - firstInRow;
+  }
+  return statistics;
+}
+
+void CellGrid::addGhostCells() {
+  const size_t numThreads = parallel::numberOfThreads();
+  std::vector<std::vector<GhostCell>> chunkGhosts(numThreads);
+  parallel::forChunks(
+      size(),
+      [&](size_t begin, size_t end, size_t chunk) {
+        for (size_t cell = begin; cell < end; ++cell) {
+          appendGhosts(*this, *periodicity_, cell, chunkGhosts[chunk]);
+        }
+      },
+      numThreads);
+
+  ghosts_.clear();
+  for (const auto &ghosts : chunkGhosts) {
+    ghosts_.insert(ghosts_.end(), ghosts.begin(), ghosts.end());
+  }
+  linkGhostCells();
+}
+
+void CellGrid::linkGhostCells() {
+  const size_t numCells = size();
+  const size_t numSlots = adjacencyOffsets_.size();
+  if (adjacencyLayout_ == AdjacencyLayout::Interleaved &&
+      numCells + ghosts_.size() >= NO_COMPACT_NEIGHBOR) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::length_error(std::format(
+        "{}: {} cells and ghosts exceed the 32-bit indices of interleaved "
+        "adjacency.",
+        sourceInfo, numCells + ghosts_.size()));
+  }
+
+  for (size_t i = 0; i < ghosts_.size(); ++i) {
+    const GhostCell &ghost = ghosts_[i];
+    if (adjacencyLayout_ == AdjacencyLayout::PerOffset) {
+      adjacencyLists_[ghost.slot][ghost.cell] = numCells + i;
+    } else {
+      interleavedAdjacency_[ghost.cell * numSlots + ghost.slot] =
+          static_cast<CompactNeighborIndex>(numCells + i);
+    }
+  }
+  fields_ = FieldRegistry(numCells + ghosts_.size());
+  ghostCells_ = true;
+}
+
+void CellGrid::classifyCells() {
+  const size_t numSlots = adjacencyOffsets_.size();
+  const size_t numWords = (numSlots + 63) / 64;
+
+  // Every chunk collects its interior runs and its boundary cells, each with
+  // a bit mask of the slots it lacks
+  struct ChunkCells {
+    std::vector<EnumerationRange> interior;
+    std::vector<size_t> boundary;
+    std::vector<std::uint64_t> masks;
+  };
+  const size_t numThreads = parallel::numberOfThreads();
+  std::vector<ChunkCells> chunks(numThreads);
+  parallel::forChunks(
+      size(),
+      [&](size_t begin, size_t end, size_t chunk) {
+        auto &cells = chunks[chunk];
+        std::vector<std::uint64_t> mask(numWords);
+        for (size_t cell = begin; cell < end; ++cell) {
+          std::ranges::fill(mask, 0);
+          bool complete = true;
+          for (size_t slot = 0; slot < numSlots; ++slot) {
+            if (neighborIndex(slot, cell) == NO_NEIGHBOR) {
+              mask[slot / 64] |= std::uint64_t{1} << (slot % 64);
+              complete = false;
+            }
+          }
+          if (!complete) {
+            cells.boundary.push_back(cell);
+            cells.masks.insert(cells.masks.end(), mask.begin(), mask.end());
+          } else if (!cells.interior.empty() &&
+                     cells.interior.back().end == cell) {
+            ++cells.interior.back().end;
+          } else {
+            cells.interior.push_back({cell, cell + 1});
+          }
+        }
+      },
+      numThreads);
+
+  interiorRanges_.clear();
+  std::vector<size_t> boundary;
+  std::vector<std::uint64_t> masks;
+  for (const auto &cells : chunks) {
+    for (const auto &range : cells.interior) {
+      if (!interiorRanges_.empty() &&
+          interiorRanges_.back().end == range.begin) {
+        interiorRanges_.back().end = range.end;
+      } else {
+        interiorRanges_.push_back(range);
+      }
+    }
+    boundary.insert(boundary.end(), cells.boundary.begin(),
+                    cells.boundary.end());
+    masks.insert(masks.end(), cells.masks.begin(), cells.masks.end());
+  }
+
+  // The cells are ascending, so a stable sort by mask keeps every group sorted
+  auto maskOf = [&masks, numWords](size_t i) {
+    return std::span{masks}.subspan(i * numWords, numWords);
+  };
+  std::vector<size_t> order(boundary.size());
+  std::ranges::iota(order, size_t{0});
+  std::ranges::stable_sort(order, [&](size_t a, size_t b) {
+    return std::ranges::lexicographical_compare(maskOf(a), maskOf(b));
+  });
+
+  boundaryGroups_.clear();
+  for (size_t k = 0; k < order.size(); ++k) {
+    const auto mask = maskOf(order[k]);
+    if (k == 0 || !std::ranges::equal(mask, maskOf(order[k - 1]))) {
+      BoundaryGroup group;
+      for (size_t slot = 0; slot < numSlots; ++slot) {
+        if (((mask[slot / 64] >> (slot % 64)) & 1) != 0) {
+          group.missingSlots.push_back(slot);
+        }
+      }
+      boundaryGroups_.push_back(std::move(group));
+    }
+    boundaryGroups_.back().cells.push_back(boundary[order[k]]);
+  }
+}
+
+void CellGrid::reclassifyCells(const CellGrid &before,
+                               std::span<const size_t> oldToNew,
+                               std::span<const char> dirty,
+                               std::span<const size_t> dirtyCells) {
+  const size_t numSlots = adjacencyOffsets_.size();
+  const size_t numWords = (numSlots + 63) / 64;
+
+  // Groups keyed by their slot mask, which orders them like classifyCells();
+  // merged counts the ascending cells taken over from before
+  struct Group {
+    std::vector<size_t> cells;
+    size_t merged = 0;
+  };
+  std::map<std::vector<std::uint64_t>, Group> groups;
+  for (const auto &group : before.boundaryGroups_) {
+    std::vector<std::uint64_t> mask(numWords, 0);
+    for (const size_t slot : group.missingSlots) {
+      mask[slot / 64] |= std::uint64_t{1} << (slot % 64);
+    }
+    auto &cells = groups[std::move(mask)].cells;
+    for (const size_t cell : group.cells) {
+      const size_t moved = oldToNew[cell];
+      if (moved != NOT_ENUMERATED && dirty[moved] == 0) {
+        cells.push_back(moved);
+      }
+    }
+  }
+  for (auto &[mask, group] : groups) {
+    group.merged = group.cells.size();
+  }
+  for (const size_t cell : dirtyCells) {
+    std::vector<std::uint64_t> mask(numWords, 0);
+    bool complete = true;
+    for (size_t slot = 0; slot < numSlots; ++slot) {
+      if (neighborIndex(slot, cell) == NO_NEIGHBOR) {
+        mask[slot / 64] |= std::uint64_t{1} << (slot % 64);
+        complete = false;
+      }
+    }
+    if (!complete) {
+      groups[std::move(mask)].cells.push_back(cell);
+    }
+  }
+
+  boundaryGroups_.clear();
+  std::vector<size_t> boundary;
+  for (auto &[mask, group] : groups) {
+    if (group.cells.empty()) {
+      continue;
+    }
+    std::inplace_merge(group.cells.begin(),
+                       group.cells.begin() +
+                           static_cast<std::ptrdiff_t>(group.merged),
+                       group.cells.end());
+    BoundaryGroup boundaryGroup;
+    for (size_t slot = 0; slot < numSlots; ++slot) {
+      if (((mask[slot / 64] >> (slot % 64)) & 1) != 0) {
+        boundaryGroup.missingSlots.push_back(slot);
+      }
+    }
+    boundary.insert(boundary.end(), group.cells.begin(), group.cells.end());
+    boundaryGroup.cells = std::move(group.cells);
+    boundaryGroups_.push_back(std::move(boundaryGroup));
+  }
+
+  // The interior ranges fill the gaps between the boundary cells
+  std::ranges::sort(boundary);
+  interiorRanges_.clear();
+  size_t begin = 0;
+  for (const size_t cell : boundary) {
+    if (cell > begin) {
+      interiorRanges_.push_back({begin, cell});
+    }
+    begin = cell + 1;
+  }
+  if (begin < size()) {
+    interiorRanges_.push_back({begin, size()});
+  }
+}
+
+CellColoring CellGrid::coloring() const {
+  if (!colorStart_.empty()) {
+    CellColoring coloring{colorStart_, std::vector<size_t>(size())};
+    std::ranges::iota(coloring.cells, size_t{0});
+    return coloring;
+  }
+
+  const CellGraph graph = symmetricGraph(*this);
+  if (!hasLeafAdjacency()) {
+    auto isOdd = [](std::ptrdiff_t c) { return (c & 1) != 0; };
+    // Periodic wrapping at an odd extent breaks the parities, hence the check
+    // of the coloring
+    for (const bool redBlack : {true, false}) {
+      const bool separatesNeighbors = std::ranges::all_of(
+          adjacencyOffsets_, [&](const AdjacencyOffset &offset) {
+            return redBlack ? isOdd(offset[0] + offset[1] + offset[2])
+                            : std::ranges::any_of(offset, isOdd);
+          });
+      if (!separatesNeighbors) {
+        continue;
+      }
+      const auto colors = parityColors(*this, redBlack);
+      if (isProperColoring(graph, colors)) {
+        return colorClasses(colors);
+      }
+    }
+  }
+  return colorClasses(greedyColors(graph));
+}
+
+std::optional<UniformLevelView> CellGrid::uniformLevel() const {
+  if (mortonIndices_.empty()) {
+    return std::nullopt;
+  }
+  const size_t level = mortonIndices_.front().level();
+  // A level holds 8^level cells, so matching counts on a single level mean
+  // that all of them are present
+  if (size() != size_t{1} << (3 * level) ||
+      !std::ranges::all_of(mortonIndices_, [&](const MortonIndex &idx) {
+        return idx.level() == level;
+      })) {
+    return std::nullopt;
+  }
+
+  const size_t extent = size_t{1} << level;
+  std::vector<size_t> cells(size());
+  std::vector<size_t> denseIndices(size());
+  parallel::forEach(size(), [&](size_t enumIdx) {
+    const auto coords = mortonIndices_[enumIdx].gridCoordinates();
+    const size_t denseIdx =
+        coords[0] + (extent * (coords[1] + (extent * coords[2])));
+    cells[denseIdx] = enumIdx;
+    denseIndices[enumIdx] = denseIdx;
+  });
+  return UniformLevelView(level, std::move(cells), std::move(denseIndices));
+}
+
+void CellGrid::renumber(std::span<const size_t> newIndex) {
+  const size_t numCells = size();
+  const size_t numSlots = adjacencyOffsets_.size();
+  auto mapIndex = [newIndex](size_t cell) {
+    return cell == NO_NEIGHBOR ? NO_NEIGHBOR : newIndex[cell];
+  };
+
+  std::vector<MortonIndex> mortonIndices(numCells);
+  parallel::forEach(numCells, [&](size_t cell) {
+    mortonIndices[newIndex[cell]] = mortonIndices_[cell];
+  });
+  mortonIndices_ = std::move(mortonIndices);
+
+  for (auto &list : adjacencyLists_) {
+    AdjacencyList renumbered(numCells);
+    parallel::forEach(numCells, [&](size_t cell) {
+      renumbered[newIndex[cell]] = mapIndex(list[cell]);
+    });
+    list = std::move(renumbered);
+  }
+
+  if (!interleavedAdjacency_.empty()) {
+    std::vector<CompactNeighborIndex> renumbered(interleavedAdjacency_.size());
+    parallel::forEach(numCells, [&](size_t cell) {
+      for (size_t slot = 0; slot < numSlots; ++slot) {
+        const CompactNeighborIndex neighbor =
+            interleavedAdjacency_[cell * numSlots + slot];
+        renumbered[newIndex[cell] * numSlots + slot] =
+            neighbor == NO_COMPACT_NEIGHBOR
+                ? NO_COMPACT_NEIGHBOR
+                : static_cast<CompactNeighborIndex>(newIndex[neighbor]);
+      }
+    });
+    interleavedAdjacency_ = std::move(renumbered);
+  }
+
+  if (hasLeafAdjacency()) {
+    // Rows move with their cell, so the row lengths are permuted first
+    const size_t numRows = numCells * numSlots;
+    auto newRowOf = [&](size_t row) {
+      return newIndex[row / numSlots] * numSlots + row % numSlots;
+    };
+    std::vector<size_t> rowStart(numRows + 1, 0);
+    for (size_t row = 0; row < numRows; ++row) {
+      rowStart[newRowOf(row) + 1] = leafRowStart_[row + 1] - leafRowStart_[row];
+    }
+    std::partial_sum(rowStart.begin(), rowStart.end(), rowStart.begin());
+
+    std::vector<size_t> neighbors(leafNeighbors_.size());
+    std::vector<double> weights(leafWeights_.size());
+    parallel::forEach(numRows, [&](size_t row) {
+      for (size_t i = leafRowStart_[row], j = rowStart[newRowOf(row)];
+           i < leafRowStart_[row + 1]; ++i, ++j) {
+        neighbors[j] = newIndex[leafNeighbors_[i]];
+        weights[j] = leafWeights_[i];
+      }
+    });
+    leafRowStart_ = std::move(rowStart);
+    leafNeighbors_ = std::move(neighbors);
+    leafWeights_ = std::move(weights);
+  }
+
+  // Compose with an earlier renumbering
+  if (mortonToEnum_.empty()) {
+    mortonToEnum_.assign(newIndex.begin(), newIndex.end());
+  } else {
+    for (auto &cell : mortonToEnum_) {
+      cell = newIndex[cell];
+    }
+  }
+
+  if (geometryCached_) {
+    cacheGeometry();
+  }
+}
+
+std::vector<size_t> CellGrid::applyOrdering(Ordering ordering) {
+  std::vector<size_t> newIndex;
+  if (ordering == Ordering::RCM) {
+    newIndex = reverseCuthillMcKee(symmetricGraph(*this));
+    renumber(newIndex);
+  }
+  if (ordering == Ordering::Multicolor) {
+    const CellColoring coloring = this->coloring();
+    newIndex.resize(size());
+    for (size_t i = 0; i < coloring.cells.size(); ++i) {
+      newIndex[coloring.cells[i]] = i;
+    }
+    renumber(newIndex);
+    colorStart_ = coloring.colorStart;
+  }
+  ordering_ = ordering;
+  return newIndex;
+}
+
+void CellGrid::cacheGeometry() {
+  const size_t numCells = size();
+  for (size_t axis = 0; axis < 3; ++axis) {
+    centers_[axis].resize(numCells);
+    coordinates_[axis].resize(numCells);
+  }
+  cellLevels_.resize(numCells);
+
+  const auto &geometry = octree_->geometry();
+  const Vec3D origin = geometry.origin();
+  parallel::forEach(numCells, [&](size_t cell) {
+    const auto mortonIdx = mortonIndices_[cell];
+    const size_t lvl = mortonIdx.level();
+    const auto coords = mortonIdx.gridCoordinates();
+    const double length = geometry.dx(lvl);
+    cellLevels_[cell] = static_cast<std::uint8_t>(lvl);
+    for (size_t axis = 0; axis < 3; ++axis) {
+      coordinates_[axis][cell] = static_cast<std::uint32_t>(coords[axis]);
+      // Same rounding as OctreeGeometry::cellCenter()
+      const double lower =
+          origin[axis] + length * static_cast<double>(coords[axis]);
+      centers_[axis][cell] = (lower + length + lower) / 2;
+    }
+  });
+  geometryCached_ = true;
+}
+
+CellGridBuilder
+CellGrid::sameConfiguration(std::shared_ptr<const CellOctree> octree) const {
+  CellGridBuilder builder(std::move(octree));
+  builder.levels_ = selectedLevels_;
+  builder.adjacencyOffsets_ = adjacencyOffsets_;
+  builder.adjacencyLayout_ = adjacencyLayout_;
+  builder.leafAdjacency_ = hasLeafAdjacency();
+  builder.ordering_ = ordering_;
+  builder.geometryCache_ = geometryCached_;
+  builder.ghostCells_ = ghostCells_;
+  builder.periodicityHandler_ = periodicity_;
+  return builder;
+}
+
+CellGrid CellGrid::rebuild(std::shared_ptr<const CellOctree> newOctree,
+                           std::span<const size_t> streamIndexRemap) const {
+  if (streamIndexRemap.size() != octree_->numberOfNodes()) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(std::format(
+        "{}: Remap covers {} of {} nodes.", sourceInfo,
+        streamIndexRemap.size(), octree_->numberOfNodes()));
+  }
+  const CellOctree &after = *newOctree;
+  LevelEnumeration cells = levelSegments(after, selectedLevels_);
+  const size_t numCells = cells.mortonIndices.size();
+  const size_t numOffsets = adjacencyOffsets_.size();
+  const size_t numThreads = parallel::numberOfThreads();
+
+  // A cell keeps its level, and on both sides its enumeration index follows
+  // from its rank among the non-phantom nodes of the level
+  auto levelCells = [](const CellOctree &octree,
+                       std::span<const size_t> levelEnumStart, size_t lvl,
+                       auto &&visit) {
+    if (lvl >= octree.numberOfLevels() ||
+        levelEnumStart[lvl] == NOT_ENUMERATED) {
+      return;
+    }
+    const size_t levelStart = octree.getLevels()[lvl].first;
+    const size_t rankStart = octree.nonPhantomRank(levelStart);
+    auto visitChunk = [&](size_t begin, size_t end, size_t chunk) {
+      for (size_t node = levelStart + begin; node < levelStart + end;
+           ++node) {
+        if (!octree.nodesStream()[node].isPhantom()) {
+          const size_t rank = octree.nonPhantomRank(node) - rankStart;
+          visit(node, levelEnumStart[lvl] + rank, chunk);
+        }
+      }
+    };
+    parallel::forChunks(octree.numberOfNodes(lvl), visitChunk);
+  };
+
+  // Match the cells that persist through the remap
+  std::vector<size_t> oldToNew(size(), NOT_ENUMERATED);
+  std::vector<size_t> newToOld(numCells, NOT_ENUMERATED);
+  std::vector<std::vector<MortonIndex>> chunkRemoved(numThreads);
+  for (size_t lvl = 0; lvl < octree_->numberOfLevels(); ++lvl) {
+    const bool selected = lvl < after.numberOfLevels() &&
+                          cells.levelEnumStart[lvl] != NOT_ENUMERATED;
+    const size_t newStart = selected ? after.getLevels()[lvl].first : 0;
+    const size_t newSize = selected ? after.numberOfNodes(lvl) : 0;
+    const size_t newRankStart = after.nonPhantomRank(newStart);
+    levelCells(*octree_, levelEnumStart_, lvl,
+               [&](size_t node, size_t mortonCell, size_t chunk) {
+                 const size_t oldCell = mortonToEnum_.empty()
+                                            ? mortonCell
+                                            : mortonToEnum_[mortonCell];
+                 const size_t newNode = streamIndexRemap[node];
+                 if (newNode < newStart || newNode >= newStart + newSize ||
+                     after.nodesStream()[newNode].isPhantom()) {
+                   chunkRemoved[chunk].push_back(mortonIndices_[oldCell]);
+                   return;
+                 }
+                 const size_t newCell = cells.levelEnumStart[lvl] +
+                                        after.nonPhantomRank(newNode) -
+                                        newRankStart;
+                 oldToNew[oldCell] = newCell;
+                 newToOld[newCell] = oldCell;
+               });
+  }
+
+  // Persisting cells take their Morton index along, added cells look theirs
+  // up in the new octree
+  std::vector<std::vector<size_t>> chunkAdded(numThreads);
+  for (size_t lvl = 0; lvl < after.numberOfLevels(); ++lvl) {
+    levelCells(after, cells.levelEnumStart, lvl,
+               [&](size_t node, size_t newCell, size_t chunk) {
+                 if (newToOld[newCell] != NOT_ENUMERATED) {
+                   cells.mortonIndices[newCell] =
+                       mortonIndices_[newToOld[newCell]];
+                 } else {
+                   cells.mortonIndices[newCell] = after.mortonIndexOf(node);
+                   chunkAdded[chunk].push_back(newCell);
+                 }
+               });
+  }
+
+  // A remap that does not follow the cells mixes up the Morton order
+  std::vector<char> chunkUnordered(numThreads, 0);
+  parallel::forChunks(numCells, [&](size_t begin, size_t end, size_t chunk) {
+    for (size_t cell = begin; cell + 1 < std::min(end + 1, numCells); ++cell) {
+      const auto current = cells.mortonIndices[cell];
+      const auto next = cells.mortonIndices[cell + 1];
+      if (current.level() == next.level() &&
+          current.getBits() >= next.getBits()) {
+        chunkUnordered[chunk] = 1;
+      }
+    }
+  });
+  if (std::ranges::any_of(chunkUnordered,
+                          [](char unordered) { return unordered != 0; })) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(std::format(
+        "{}: Remap does not map every cell to the node of the same cell.",
+        sourceInfo));
+  }
+
+  // A persisting cell needs new rows only if its stencil reaches a removed or
+  // an added cell. Those cells are found by applying the offsets backwards
+  // from every changed cell; leaf rows also reach coarser cells whose
+  // neighbor contains the change and finer cells along its faces.
+  std::vector<char> dirty(numCells, 0);
+  std::vector<size_t> dirtyCells;
+  auto markDirty = [&](size_t cell) {
+    if (cell != NO_NEIGHBOR && dirty[cell] == 0) {
+      dirty[cell] = 1;
+      dirtyCells.push_back(cell);
+    }
+  };
+  AdjacencyBuffers adjacency(numCells, numOffsets, adjacencyLayout_);
+  LeafAdjacencyRows dirtyRows;
+  visitPeriodicity(*periodicity_, [&](auto periodicity) {
+    const NeighborFinder<decltype(periodicity)> finder{cells, periodicity};
+    auto markStencilReach = [&](const MortonIndex &changed) {
+      const size_t lvl = changed.level();
+      const auto coords = toSigned(changed.gridCoordinates());
+      for (const auto &offset : adjacencyOffsets_) {
+        markDirty(finder.find(lvl, coords - offset));
+      }
+      if (!hasLeafAdjacency()) {
+        return;
+      }
+      for (size_t other = 0; other < cells.levelEnumStart.size(); ++other) {
+        if (other == lvl || cells.levelEnumStart[other] == NOT_ENUMERATED) {
+          continue;
+        }
+        for (const auto &offset : adjacencyOffsets_) {
+          if (other < lvl) {
+            SignedGridCoordinates ancestor;
+            for (size_t axis = 0; axis < 3; ++axis) {
+              ancestor[axis] = coords[axis] >> (lvl - other);
+            }
+            markDirty(finder.find(other, ancestor - offset));
+            continue;
+          }
+          const auto [begin, end] =
+              finder.descendants(lvl, coords - offset, other);
+          for (size_t cell = begin; cell < end; ++cell) {
+            const auto goal = periodicity.map(
+                toSigned(cells.mortonIndices[cell].gridCoordinates()) +
+                    offset,
+                other);
+            bool inside = !isInvalidCoordinates(goal, other);
+            for (size_t axis = 0; axis < 3 && inside; ++axis) {
+              inside = (goal[axis] >> (other - lvl)) == coords[axis];
+            }
+            if (inside) {
+              markDirty(cell);
+            }
+          }
+        }
+      }
+    };
+    for (const auto &removed : chunkRemoved) {
+      std::ranges::for_each(removed, markStencilReach);
+    }
+    for (const auto &added : chunkAdded) {
+      for (const size_t cell : added) {
+        markDirty(cell);
+        markStencilReach(cells.mortonIndices[cell]);
+      }
+    }
+    std::ranges::sort(dirtyCells);
+
+    // Clean rows are copied with their indices shifted; ghost cells are
+    // linked again below
+    parallel::forEach(numCells, [&](size_t newCell) {
+      if (dirty[newCell] == 0) {
+        const size_t oldCell = newToOld[newCell];
+        for (size_t slot = 0; slot < numOffsets; ++slot) {
+          const size_t neighbor = neighborIndex(slot, oldCell);
+          adjacency.set(newCell, slot,
+                        neighbor >= size() ? NO_NEIGHBOR : oldToNew[neighbor]);
+        }
+        return;
+      }
+      const auto mortonIdx = cells.mortonIndices[newCell];
+      const size_t lvl = mortonIdx.level();
+      const auto coords = toSigned(mortonIdx.gridCoordinates());
+      for (size_t slot = 0; slot < numOffsets; ++slot) {
+        adjacency.set(newCell, slot,
+                      finder.find(lvl, coords + adjacencyOffsets_[slot]));
+      }
+    });
+
+    if (hasLeafAdjacency()) {
+      dirtyRows = buildLeafAdjacency(after, cells.mortonIndices,
+                                     cells.levelEnumStart, adjacencyOffsets_,
+                                     periodicity, std::span{dirtyCells});
+    }
+  });
+
+  CellGrid grid =
+      adjacency.interleaved
+          ? CellGrid{std::move(newOctree), std::move(cells.mortonIndices),
+                     std::move(cells.levelEnumStart), adjacencyOffsets_,
+                     std::move(adjacency.compact)}
+          : CellGrid{std::move(newOctree), std::move(cells.mortonIndices),
+                     std::move(cells.levelEnumStart), adjacencyOffsets_,
+                     std::move(adjacency.lists)};
+  grid.selectedLevels_ = selectedLevels_;
+  grid.periodicity_ = periodicity_;
+
+  if (hasLeafAdjacency()) {
+    // Row lengths first, shifted by one so that their scan gives the starts
+    const size_t numRows = numCells * numOffsets;
+    auto dirtyRow = [&](size_t cell, size_t slot) {
+      const auto it = std::ranges::lower_bound(dirtyCells, cell);
+      return static_cast<size_t>(it - dirtyCells.begin()) * numOffsets + slot;
+    };
+    std::vector<size_t> rowStart(numRows + 1, 0);
+    parallel::forEach(numCells, [&](size_t cell) {
+      for (size_t slot = 0; slot < numOffsets; ++slot) {
+        if (dirty[cell] != 0) {
+          const size_t row = dirtyRow(cell, slot);
+          rowStart[cell * numOffsets + slot + 1] =
+              dirtyRows.rowStart[row + 1] - dirtyRows.rowStart[row];
+        } else {
+          const size_t row = newToOld[cell] * numOffsets + slot;
+          rowStart[cell * numOffsets + slot + 1] =
+              leafRowStart_[row + 1] - leafRowStart_[row];
+        }
+      }
+    });
+    parallel::inclusiveScan(std::span<const size_t>{rowStart},
+                            std::span{rowStart});
+
+    grid.leafNeighbors_.resize(rowStart.back());
+    grid.leafWeights_.resize(rowStart.back());
+    parallel::forEach(numCells, [&](size_t cell) {
+      for (size_t slot = 0; slot < numOffsets; ++slot) {
+        size_t to = rowStart[cell * numOffsets + slot];
+        if (dirty[cell] != 0) {
+          const size_t row = dirtyRow(cell, slot);
+          for (size_t i = dirtyRows.rowStart[row];
+               i < dirtyRows.rowStart[row + 1]; ++i, ++to) {
+            grid.leafNeighbors_[to] = dirtyRows.neighbors[i];
+            grid.leafWeights_[to] = dirtyRows.weights[i];
+          }
+        } else {
+          const size_t row = newToOld[cell] * numOffsets + slot;
+          for (size_t i = leafRowStart_[row]; i < leafRowStart_[row + 1];
+               ++i, ++to) {
+            grid.leafNeighbors_[to] = oldToNew[leafNeighbors_[i]];
+            grid.leafWeights_[to] = leafWeights_[i];
+          }
+        }
+      }
+    });
+    grid.leafRowStart_ = std::move(rowStart);
+  }
+
+  // Cell values of the fields carry over to the persisting cells
+  std::vector<size_t> source = std::move(newToOld);
+  if (ordering_ != Ordering::Morton) {
+    // The renumbering depends on the whole grid, and so do the ghost cells
+    // and the classification appended to it
+    const auto newIndex = grid.applyOrdering(ordering_);
+    std::vector<size_t> renumbered(numCells);
+    parallel::forEach(numCells, [&](size_t cell) {
+      renumbered[newIndex[cell]] = source[cell];
+    });
+    source = std::move(renumbered);
+    if (ghostCells_) {
+      grid.addGhostCells();
+    }
+    grid.classifyCells();
+  } else {
+    if (ghostCells_) {
+      // Ghosts of clean cells persist; their periodic partner is looked up
+      // again if it was removed or missing
+      std::vector<GhostCell> ghosts;
+      ghosts.reserve(ghosts_.size());
+      auto nextDirty = dirtyCells.begin();
+      auto appendDirtyBefore = [&](size_t cell) {
+        for (; nextDirty != dirtyCells.end() && *nextDirty < cell;
+             ++nextDirty) {
+          appendGhosts(grid, *periodicity_, *nextDirty, ghosts);
+        }
+      };
+      for (const GhostCell &ghost : ghosts_) {
+        const size_t cell = oldToNew[ghost.cell];
+        if (cell == NOT_ENUMERATED || dirty[cell] != 0) {
+          continue;
+        }
+        appendDirtyBefore(cell);
+        GhostCell moved = ghost;
+        moved.cell = cell;
+        moved.periodicPartner = ghost.periodicPartner == NO_NEIGHBOR
+                                    ? NO_NEIGHBOR
+                                    : oldToNew[ghost.periodicPartner];
+        if (moved.periodicPartner == NO_NEIGHBOR) {
+          const auto mortonIdx = grid.mortonIndices_[cell];
+          const auto &offset = adjacencyOffsets_[ghost.slot];
+          moved.periodicPartner = periodicPartner(
+              grid, mortonIdx.level(),
+              toSigned(mortonIdx.gridCoordinates()) + offset, offset);
+        }
+        ghosts.push_back(moved);
+      }
+      appendDirtyBefore(numCells);
+      grid.ghosts_ = std::move(ghosts);
+      grid.linkGhostCells();
+    }
+    grid.reclassifyCells(*this, oldToNew, dirty, dirtyCells);
+  }
+  // Deriving the geometry from the Morton indices costs as much as copying it
+  if (geometryCached_) {
+    grid.cacheGeometry();
+  }
+  source.resize(grid.size() + grid.numberOfGhosts(), FieldRegistry::NO_SOURCE);
+  grid.fields_ = fields_.remapped(source.size(), source);
+  return grid;
+}
+
 // -------------------------------------------------------------------------
 // Cell Builder Implementation
 // -------------------------------------------------------------------------
@@ -83,91 +1671,137 @@ CellGridBuilder &CellGridBuilder::neighborhood(
   return *this;
 }
 
-// NOLINTNEXTLINE
-CellGrid CellGridBuilder::build() {
+CellGridBuilder &CellGridBuilder::adjacencyLayout(AdjacencyLayout layout) {
+  adjacencyLayout_ = layout;
+  return *this;
+}
 
-  // DEFAULT: all levels of the octree should be taken
-  if (levels_.empty()) {
-    levels_.resize(octree_->getLevels().size());
-    std::ranges::iota(levels_, 0);
-  }
+CellGridBuilder &CellGridBuilder::ordering(Ordering order) {
+  ordering_ = order;
+  return *this;
+}
+
+CellGridBuilder &CellGridBuilder::leafAdjacency(bool enable) {
+  leafAdjacency_ = enable;
+  return *this;
+}
+
+CellGridBuilder &CellGridBuilder::cache(std::filesystem::path path) {
+  cachePath_ = std::move(path);
+  return *this;
+}
+
+CellGridBuilder &CellGridBuilder::ghostCells(bool enable) {
+  ghostCells_ = enable;
+  return *this;
+}
+
+CellGridBuilder &CellGridBuilder::geometryCache(bool enable) {
+  geometryCache_ = enable;
+  return *this;
+}
 
+CellGrid CellGridBuilder::build() {
   // DEFAULT: no periodicity
   if (periodicityHandler_ == nullptr) {
-    periodicityHandler_ = std::make_unique<NoPeriodicity>(NoPeriodicity());
+    periodicityHandler_ = std::make_shared<NoPeriodicity>(NoPeriodicity());
+  }
+  const auto configuration = configurationFingerprint();
+  if (cachePath_.empty() || !configuration) {
+    return buildGrid();
   }
 
-  const size_t numNonPhantomCells = octree_->numberOfNonPhantomNodes(levels_);
-
-  std::vector<MortonIndex> mortonIndices(numNonPhantomCells);
-  std::vector<size_t> streamIndexToEnum(octree_->numberOfNodes(),
-                                        CellGrid::NOT_ENUMERATED);
-
-  // Enumerate cells in Z-order via horizontalRange
-  size_t idx = 0;
-  for (const auto lvl : levels_) {
-    for (const auto &cell : octree_->horizontalRange(lvl)) {
-      mortonIndices[idx] = cell.mortonIndex();
-      streamIndexToEnum[cell.streamIndex()] = idx;
-      ++idx;
+  // An unreadable or outdated cache is replaced
+  if (std::filesystem::exists(cachePath_)) {
+    try {
+      if (auto cached = CellGrid::read(cachePath_, octree_, configuration)) {
+        return std::move(*cached);
+      }
+    } catch (const std::runtime_error &) {
     }
   }
-  std::vector<AdjacencyList> adjacencyLists;
+  CellGrid grid = buildGrid();
+  // The cache only saves time, so a failed write keeps the built grid
+  try {
+    grid.save(cachePath_);
+  } catch (const std::runtime_error &) {
+  }
+  return grid;
+}
 
-  // If no neighbor offsets specified, no adjacency lists should be created
-  if (!adjacencyOffsets_.empty()) {
+// NOLINTNEXTLINE
+CellGrid CellGridBuilder::buildGrid() {
 
-    adjacencyLists.assign(
-        adjacencyOffsets_.size(),
-        AdjacencyList(mortonIndices.size(), CellGrid::NO_NEIGHBOR));
+  if (leafAdjacency_ &&
+      !std::ranges::all_of(adjacencyOffsets_, [](const auto &offset) {
+        return faceAxis(offset) != 3;
+      })) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(std::format(
+        "{}: Leaf adjacency requires face offsets only.", sourceInfo));
+  }
 
-    // Cache coordinates for faster neighbor search
-    // Note: there can be multiple candidates for coordinates due to multiple
-    // levels, so we use multimap
-    std::unordered_multimap<UnsignedGridCoordinates, size_t> coordToEnum;
-    for (size_t idx = 0; idx < mortonIndices.size(); ++idx) {
-      coordToEnum.emplace(mortonIndices[idx].gridCoordinates(), idx);
-    }
+  // DEFAULT: no periodicity
+  if (periodicityHandler_ == nullptr) {
+    periodicityHandler_ = std::make_shared<NoPeriodicity>(NoPeriodicity());
+  }
 
-    for (size_t offsetIdx = 0; offsetIdx < adjacencyOffsets_.size();
-         ++offsetIdx) {
-      const auto &currentOffset = adjacencyOffsets_.at(offsetIdx);
-      for (size_t enumIdx = 0; enumIdx < mortonIndices.size(); ++enumIdx) {
-        const auto mortonIdx = mortonIndices.at(enumIdx);
+  // Enumerate cells level by level, each level in Z-order. DEFAULT: all levels
+  // of the octree should be taken
+  LevelEnumeration cells = enumerateCells(*octree_, levels_);
+  const size_t numOffsets = adjacencyOffsets_.size();
+  AdjacencyBuffers adjacency(cells.mortonIndices.size(), numOffsets,
+                             adjacencyLayout_);
 
-        const auto goalCoordsSigned =
-            periodicityHandler_->getNeighborCoordinates(
-                toSigned(mortonIdx.gridCoordinates()) + currentOffset,
-                mortonIdx.level());
+  LeafAdjacencyRows leafRows;
+  visitPeriodicity(*periodicityHandler_, [&](auto periodicity) {
+    // If no neighbor offsets specified, no adjacency lists should be created
+    if (numOffsets != 0) {
+      const NeighborFinder<decltype(periodicity)> finder{cells, periodicity};
+      parallel::forEach(cells.mortonIndices.size(), [&](size_t enumIdx) {
+        const auto mortonIdx = cells.mortonIndices[enumIdx];
+        const size_t lvl = mortonIdx.level();
+        const auto coords = toSigned(mortonIdx.gridCoordinates());
 
-        if (isInvalidCoordinates(goalCoordsSigned)) {
-          continue;
+        for (size_t offsetIdx = 0; offsetIdx < numOffsets; ++offsetIdx) {
+          adjacency.set(
+              enumIdx, offsetIdx,
+              finder.find(lvl, coords + adjacencyOffsets_[offsetIdx]));
         }
+      });
+    }
 
-        // Cast back to unsigned to compare with possible neighbors
-        const auto goalCoords = toUnsigned(goalCoordsSigned);
-
-        if (coordToEnum.contains(goalCoords)) {
-          const auto possibleNeighbors = coordToEnum.equal_range(goalCoords);
+    if (leafAdjacency_) {
+      leafRows = buildLeafAdjacency(
+          *octree_, cells.mortonIndices, cells.levelEnumStart,
+          adjacencyOffsets_, periodicity,
+          std::views::iota(0uz, cells.mortonIndices.size()));
+    }
+  });
 
-          // Possible neighbors have the desired goal coordinates
-          for (const auto &[coords, neighborIdx] : std::ranges::subrange(
-                   possibleNeighbors.first, possibleNeighbors.second)) {
-            const MortonIndex &possibleNeighbor = mortonIndices.at(neighborIdx);
+  CellGrid grid =
+      adjacency.interleaved
+          ? CellGrid{octree_, std::move(cells.mortonIndices),
+                     std::move(cells.levelEnumStart), adjacencyOffsets_,
+                     std::move(adjacency.compact)}
+          : CellGrid{octree_, std::move(cells.mortonIndices),
+                     std::move(cells.levelEnumStart), adjacencyOffsets_,
+                     std::move(adjacency.lists)};
+  grid.leafRowStart_ = std::move(leafRows.rowStart);
+  grid.leafNeighbors_ = std::move(leafRows.neighbors);
+  grid.leafWeights_ = std::move(leafRows.weights);
+  grid.selectedLevels_ = levels_;
+  grid.periodicity_ = periodicityHandler_;
 
-            // The true neighbor is at the same level
-            if (possibleNeighbor.level() == mortonIdx.level()) {
-              adjacencyLists[offsetIdx][enumIdx] = neighborIdx;
-              continue;
-            }
-          }
-        }
-      }
-    }
+  grid.applyOrdering(ordering_);
+  if (ghostCells_) {
+    grid.addGhostCells();
   }
-
-  return {octree_, mortonIndices, streamIndexToEnum, adjacencyOffsets_,
-          adjacencyLists};
+  grid.classifyCells();
+  if (geometryCache_) {
+    grid.cacheGeometry();
+  }
+  return grid;
 }
 
 // -------------------------------------------------------------------------
@@ -188,19 +1822,14 @@ NoPeriodicity::getNeighborCoordinates(SignedGridCoordinates goalCoords,
 SignedGridCoordinates
 Torus::getNeighborCoordinates(SignedGridCoordinates goalCoords,
                               size_t lvl) const {
-  SignedGridCoordinates resultCoords;
-  const std::ptrdiff_t size = 1 << lvl; // 2^level cells per dimension
+  // 2^level cells per dimension, so wrapping into [0, size) is a mask
+  const std::ptrdiff_t mask = (std::ptrdiff_t{1} << lvl) - 1;
 
   for (size_t i = 0; i < goalCoords.size(); ++i) {
     if (periodic_.at(i)) {
-      // wrap into [0, size)
-      resultCoords[i] =
-          static_cast<ptrdiff_t>((goalCoords[i] % size + size) % size);
-    } else {
-      // just cast directly
-      resultCoords[i] = static_cast<ptrdiff_t>(goalCoords[i]);
+      goalCoords[i] &= mask;
     }
   }
-  return resultCoords;
+  return goalCoords;
 }
 } // namespace oktal
\ No newline at end of file
@@ -0,0 +1,547 @@
+#include "oktal/octree/CellGrid.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace oktal {
+
+namespace {
+
+// Layout of a cache file, all integers in native byte order:
+//  - Header (64 bytes)
+//  - SectionEntry table with one entry per Section
+//  - the sections, each starting at a multiple of SECTION_ALIGNMENT
+constexpr std::array<char, 8> MAGIC{'O', 'K', 'T', 'A', 'L', 'G', 'R', 'D'};
+constexpr std::uint64_t VERSION = 1;
+constexpr std::uint64_t SECTION_ALIGNMENT = 64;
+
+enum class Section : std::uint8_t {
+  MortonIndices,
+  LevelEnumStart,
+  MortonToEnum,
+  SelectedLevels,
+  AdjacencyOffsets,
+  // The adjacency lists of all offsets one after another
+  AdjacencyLists,
+  InterleavedAdjacency,
+  LeafRowStart,
+  LeafNeighbors,
+  LeafWeights,
+  ColorStart,
+  Ghosts,
+  COUNT
+};
+
+constexpr std::size_t NUM_SECTIONS = static_cast<std::size_t>(Section::COUNT);
+
+// Bits of Header::options
+constexpr std::uint64_t INTERLEAVED = 1U << 0U;
+constexpr std::uint64_t GHOST_CELLS = 1U << 1U;
+constexpr std::uint64_t GEOMETRY_CACHE = 1U << 2U;
+constexpr std::uint64_t PERIODIC_AXIS = 1U << 3U; // three bits, x to z
+constexpr std::uint64_t ORDERING_SHIFT = 8;
+
+struct Header {
+  std::array<char, 8> magic;
+  std::uint64_t version;
+  std::uint64_t octreeFingerprint;
+  std::uint64_t configurationFingerprint;
+  std::uint64_t numberOfCells;
+  std::uint64_t options;
+  std::uint64_t numberOfSections;
+  std::uint64_t reserved;
+};
+
+struct SectionEntry {
+  std::uint64_t offset;
+  std::uint64_t bytes;
+};
+
+static_assert(sizeof(Header) == SECTION_ALIGNMENT);
+static_assert(std::is_trivially_copyable_v<MortonIndex>);
+static_assert(std::is_trivially_copyable_v<AdjacencyOffset>);
+static_assert(std::is_trivially_copyable_v<GhostCell>);
+
+/**
+ * @brief 64-bit FNV-1a hash over a sequence of values
+ */
+class Fingerprint {
+public:
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  void add(std::span<const T> values) {
+    for (const std::byte byte : std::as_bytes(values)) {
+      hash_ = (hash_ ^ static_cast<std::uint64_t>(byte)) * PRIME;
+    }
+  }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  void add(const T &value) {
+    add(std::span<const T>{&value, 1});
+  }
+
+  [[nodiscard]] std::uint64_t value() const { return hash_; }
+
+private:
+  static constexpr std::uint64_t PRIME = 0x100000001b3;
+  std::uint64_t hash_ = 0xcbf29ce484222325;
+};
+
+// Nodes consist of their flag bits only, so the bytes of the node stream
+// identify the refinement pattern
+std::uint64_t octreeFingerprint(const CellOctree &octree) {
+  Fingerprint fingerprint;
+  fingerprint.add(octree.nodesStream());
+  fingerprint.add(octree.numberOfLevels());
+  for (const auto &[start, size] : octree.getLevels()) {
+    fingerprint.add(start);
+    fingerprint.add(size);
+  }
+  const OctreeGeometry &geometry = octree.geometry();
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    fingerprint.add(geometry.origin()[axis]);
+  }
+  fingerprint.add(geometry.sidelength());
+  return fingerprint.value();
+}
+
+std::uint64_t configurationOptions(AdjacencyLayout layout, Ordering ordering,
+                                   bool ghostCells, bool geometryCache,
+                                   const std::array<bool, 3> &periodic) {
+  std::uint64_t options = 0;
+  if (layout == AdjacencyLayout::Interleaved) {
+    options |= INTERLEAVED;
+  }
+  if (ghostCells) {
+    options |= GHOST_CELLS;
+  }
+  if (geometryCache) {
+    options |= GEOMETRY_CACHE;
+  }
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    if (periodic[axis]) {
+      options |= PERIODIC_AXIS << axis;
+    }
+  }
+  return options | (static_cast<std::uint64_t>(ordering) << ORDERING_SHIFT);
+}
+
+std::uint64_t configurationFingerprint(std::span<const std::size_t> levels,
+                                       std::span<const AdjacencyOffset> offsets,
+                                       bool leafAdjacency,
+                                       std::uint64_t options) {
+  Fingerprint fingerprint;
+  fingerprint.add(levels.size());
+  fingerprint.add(levels);
+  fingerprint.add(offsets.size());
+  for (const AdjacencyOffset &offset : offsets) {
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      fingerprint.add(offset[axis]);
+    }
+  }
+  fingerprint.add(leafAdjacency);
+  fingerprint.add(options);
+  return fingerprint.value();
+}
+
+std::array<bool, 3> periodicAxes(const PeriodicityMapper *mapper) {
+  if (mapper == nullptr) {
+    return {false, false, false};
+  }
+  const auto axes = mapper->wrappedAxes();
+  if (!axes) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::logic_error(std::format(
+        "{}: Periodicity mapper without wrappedAxes() cannot be saved.",
+        sourceInfo));
+  }
+  return *axes;
+}
+
+std::uint64_t alignUp(std::uint64_t offset) {
+  return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT *
+         SECTION_ALIGNMENT;
+}
+
+[[noreturn]] void malformed(const std::filesystem::path &path,
+                            std::string_view reason) {
+  const auto sourceInfo = source_info(std::source_location::current());
+  throw std::runtime_error(std::format("{}: '{}' is no valid grid cache: {}.",
+                                       sourceInfo, path.string(), reason));
+}
+
+// Row starts must ascend from 0 to end
+void requireRowStarts(const std::filesystem::path &path,
+                      std::span<const std::size_t> starts, std::size_t end,
+                      std::string_view what) {
+  if (starts.front() != 0 || starts.back() != end ||
+      !std::ranges::is_sorted(starts)) {
+    malformed(path, std::format("inconsistent {}", what));
+  }
+}
+
+// Every index must be below bound or equal to none
+template <typename T>
+void requireIndices(const std::filesystem::path &path,
+                    std::span<const T> indices, std::size_t bound, T none,
+                    std::string_view what) {
+  if (!std::ranges::all_of(indices, [bound, none](T index) {
+        return index == none || static_cast<std::size_t>(index) < bound;
+      })) {
+    malformed(path, std::format("{} out of range", what));
+  }
+}
+
+class CacheReader {
+public:
+  explicit CacheReader(const std::filesystem::path &path)
+      : path_(path), stream_(path, std::ios::binary) {
+    if (!stream_) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::runtime_error(std::format("{}: Cannot open '{}'.", sourceInfo,
+                                           path.string()));
+    }
+    fileSize_ = std::filesystem::file_size(path);
+  }
+
+  [[nodiscard]] Header header() {
+    Header header{};
+    readAt(0, std::as_writable_bytes(std::span{&header, 1}));
+    if (header.magic != MAGIC) {
+      malformed(path_, "wrong magic number");
+    }
+    if (header.version != VERSION) {
+      malformed(path_, std::format("unsupported version {}", header.version));
+    }
+    if (header.numberOfSections != NUM_SECTIONS) {
+      malformed(path_, "wrong number of sections");
+    }
+    readAt(sizeof(Header), std::as_writable_bytes(std::span{sections_}));
+    return header;
+  }
+
+  template <typename T>
+  [[nodiscard]] std::vector<T> section(Section section) {
+    const SectionEntry &entry = sections_[static_cast<std::size_t>(section)];
+    if (entry.bytes % sizeof(T) != 0) {
+      malformed(path_, "truncated section");
+    }
+    // Checked before allocating, so corrupt sizes fail as malformed caches
+    requireInFile(entry.offset, entry.bytes);
+    std::vector<T> values(entry.bytes / sizeof(T));
+    readAt(entry.offset, std::as_writable_bytes(std::span{values}));
+    return values;
+  }
+
+private:
+  const std::filesystem::path &path_;
+  std::ifstream stream_;
+  std::uint64_t fileSize_;
+  std::array<SectionEntry, NUM_SECTIONS> sections_{};
+
+  void requireInFile(std::uint64_t offset, std::uint64_t bytes) const {
+    if (offset > fileSize_ || bytes > fileSize_ - offset) {
+      malformed(path_, "section exceeds the file");
+    }
+  }
+
+  void readAt(std::uint64_t offset, std::span<std::byte> bytes) {
+    requireInFile(offset, bytes.size());
+    stream_.seekg(static_cast<std::streamoff>(offset));
+    stream_.read(reinterpret_cast<char *>(bytes.data()),
+                 static_cast<std::streamsize>(bytes.size()));
+    if (!stream_) {
+      malformed(path_, "read failed");
+    }
+  }
+};
+
+} // namespace
+
+std::uint64_t CellGrid::configurationFingerprint() const {
+  return oktal::configurationFingerprint(
+      selectedLevels_, adjacencyOffsets_, hasLeafAdjacency(),
+      configurationOptions(adjacencyLayout_, ordering_, ghostCells_,
+                           geometryCached_, periodicAxes(periodicity_.get())));
+}
+
+std::optional<std::uint64_t>
+CellGridBuilder::configurationFingerprint() const {
+  const auto axes = periodicityHandler_ == nullptr
+                        ? std::optional{std::array{false, false, false}}
+                        : periodicityHandler_->wrappedAxes();
+  if (!axes) {
+    return std::nullopt;
+  }
+  return oktal::configurationFingerprint(
+      levels_, adjacencyOffsets_, leafAdjacency_,
+      configurationOptions(adjacencyLayout_, ordering_, ghostCells_,
+                           geometryCache_, *axes));
+}
+
+void CellGrid::save(const std::filesystem::path &path) const {
+  const std::array<bool, 3> axes = periodicAxes(periodicity_.get());
+
+  std::vector<size_t> concatenatedLists;
+  for (const AdjacencyList &list : adjacencyLists_) {
+    concatenatedLists.insert(concatenatedLists.end(), list.begin(),
+                             list.end());
+  }
+
+  std::array<std::span<const std::byte>, NUM_SECTIONS> sections;
+  const auto put = [&sections](Section section, auto values) {
+    sections[static_cast<std::size_t>(section)] =
+        std::as_bytes(std::span{values});
+  };
+  put(Section::MortonIndices, std::span{mortonIndices_});
+  put(Section::LevelEnumStart, std::span{levelEnumStart_});
+  put(Section::MortonToEnum, std::span{mortonToEnum_});
+  put(Section::SelectedLevels, std::span{selectedLevels_});
+  put(Section::AdjacencyOffsets, std::span{adjacencyOffsets_});
+  put(Section::AdjacencyLists, std::span{concatenatedLists});
+  put(Section::InterleavedAdjacency, std::span{interleavedAdjacency_});
+  put(Section::LeafRowStart, std::span{leafRowStart_});
+  put(Section::LeafNeighbors, std::span{leafNeighbors_});
+  put(Section::LeafWeights, std::span{leafWeights_});
+  put(Section::ColorStart, std::span{colorStart_});
+  put(Section::Ghosts, std::span{ghosts_});
+
+  const Header header{
+      .magic = MAGIC,
+      .version = VERSION,
+      .octreeFingerprint = octreeFingerprint(*octree_),
+      .configurationFingerprint = configurationFingerprint(),
+      .numberOfCells = size(),
+      .options = configurationOptions(adjacencyLayout_, ordering_,
+                                      ghostCells_, geometryCached_, axes),
+      .numberOfSections = NUM_SECTIONS,
+      .reserved = 0};
+  std::array<SectionEntry, NUM_SECTIONS> table{};
+  std::uint64_t offset =
+      alignUp(sizeof(Header) + sizeof(SectionEntry) * NUM_SECTIONS);
+  for (std::size_t s = 0; s < NUM_SECTIONS; ++s) {
+    table[s] = {offset, sections[s].size()};
+    offset = alignUp(offset + sections[s].size());
+  }
+
+  // Write next to the target and rename, so that readers never see a
+  // partially written cache
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+    const auto write = [&stream](std::span<const std::byte> bytes) {
+      stream.write(reinterpret_cast<const char *>(bytes.data()),
+                   static_cast<std::streamsize>(bytes.size()));
+    };
+    const std::array<std::byte, SECTION_ALIGNMENT> padding{};
+    write(std::as_bytes(std::span{&header, 1}));
+    write(std::as_bytes(std::span{table}));
+    std::uint64_t position = sizeof(Header) + sizeof(table);
+    for (std::size_t s = 0; s < NUM_SECTIONS; ++s) {
+      write(std::span{padding}.first(table[s].offset - position));
+      write(sections[s]);
+      position = table[s].offset + table[s].bytes;
+    }
+    if (!stream.flush()) {
+      const auto sourceInfo = source_info(std::source_location::current());
+      throw std::runtime_error(std::format("{}: Cannot write '{}'.",
+                                           sourceInfo, temporary.string()));
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::runtime_error(
+        std::format("{}: Cannot write '{}'.", sourceInfo, path.string()));
+  }
+}
+
+CellGrid CellGrid::load(const std::filesystem::path &path,
+                        std::shared_ptr<const CellOctree> octree) {
+  auto grid = read(path, std::move(octree), std::nullopt);
+  if (!grid) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(
+        std::format("{}: '{}' holds a grid of another octree.", sourceInfo,
+                    path.string()));
+  }
+  return std::move(*grid);
+}
+
+std::optional<CellGrid>
+CellGrid::read(const std::filesystem::path &path,
+               std::shared_ptr<const CellOctree> octree,
+               std::optional<std::uint64_t> configuration) {
+  CacheReader reader(path);
+  const Header header = reader.header();
+  if (header.octreeFingerprint != octreeFingerprint(*octree) ||
+      (configuration && header.configurationFingerprint != *configuration)) {
+    return std::nullopt;
+  }
+
+  // All sections are checked before the grid uses them, so that corrupt
+  // contents fail as malformed caches instead of indexing out of bounds
+  auto mortonIndices = reader.section<MortonIndex>(Section::MortonIndices);
+  auto levelEnumStart = reader.section<size_t>(Section::LevelEnumStart);
+  auto offsets = reader.section<AdjacencyOffset>(Section::AdjacencyOffsets);
+  auto selectedLevels = reader.section<size_t>(Section::SelectedLevels);
+  auto mortonToEnum = reader.section<size_t>(Section::MortonToEnum);
+  auto colorStart = reader.section<size_t>(Section::ColorStart);
+  auto leafRowStart = reader.section<size_t>(Section::LeafRowStart);
+  auto leafNeighbors = reader.section<size_t>(Section::LeafNeighbors);
+  auto leafWeights = reader.section<double>(Section::LeafWeights);
+  auto ghosts = reader.section<GhostCell>(Section::Ghosts);
+  const size_t numCells = mortonIndices.size();
+  const size_t numSlots = offsets.size();
+  if (numCells != header.numberOfCells ||
+      levelEnumStart.size() != octree->numberOfLevels()) {
+    malformed(path, "inconsistent cell count");
+  }
+
+  // The levels are enumerated like enumerateCells() does
+  std::vector<size_t> expectedStart(octree->numberOfLevels(), NOT_ENUMERATED);
+  size_t enumerated = 0;
+  const auto select = [&](size_t lvl) {
+    if (lvl < octree->numberOfLevels()) {
+      expectedStart[lvl] = enumerated;
+      enumerated += octree->numberOfNonPhantomNodes(lvl);
+    }
+  };
+  if (selectedLevels.empty()) {
+    for (size_t lvl = 0; lvl < octree->numberOfLevels(); ++lvl) {
+      select(lvl);
+    }
+  } else {
+    std::ranges::for_each(selectedLevels, select);
+  }
+  if (enumerated != numCells || levelEnumStart != expectedStart) {
+    malformed(path, "inconsistent level enumeration");
+  }
+
+  if (!mortonToEnum.empty()) {
+    std::vector<char> seen(numCells, 0);
+    if (mortonToEnum.size() != numCells ||
+        !std::ranges::all_of(mortonToEnum, [&seen](size_t cell) {
+          return cell < seen.size() && std::exchange(seen[cell], 1) == 0;
+        })) {
+      malformed(path, "enumeration is no permutation");
+    }
+  }
+  for (size_t lvl = 0; lvl < levelEnumStart.size(); ++lvl) {
+    if (levelEnumStart[lvl] == NOT_ENUMERATED) {
+      continue;
+    }
+    const size_t end =
+        levelEnumStart[lvl] + octree->numberOfNonPhantomNodes(lvl);
+    for (size_t idx = levelEnumStart[lvl]; idx < end; ++idx) {
+      const size_t cell = mortonToEnum.empty() ? idx : mortonToEnum[idx];
+      if (mortonIndices[cell].level() != lvl) {
+        malformed(path, "inconsistent Morton indices");
+      }
+    }
+  }
+
+  const auto ordering = header.options >> ORDERING_SHIFT;
+  if (ordering > static_cast<std::uint64_t>(Ordering::Multicolor)) {
+    malformed(path, std::format("unknown ordering {}", ordering));
+  }
+  if (!colorStart.empty()) {
+    requireRowStarts(path, colorStart, numCells, "colors");
+  }
+  if (leafRowStart.empty()) {
+    if (!leafNeighbors.empty() || !leafWeights.empty()) {
+      malformed(path, "inconsistent leaf adjacency");
+    }
+  } else {
+    if (leafRowStart.size() != numCells * numSlots + 1 ||
+        leafWeights.size() != leafNeighbors.size()) {
+      malformed(path, "inconsistent leaf adjacency");
+    }
+    requireRowStarts(path, leafRowStart, leafNeighbors.size(),
+                     "leaf adjacency");
+    requireIndices(path, std::span<const size_t>{leafNeighbors}, numCells,
+                   NO_NEIGHBOR, "leaf neighbors");
+  }
+  if (!std::ranges::all_of(ghosts, [&](const GhostCell &ghost) {
+        return ghost.cell < numCells && ghost.slot < numSlots &&
+               (ghost.periodicPartner < numCells ||
+                ghost.periodicPartner == NO_NEIGHBOR);
+      })) {
+    malformed(path, "ghost cells out of range");
+  }
+  const size_t numNeighbors = numCells + ghosts.size();
+
+  const auto finish = [&](CellGrid grid) {
+    grid.mortonToEnum_ = std::move(mortonToEnum);
+    grid.ordering_ = static_cast<Ordering>(ordering);
+    grid.colorStart_ = std::move(colorStart);
+    grid.selectedLevels_ = std::move(selectedLevels);
+    grid.periodicity_ = std::make_shared<Torus>(
+        (header.options & PERIODIC_AXIS) != 0,
+        (header.options & (PERIODIC_AXIS << 1U)) != 0,
+        (header.options & (PERIODIC_AXIS << 2U)) != 0);
+    grid.leafRowStart_ = std::move(leafRowStart);
+    grid.leafNeighbors_ = std::move(leafNeighbors);
+    grid.leafWeights_ = std::move(leafWeights);
+    grid.ghostCells_ = (header.options & GHOST_CELLS) != 0;
+    grid.ghosts_ = std::move(ghosts);
+    if (grid.configurationFingerprint() != header.configurationFingerprint) {
+      malformed(path, "inconsistent configuration");
+    }
+    grid.fields_ = FieldRegistry(numNeighbors);
+    grid.classifyCells();
+    if ((header.options & GEOMETRY_CACHE) != 0) {
+      grid.cacheGeometry();
+    }
+    return grid;
+  };
+
+  if ((header.options & INTERLEAVED) != 0) {
+    auto adjacency =
+        reader.section<CompactNeighborIndex>(Section::InterleavedAdjacency);
+    if (adjacency.size() != numCells * numSlots) {
+      malformed(path, "inconsistent adjacency");
+    }
+    requireIndices(path, std::span<const CompactNeighborIndex>{adjacency},
+                   numNeighbors, NO_COMPACT_NEIGHBOR, "neighbors");
+    return finish(CellGrid(std::move(octree), std::move(mortonIndices),
+                           std::move(levelEnumStart), std::move(offsets),
+                           std::move(adjacency)));
+  }
+
+  const auto concatenatedLists =
+      reader.section<size_t>(Section::AdjacencyLists);
+  if (concatenatedLists.size() != numCells * numSlots) {
+    malformed(path, "inconsistent adjacency");
+  }
+  requireIndices(path, std::span<const size_t>{concatenatedLists},
+                 numNeighbors, NO_NEIGHBOR, "neighbors");
+  std::vector<AdjacencyList> adjacencyLists;
+  adjacencyLists.reserve(numSlots);
+  for (size_t slot = 0; slot < numSlots; ++slot) {
+    const auto first = concatenatedLists.begin() +
+                       static_cast<std::ptrdiff_t>(slot * numCells);
+    adjacencyLists.emplace_back(first,
+                                first + static_cast<std::ptrdiff_t>(numCells));
+  }
+  return finish(CellGrid(std::move(octree), std::move(mortonIndices),
+                         std::move(levelEnumStart), std::move(offsets),
+                         std::move(adjacencyLists)));
+}
+
+} // namespace oktal
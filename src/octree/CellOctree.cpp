@@ -2,10 +2,15 @@
 #include "oktal/octree/MortonIndex.hpp"
 #include "oktal/octree/OctreeGeometry.hpp"
 #include <algorithm>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace {
 bool isInvalidDescriptor(const std::string_view &descriptor) {
@@ -34,6 +39,80 @@ bool isInvalidDescriptor(const std::string_view &descriptor) {
 
   return numTotalNodes != (numRefinedNodes * 8 + 1);
 }
+
+// State of one operand at the current position of a simultaneous sweep.
+// Positions below a leaf of the operand inherit the flags of that leaf.
+struct SweepNode {
+  std::size_t streamIndex;
+  bool refined;
+  bool phantom;
+};
+
+SweepNode sweepNode(std::span<const oktal::CellOctree::Node> stream,
+                    std::size_t streamIndex) {
+  const auto &node = stream[streamIndex];
+  return {streamIndex, node.isRefined(), node.isPhantom()};
+}
+
+SweepNode sweepChild(std::span<const oktal::CellOctree::Node> stream,
+                     const SweepNode &parent, std::size_t branch) {
+  if (!parent.refined) {
+    return {oktal::CellOctree::NO_STREAM_INDEX, false, parent.phantom};
+  }
+  return sweepNode(stream, stream[parent.streamIndex].childIndex(branch));
+}
+
+void assertSameGeometry(const oktal::CellOctree &a,
+                        const oktal::CellOctree &b) {
+  if (a.geometry().origin() != b.geometry().origin() ||
+      a.geometry().sidelength() != b.geometry().sidelength()) {
+    throw std::invalid_argument(
+        "Octrees with different geometries cannot be merged!");
+  }
+}
+
+// Sweeps both octrees level by level; TOp maps the states of both operands to
+// the (refined, phantom) flags of the resulting node
+template <typename TOp>
+oktal::CellOctree mergeOctrees(const oktal::CellOctree &a,
+                               const oktal::CellOctree &b, TOp op) {
+  using oktal::CellOctree;
+
+  assertSameGeometry(a, b);
+
+  const auto streamA = a.nodesStream();
+  const auto streamB = b.nodesStream();
+
+  std::vector<CellOctree::Node> nodes;
+  std::vector<std::pair<std::size_t, std::size_t>> levels;
+  nodes.reserve(streamA.size() + streamB.size());
+
+  std::vector<std::pair<SweepNode, SweepNode>> current{
+      {sweepNode(streamA, 0), sweepNode(streamB, 0)}};
+  std::vector<std::pair<SweepNode, SweepNode>> next;
+
+  while (!current.empty()) {
+    levels.emplace_back(nodes.size(), current.size());
+    const std::size_t nextLevelStart = nodes.size() + current.size();
+    next.clear();
+
+    for (const auto &[nodeA, nodeB] : current) {
+      const auto [refined, phantom] = op(nodeA, nodeB);
+      if (refined) {
+        nodes.emplace_back(true, phantom, nextLevelStart + next.size());
+        for (std::size_t branch = 0; branch < 8; ++branch) {
+          next.emplace_back(sweepChild(streamA, nodeA, branch),
+                            sweepChild(streamB, nodeB, branch));
+        }
+      } else {
+        nodes.emplace_back(false, phantom);
+      }
+    }
+    std::swap(current, next);
+  }
+
+  return {std::move(nodes), std::move(levels), a.geometry()};
+}
 } // anonymous namespace
 
 namespace oktal {
@@ -76,9 +155,215 @@ CellOctree CellOctree::fromDescriptor(std::string_view descriptor) {
     }
   }
 
+  tree.buildRankIndex();
   return tree;
 }
 
+CellOctree CellOctree::unite(const CellOctree &a, const CellOctree &b) {
+  return mergeOctrees(a, b, [](const SweepNode &na, const SweepNode &nb) {
+    return std::pair{na.refined || nb.refined, na.phantom && nb.phantom};
+  });
+}
+
+CellOctree CellOctree::intersect(const CellOctree &a, const CellOctree &b) {
+  return mergeOctrees(a, b, [](const SweepNode &na, const SweepNode &nb) {
+    return std::pair{na.refined && nb.refined, na.phantom || nb.phantom};
+  });
+}
+
+CellOctree CellOctree::subtract(const CellOctree &a, const CellOctree &b) {
+  assertSameGeometry(a, b);
+
+  const auto streamA = a.nodesStream();
+  const auto streamB = b.nodesStream();
+
+  // Top-down: refinement flags of b at the positions of the nodes of a
+  std::vector<char> refinedInB(streamA.size(), 0);
+  std::vector<std::pair<std::size_t, SweepNode>> current{
+      {0, sweepNode(streamB, 0)}};
+  std::vector<std::pair<std::size_t, SweepNode>> next;
+  while (!current.empty()) {
+    next.clear();
+    for (const auto &[indexA, nodeB] : current) {
+      refinedInB[indexA] = static_cast<char>(nodeB.refined);
+      const Node &nodeA = streamA[indexA];
+      if (nodeA.isRefined()) {
+        for (std::size_t branch = 0; branch < 8; ++branch) {
+          next.emplace_back(nodeA.childIndex(branch),
+                            sweepChild(streamB, nodeB, branch));
+        }
+      }
+    }
+    std::swap(current, next);
+  }
+
+  // Bottom-up: a refinement of a is kept if b lacks it, or if it is needed to
+  // reach a refinement that b lacks
+  std::vector<char> keep(streamA.size(), 0);
+  std::vector<char> coarsen(streamA.size(), 0);
+  // Whether the subtree of a node holds a non-phantom leaf
+  std::vector<char> hasCells(streamA.size(), 0);
+  for (std::size_t i = streamA.size(); i-- > 0;) {
+    const Node &node = streamA[i];
+    if (!node.isRefined()) {
+      hasCells[i] = static_cast<char>(!node.isPhantom());
+      continue;
+    }
+    bool kept = !static_cast<bool>(refinedInB[i]);
+    bool cells = false;
+    for (std::size_t branch = 0; branch < 8; ++branch) {
+      kept = kept || static_cast<bool>(keep[node.childIndex(branch)]);
+      cells = cells || static_cast<bool>(hasCells[node.childIndex(branch)]);
+    }
+    keep[i] = static_cast<char>(kept);
+    coarsen[i] = static_cast<char>(!kept);
+    hasCells[i] = static_cast<char>(cells);
+  }
+
+  CellOctree result = a;
+  const auto oldToNew = result.removeChildren(coarsen);
+  // A coarsened node becomes a leaf covering its former subtree, which has
+  // cells unless all of its leaves were phantoms
+  for (std::size_t i = 0; i < streamA.size(); ++i) {
+    if (static_cast<bool>(coarsen[i]) && oldToNew[i] != NO_STREAM_INDEX) {
+      result.nodesStream_[oldToNew[i]].setPhantom(
+          !static_cast<bool>(hasCells[i]));
+    }
+  }
+  result.buildRankIndex();
+  return result;
+}
+
+std::vector<std::size_t> CellOctree::compact() {
+  // Bottom-up: children are always stored behind their parent, so a reverse
+  // sweep sees every subtree before its root
+  std::vector<char> allPhantom(nodesStream_.size(), 0);
+  for (std::size_t i = nodesStream_.size(); i-- > 0;) {
+    const Node &node = nodesStream_[i];
+    bool phantom = node.isPhantom();
+    if (phantom && node.isRefined()) {
+      for (std::size_t branch = 0; branch < 8 && phantom; ++branch) {
+        phantom = static_cast<bool>(allPhantom[node.childIndex(branch)]);
+      }
+    }
+    allPhantom[i] = static_cast<char>(phantom);
+  }
+
+  return removeChildren(allPhantom);
+}
+
+std::vector<std::size_t>
+CellOctree::removeChildren(const std::vector<char> &coarsen) {
+  const std::size_t numNodes = nodesStream_.size();
+
+  // Top-down: copy the surviving nodes level by level and renumber children
+  decltype(nodesStream_) nodes;
+  decltype(levels_) levels;
+  std::vector<std::size_t> newToOld;
+  nodes.reserve(numNodes);
+  newToOld.reserve(numNodes);
+
+  nodes.push_back(nodesStream_[0]);
+  newToOld.push_back(0);
+  levels.emplace_back(0, 1);
+
+  for (std::size_t levelStart = 0; levelStart < nodes.size();) {
+    const std::size_t levelEnd = nodes.size();
+    for (std::size_t i = levelStart; i < levelEnd; ++i) {
+      const Node old = nodesStream_[newToOld[i]];
+      if (old.isRefined() && !static_cast<bool>(coarsen[newToOld[i]])) {
+        nodes[i].setChildrenStartIndex(nodes.size());
+        for (std::size_t branch = 0; branch < 8; ++branch) {
+          nodes.push_back(nodesStream_[old.childIndex(branch)]);
+          newToOld.push_back(old.childIndex(branch));
+        }
+      } else {
+        nodes[i].setRefined(false);
+        nodes[i].setChildrenStartIndex(0);
+      }
+    }
+    if (nodes.size() > levelEnd) {
+      levels.emplace_back(levelEnd, nodes.size() - levelEnd);
+    }
+    levelStart = levelEnd;
+  }
+
+  std::vector<std::size_t> oldToNew(numNodes, NO_STREAM_INDEX);
+  for (std::size_t i = 0; i < newToOld.size(); ++i) {
+    oldToNew[newToOld[i]] = i;
+  }
+
+  nodesStream_ = std::move(nodes);
+  levels_ = std::move(levels);
+  buildRankIndex();
+
+  return oldToNew;
+}
+
+std::size_t CellOctree::parentIndex(std::size_t streamIndex) const {
+  if (streamIndex == 0 || streamIndex >= nodesStream_.size()) {
+    return NO_STREAM_INDEX;
+  }
+  // First node whose refined rank, counting itself, exceeds the rank of the
+  // sibling group
+  const std::size_t group = (streamIndex - 1) / 8;
+  std::size_t first = 0;
+  std::size_t count = streamIndex;
+  while (count > 0) {
+    const std::size_t step = count / 2;
+    if (refinedRank(first + step + 1) <= group) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+MortonIndex CellOctree::mortonIndexOf(std::size_t streamIndex) const {
+  morton_bits_t bits = 0;
+  std::size_t shift = 0;
+  for (std::size_t node = streamIndex; node != 0; node = parentIndex(node)) {
+    bits |= static_cast<morton_bits_t>((node - 1) % 8) << shift;
+    shift += 3;
+  }
+  return MortonIndex{bits | (morton_bits_t{1} << shift)};
+}
+
+void CellOctree::buildRankIndex() {
+  const std::size_t numBlocks = (nodesStream_.size() >> 6) + 1;
+  nonPhantomBits_.assign(numBlocks, 0);
+  nonPhantomBlockRanks_.assign(numBlocks, 0);
+  refinedBits_.assign(numBlocks, 0);
+  refinedBlockRanks_.assign(numBlocks, 0);
+
+  for (std::size_t i = 0; i < nodesStream_.size(); ++i) {
+    if (!nodesStream_[i].isPhantom()) {
+      nonPhantomBits_[i >> 6] |= std::uint64_t{1} << (i & 63);
+    }
+    if (nodesStream_[i].isRefined()) {
+      refinedBits_[i >> 6] |= std::uint64_t{1} << (i & 63);
+    }
+  }
+
+  std::size_t rank = 0;
+  std::size_t refined = 0;
+  for (std::size_t block = 0; block < numBlocks; ++block) {
+    nonPhantomBlockRanks_[block] = rank;
+    rank += static_cast<std::size_t>(std::popcount(nonPhantomBits_[block]));
+    refinedBlockRanks_[block] = refined;
+    refined += static_cast<std::size_t>(std::popcount(refinedBits_[block]));
+  }
+
+  nonPhantomLevelPrefix_.clear();
+  nonPhantomLevelPrefix_.reserve(levels_.size() + 1);
+  for (const auto &[start, size] : levels_) {
+    nonPhantomLevelPrefix_.push_back(nonPhantomRank(start));
+  }
+  nonPhantomLevelPrefix_.push_back(rank);
+}
+
 [[nodiscard]] std::shared_ptr<const CellOctree>
 CellOctree::createUniformGrid(OctreeGeometry geom, size_t level) {
   decltype(levels_) levels;
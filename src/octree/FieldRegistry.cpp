@@ -0,0 +1,80 @@
+#include "oktal/octree/FieldRegistry.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+namespace oktal {
+
+std::size_t FieldRegistry::nextId() {
+  static std::atomic<std::size_t> next{0};
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool FieldRegistry::contains(std::string_view name) const {
+  return std::ranges::any_of(
+      fields_, [name](const Field &field) { return field.name == name; });
+}
+
+std::size_t FieldRegistry::indexOf(std::string_view name) const {
+  const auto it = std::ranges::find(fields_, name, &Field::name);
+  if (it == fields_.end()) {
+    throw std::out_of_range(
+        std::format("There is no field called '{}'!", name));
+  }
+  return static_cast<std::size_t>(it - fields_.begin());
+}
+
+FieldRegistry
+FieldRegistry::remapped(std::size_t numberOfCells,
+                        std::span<const std::size_t> source) const {
+  FieldRegistry result(numberOfCells);
+  result.id_ = id_;
+  result.hugePages_ = hugePages_;
+  for (const auto &field : fields_) {
+    const std::size_t stride = result.paddedStride(field.componentSize);
+    Field &copy = result.fields_.emplace_back(
+        Field{field.name, field.componentType, field.components,
+              field.componentSize, stride,
+              Buffer(stride * field.components * field.componentSize,
+                     std::byte{0}, field.data.get_allocator())});
+
+    // A constant size lets memcpy become a single move
+    auto copyValues = [&]<std::size_t SIZE>() {
+      parallel::forEach(numberOfCells, [&](std::size_t cell) {
+        if (source[cell] == NO_SOURCE) {
+          return;
+        }
+        for (std::size_t c = 0; c < field.components; ++c) {
+          std::memcpy(copy.data.data() + (c * stride + cell) * SIZE,
+                      field.data.data() + (c * field.stride + source[cell]) *
+                                              SIZE,
+                      SIZE);
+        }
+      });
+    };
+    switch (field.componentSize) {
+    case 1:
+      copyValues.template operator()<1>();
+      break;
+    case 2:
+      copyValues.template operator()<2>();
+      break;
+    case 4:
+      copyValues.template operator()<4>();
+      break;
+    case 8:
+      copyValues.template operator()<8>();
+      break;
+    default:
+      // Arithmetic types take 1, 2, 4, 8 or 16 bytes
+      copyValues.template operator()<16>();
+      break;
+    }
+  }
+  return result;
+}
+
+} // namespace oktal
@@ -0,0 +1,127 @@
+#include "oktal/octree/GridHierarchy.hpp"
+#include "oktal/octree/MortonIndex.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace oktal {
+
+namespace {
+
+// Cell of grid with Morton index mortonIdx, NO_CELL if it is not part of it
+size_t cellOf(const CellGrid &grid, const MortonIndex &mortonIdx) {
+  const auto cell = grid.octree().getCell(mortonIdx);
+  return cell ? grid.getEnumerationIndex(*cell) : GridHierarchy::NO_CELL;
+}
+
+// Copy of octree in which refined nodes are never phantoms
+std::shared_ptr<const CellOctree> withInteriorCells(const CellOctree &octree) {
+  std::vector<CellOctree::Node> nodes(octree.nodesStream().begin(),
+                                      octree.nodesStream().end());
+  for (auto &node : nodes) {
+    if (node.isRefined()) {
+      node.setPhantom(false);
+    }
+  }
+  const auto levels = octree.getLevels();
+  return std::make_shared<const CellOctree>(
+      std::move(nodes),
+      std::vector<std::pair<size_t, size_t>>(levels.begin(), levels.end()),
+      octree.geometry());
+}
+
+} // namespace
+
+GridHierarchy::GridHierarchy(const CellGridBuilder &builder)
+    : octree_(withInteriorCells(*builder.octree_)) {
+  const size_t numLevels = octree_->numberOfLevels();
+  grids_.reserve(numLevels);
+  for (size_t lvl = 0; lvl < numLevels; ++lvl) {
+    CellGridBuilder levelBuilder = builder;
+    levelBuilder.octree_ = octree_;
+    levelBuilder.levels_ = {lvl};
+    levelBuilder.cachePath_.clear();
+    grids_.push_back(levelBuilder.build());
+  }
+
+  parents_.resize(numLevels);
+  children_.resize(numLevels);
+  contributors_.resize(numLevels);
+  weights_.resize(numLevels);
+  for (size_t lvl = 0; lvl < numLevels; ++lvl) {
+    parents_[lvl].assign(grids_[lvl].size(), NO_CELL);
+    children_[lvl].assign(grids_[lvl].size() * NUM_CHILDREN, NO_CELL);
+  }
+
+  for (size_t lvl = 0; lvl + 1 < numLevels; ++lvl) {
+    const CellGrid &coarse = grids_[lvl];
+    const CellGrid &fine = grids_[lvl + 1];
+    std::vector<size_t> &children = children_[lvl];
+    std::vector<size_t> &parents = parents_[lvl + 1];
+    // Every fine cell has a single parent, so the scatter does not race
+    const auto mortonIndices = coarse.mortonIndices();
+    parallel::forEach(coarse.size(), [&](size_t cell) {
+      const MortonIndex mortonIdx = mortonIndices[cell];
+      for (size_t c = 0; c < NUM_CHILDREN; ++c) {
+        const size_t child = cellOf(fine, mortonIdx.child(c));
+        children[cell * NUM_CHILDREN + c] = child;
+        if (child != NO_CELL) {
+          parents[child] = cell;
+        }
+      }
+    });
+  }
+
+  // The child at fine coordinates f lies in the corner 2 * (f & 1) - 1 of
+  // its parent p; the cell-centered trilinear stencil weighs the coarse cells
+  // p + a * corner, a in {0, 1}^3, with (3/4)^(3-|a|) (1/4)^|a|
+  for (size_t lvl = 1; lvl < numLevels; ++lvl) {
+    const CellGrid &coarse = grids_[lvl - 1];
+    const CellGrid &fine = grids_[lvl];
+    const std::vector<size_t> &parents = parents_[lvl];
+    std::vector<size_t> &contributors = contributors_[lvl];
+    std::vector<double> &weights = weights_[lvl];
+    contributors.assign(fine.size() * NUM_CONTRIBUTORS, NO_CELL);
+    weights.assign(fine.size() * NUM_CONTRIBUTORS, 0.0);
+    const auto extent = static_cast<std::ptrdiff_t>(size_t{1} << (lvl - 1));
+
+    parallel::forEach(fine.size(), [&](size_t cell) {
+      const size_t parent = parents[cell];
+      if (parent == NO_CELL) {
+        return;
+      }
+      const auto coords = fine.mortonIndices()[cell].gridCoordinates();
+      const size_t first = cell * NUM_CONTRIBUTORS;
+      contributors[first] = parent;
+      weights[first] = 27.0 / 64.0;
+      for (size_t a = 1; a < NUM_CONTRIBUTORS; ++a) {
+        SignedGridCoordinates goal;
+        double weight = 27.0 / 64.0;
+        bool inside = true;
+        for (size_t axis = 0; axis < 3; ++axis) {
+          goal[axis] = static_cast<std::ptrdiff_t>(coords[axis] / 2);
+          if (((a >> axis) & 1U) != 0) {
+            goal[axis] += (coords[axis] & 1U) != 0 ? 1 : -1;
+            weight /= 3.0;
+            inside = inside && goal[axis] >= 0 && goal[axis] < extent;
+          }
+        }
+        const size_t contributor =
+            inside ? cellOf(coarse, MortonIndex::fromGridCoordinates(
+                                        lvl - 1, UnsignedGridCoordinates(goal)))
+                   : NO_CELL;
+        if (contributor == NO_CELL) {
+          weights[first] += weight;
+          contributors[first + a] = parent;
+        } else {
+          weights[first + a] = weight;
+          contributors[first + a] = contributor;
+        }
+      }
+    });
+  }
+}
+
+} // namespace oktal
@@ -123,36 +123,28 @@ MortonIndex::operator<=(const MortonIndex &other) const noexcept {
 }
 
 [[nodiscard]] UnsignedGridCoordinates MortonIndex::gridCoordinates() const {
-  if (isRoot()) {
-    return {};
+  // Every level contributes one bit per axis, starting with the finest level
+  UnsignedGridCoordinates coordinates{};
+  const size_t depth = level();
+  for (size_t lvl = 0; lvl < depth; ++lvl) {
+    const morton_bits_t localIndex = bits >> (3 * lvl);
+    coordinates[0] |= (localIndex & 1uz) << lvl;
+    coordinates[1] |= ((localIndex >> 1) & 1uz) << lvl;
+    coordinates[2] |= ((localIndex >> 2) & 1uz) << lvl;
   }
-
-  const UnsignedGridCoordinates parentCoordinates = parent().gridCoordinates();
-  const auto localIndex = siblingIndex();
-  const UnsignedGridCoordinates localCoordinates{
-      (localIndex & 1) == 1 ? 1uz : 0uz, (localIndex & 2) == 2 ? 1uz : 0uz,
-      (localIndex & 4) == 4 ? 1uz : 0uz};
-
-  return UnsignedGridCoordinates{parentCoordinates[0] << 1,
-                                 parentCoordinates[1] << 1,
-                                 parentCoordinates[2] << 1} +
-         localCoordinates;
+  return coordinates;
 }
 
 [[nodiscard]] MortonIndex
 MortonIndex::fromGridCoordinates(const size_t &refinementLevel,
                                  const UnsignedGridCoordinates &coordinates) {
-  if (refinementLevel == 0uz) {
-    return {};
+  morton_bits_t bits = 1;
+  for (size_t lvl = refinementLevel; lvl > 0; --lvl) {
+    const size_t shift = lvl - 1;
+    bits = (bits << 3) | (((coordinates[2] >> shift) & 1uz) << 2) |
+           (((coordinates[1] >> shift) & 1uz) << 1) |
+           ((coordinates[0] >> shift) & 1uz);
   }
-  const std::array<size_t, 3> vc{coordinates[0], coordinates[1],
-                                 coordinates[2]};
-
-  const MortonIndex parent = fromGridCoordinates(
-      refinementLevel - 1, {vc[0] >> 1, vc[1] >> 1, vc[2] >> 1});
-  const morton_bits_t localIndex =
-      ((vc[2] & 1uz) << 2) | ((vc[1] & 1uz) << 1) | (vc[0] & 1uz);
-
-  return parent.child(localIndex);
+  return {bits};
 }
 }; // namespace oktal
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "oktal/octree/Partition.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+
+namespace oktal {
+
+std::size_t CellGridPartition::partOf(std::size_t enumIdx) const {
+  const auto it = std::ranges::upper_bound(parts, enumIdx, {},
+                                           &EnumerationRange::begin);
+  return static_cast<std::size_t>(it - parts.begin()) - 1;
+}
+
+double CellGridPartition::maxSurfaceToVolume() const {
+  if (surfaceToVolume.empty()) {
+    return 0.0;
+  }
+  return std::ranges::max(surfaceToVolume);
+}
+
+CellGridPartition partition(const CellGrid &grid,
+                            std::span<const double> weights,
+                            std::size_t numParts) {
+  if (weights.size() != grid.size()) {
+    throw std::invalid_argument(
+        std::format("Expected {} cell weights, but {} were passed!",
+                    grid.size(), weights.size()));
+  }
+  if (numParts == 0) {
+    throw std::invalid_argument("Cannot partition into zero parts!");
+  }
+  // The split search needs a non-decreasing prefix sum
+  const auto invalid = std::ranges::find_if(weights, [](double weight) {
+    return !std::isfinite(weight) || weight < 0.0;
+  });
+  if (invalid != weights.end()) {
+    throw std::invalid_argument(std::format(
+        "Cell weights must be finite and non-negative, but cell {} has {}!",
+        invalid - weights.begin(), *invalid));
+  }
+
+  const std::size_t numCells = grid.size();
+  std::vector<double> prefix(numCells);
+  parallel::inclusiveScan(weights, std::span{prefix});
+  const double total = prefix.empty() ? 0.0 : prefix.back();
+
+  // Accumulated weight in front of enumeration index i
+  auto weightBefore = [&prefix](std::size_t i) {
+    return i == 0 ? 0.0 : prefix[i - 1];
+  };
+
+  CellGridPartition result;
+  result.parts.reserve(numParts);
+  std::size_t begin = 0;
+  for (std::size_t part = 1; part <= numParts; ++part) {
+    std::size_t end = numCells;
+    if (part < numParts) {
+      const double target =
+          total * static_cast<double>(part) / static_cast<double>(numParts);
+      const auto it = std::ranges::lower_bound(prefix, target);
+      // Cut behind the first cell reaching the target, or in front of it if
+      // that is closer to an equal share
+      end = static_cast<std::size_t>(it - prefix.begin());
+      if (end < numCells &&
+          prefix[end] - target <= target - weightBefore(end)) {
+        ++end;
+      }
+      end = std::max(end, begin);
+    }
+    result.parts.push_back({begin, end});
+    result.partWeights.push_back(weightBefore(end) - weightBefore(begin));
+    begin = end;
+  }
+
+  const double meanWeight = total / static_cast<double>(numParts);
+  result.imbalance =
+      meanWeight > 0.0 ? std::ranges::max(result.partWeights) / meanWeight
+                       : 1.0;
+
+  // Count the adjacency slots that leave each part
+  const std::size_t numSlots = grid.adjacencyOffsets().size();
+  result.surfaceToVolume.assign(numParts, 0.0);
+  parallel::forEach(numParts, [&](std::size_t part) {
+    const EnumerationRange range = result.parts[part];
+    if (range.empty()) {
+      return;
+    }
+    std::size_t cut = 0;
+    for (std::size_t slot = 0; slot < numSlots; ++slot) {
+      for (std::size_t cell = range.begin; cell < range.end; ++cell) {
+        const std::size_t neighbor = grid.neighborIndex(slot, cell);
+        // Missing neighbors and ghost cells are not cut
+        if (neighbor < grid.size() && !range.contains(neighbor)) {
+          ++cut;
+        }
+      }
+    }
+    result.surfaceToVolume[part] =
+        static_cast<double>(cut) / static_cast<double>(range.size());
+  });
+
+  return result;
+}
+
+CellGridPartition partition(const CellGrid &grid, std::size_t numParts) {
+  const std::vector<double> weights(grid.size(), 1.0);
+  return partition(grid, weights, numParts);
+}
+
+} // namespace oktal
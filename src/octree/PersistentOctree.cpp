@@ -0,0 +1,173 @@
+#include "oktal/octree/PersistentOctree.hpp"
+#include <cstddef>
+#include <format>
+#include <mutex>
+#include <source_location>
+#include <stdexcept>
+
+namespace oktal {
+
+PersistentOctree::PersistentOctree(const CellOctree &octree)
+    : geometry_(octree.geometry()) {
+  const auto levelsInfo = octree.getLevels();
+  levels_.reserve(levelsInfo.size());
+
+  for (std::size_t level = 0; level < levelsInfo.size(); ++level) {
+    const std::size_t nextLevelStart =
+        levelsInfo[level].first + levelsInfo[level].second;
+    auto chunk = std::make_shared<LevelChunk>(octree.nodesStream(level).begin(),
+                                              octree.nodesStream(level).end());
+    for (Node &node : *chunk) {
+      if (node.isRefined()) {
+        node.setChildrenStartIndex(node.childrenStartIndex() - nextLevelStart);
+      }
+    }
+    levels_.push_back(std::move(chunk));
+  }
+}
+
+std::size_t PersistentOctree::numberOfNodes() const {
+  std::size_t sum = 0;
+  for (const auto &chunk : levels_) {
+    sum += chunk->size();
+  }
+  return sum;
+}
+
+PersistentOctree::LevelChunk &
+PersistentOctree::mutableLevel(std::size_t level) {
+  materialized_ = std::make_shared<Materialization>();
+
+  if (level == levels_.size()) {
+    levels_.push_back(std::make_shared<LevelChunk>());
+  }
+
+  auto &chunk = levels_.at(level);
+  if (chunk.use_count() > 1) {
+    chunk = std::make_shared<LevelChunk>(*chunk);
+  }
+  // The chunk is owned exclusively at this point
+  return const_cast<LevelChunk &>(*chunk); // NOLINT
+}
+
+std::size_t PersistentOctree::locate(const MortonIndex &m) const {
+  static const auto info = source_info(std::source_location::current());
+
+  std::size_t index = 0;
+  std::size_t level = 0;
+  for (const auto &choice : m.getPath()) {
+    const Node &node = levels_[level]->at(index);
+    if (!node.isRefined()) {
+      throw std::out_of_range(
+          std::format("{}: Node {:#o} does not exist", info, m.getBits()));
+    }
+    index = node.childIndex(static_cast<std::size_t>(choice));
+    ++level;
+  }
+  return index;
+}
+
+void PersistentOctree::refine(const MortonIndex &m) {
+  static const auto info = source_info(std::source_location::current());
+
+  const std::size_t index = locate(m);
+  const std::size_t level = m.level();
+  if ((*levels_[level])[index].isRefined()) {
+    throw std::logic_error(
+        std::format("{}: Node {:#o} is already refined", info, m.getBits()));
+  }
+
+  // The children are inserted behind the children of all refined nodes that
+  // precede the node in its level
+  LevelChunk &nodes = mutableLevel(level);
+  std::size_t childrenStart = 0;
+  for (std::size_t i = 0; i < index; ++i) {
+    if (nodes[i].isRefined()) {
+      childrenStart += 8;
+    }
+  }
+  for (std::size_t i = index + 1; i < nodes.size(); ++i) {
+    if (nodes[i].isRefined()) {
+      nodes[i].setChildrenStartIndex(nodes[i].childrenStartIndex() + 8);
+    }
+  }
+  nodes[index].setRefined(true);
+  nodes[index].setChildrenStartIndex(childrenStart);
+
+  LevelChunk &children = mutableLevel(level + 1);
+  children.insert(children.begin() + static_cast<std::ptrdiff_t>(childrenStart),
+                  8, Node{});
+}
+
+void PersistentOctree::coarsen(const MortonIndex &m) {
+  static const auto info = source_info(std::source_location::current());
+
+  const std::size_t index = locate(m);
+  const std::size_t level = m.level();
+  const Node node = (*levels_[level])[index];
+  if (!node.isRefined()) {
+    throw std::logic_error(
+        std::format("{}: Node {:#o} is not refined", info, m.getBits()));
+  }
+
+  const auto childrenStart =
+      static_cast<std::ptrdiff_t>(node.childrenStartIndex());
+  for (std::ptrdiff_t branch = 0; branch < 8; ++branch) {
+    if ((*levels_[level + 1])[static_cast<std::size_t>(childrenStart + branch)]
+            .isRefined()) {
+      throw std::logic_error(std::format(
+          "{}: Node {:#o} has refined children", info, m.getBits()));
+    }
+  }
+
+  LevelChunk &nodes = mutableLevel(level);
+  for (std::size_t i = index + 1; i < nodes.size(); ++i) {
+    if (nodes[i].isRefined()) {
+      nodes[i].setChildrenStartIndex(nodes[i].childrenStartIndex() - 8);
+    }
+  }
+  nodes[index].setRefined(false);
+  nodes[index].setChildrenStartIndex(0);
+
+  LevelChunk &children = mutableLevel(level + 1);
+  children.erase(children.begin() + childrenStart,
+                 children.begin() + childrenStart + 8);
+  if (children.empty()) {
+    levels_.pop_back();
+  }
+}
+
+void PersistentOctree::setPhantom(const MortonIndex &m, bool phantom) {
+  const std::size_t index = locate(m);
+  if ((*levels_[m.level()])[index].isPhantom() != phantom) {
+    mutableLevel(m.level())[index].setPhantom(phantom);
+  }
+}
+
+std::shared_ptr<const CellOctree> PersistentOctree::octree() const {
+  std::call_once(materialized_->once, [this]() { materialize(); });
+  return materialized_->octree;
+}
+
+void PersistentOctree::materialize() const {
+  std::vector<Node> nodes;
+  std::vector<std::pair<std::size_t, std::size_t>> levels;
+  nodes.reserve(numberOfNodes());
+  levels.reserve(levels_.size());
+
+  for (const auto &chunk : levels_) {
+    levels.emplace_back(nodes.size(), chunk->size());
+    const std::size_t nextLevelStart = nodes.size() + chunk->size();
+    for (Node node : *chunk) {
+      if (node.isRefined()) {
+        node.setChildrenStartIndex(node.childrenStartIndex() + nextLevelStart);
+      }
+      nodes.push_back(node);
+    }
+  }
+
+  materialized_->octree = std::make_shared<const CellOctree>(
+      std::move(nodes), std::move(levels), geometry_);
+}
+
+} // namespace oktal
@@ -0,0 +1,164 @@
+#include "oktal/solver/DenseStencil.hpp"
+#include "oktal/octree/CellOctree.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace oktal::solver {
+
+namespace {
+
+// Smallest number of cells a kernel hands to a thread
+constexpr std::size_t MIN_CELLS_PER_THREAD = 4096;
+
+void requireValues(std::size_t numValues, std::size_t extent) {
+  if (numValues < extent * extent * extent) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(
+        std::format("{}: Field holds {} values but the cube has {} cells.",
+                    sourceInfo, numValues, extent * extent * extent));
+  }
+}
+
+// Updates the cells [begin, end) of one row along x and returns the sum of
+// their squared residuals; the vector loops sum the neighbors in the same
+// order as the scalar remainder loop
+// NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
+double jacobiRow(const double *u, double *uNext, const double *f,
+                 double *residual, std::size_t begin, std::size_t end,
+                 std::size_t strideY, std::size_t strideZ, double h2) {
+  double sum = 0.0;
+  std::size_t i = begin;
+#if defined(__AVX512F__)
+  const __m512d h2s = _mm512_set1_pd(h2);
+  const __m512d sixes = _mm512_set1_pd(6.0);
+  __m512d sums = _mm512_setzero_pd();
+  for (; i + 8 <= end; i += 8) {
+    __m512d neighbors = _mm512_loadu_pd(u + i - 1);
+    neighbors = _mm512_add_pd(neighbors, _mm512_loadu_pd(u + i + 1));
+    neighbors = _mm512_add_pd(neighbors, _mm512_loadu_pd(u + i - strideY));
+    neighbors = _mm512_add_pd(neighbors, _mm512_loadu_pd(u + i + strideY));
+    neighbors = _mm512_add_pd(neighbors, _mm512_loadu_pd(u + i - strideZ));
+    neighbors = _mm512_add_pd(neighbors, _mm512_loadu_pd(u + i + strideZ));
+    const __m512d center = _mm512_loadu_pd(u + i);
+    const __m512d rhs = _mm512_loadu_pd(f + i);
+    _mm512_storeu_pd(
+        uNext + i,
+        _mm512_div_pd(_mm512_add_pd(_mm512_mul_pd(h2s, rhs), neighbors),
+                      sixes));
+    const __m512d r = _mm512_add_pd(
+        rhs, _mm512_div_pd(_mm512_sub_pd(neighbors,
+                                         _mm512_mul_pd(sixes, center)),
+                           h2s));
+    _mm512_storeu_pd(residual + i, r);
+    sums = _mm512_add_pd(sums, _mm512_mul_pd(r, r));
+  }
+  alignas(64) double lanes[8];
+  _mm512_store_pd(lanes, sums);
+  sum += ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+         ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+#elif defined(__AVX2__)
+  const __m256d h2s = _mm256_set1_pd(h2);
+  const __m256d sixes = _mm256_set1_pd(6.0);
+  __m256d sums = _mm256_setzero_pd();
+  for (; i + 4 <= end; i += 4) {
+    __m256d neighbors = _mm256_loadu_pd(u + i - 1);
+    neighbors = _mm256_add_pd(neighbors, _mm256_loadu_pd(u + i + 1));
+    neighbors = _mm256_add_pd(neighbors, _mm256_loadu_pd(u + i - strideY));
+    neighbors = _mm256_add_pd(neighbors, _mm256_loadu_pd(u + i + strideY));
+    neighbors = _mm256_add_pd(neighbors, _mm256_loadu_pd(u + i - strideZ));
+    neighbors = _mm256_add_pd(neighbors, _mm256_loadu_pd(u + i + strideZ));
+    const __m256d center = _mm256_loadu_pd(u + i);
+    const __m256d rhs = _mm256_loadu_pd(f + i);
+    _mm256_storeu_pd(
+        uNext + i,
+        _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(h2s, rhs), neighbors),
+                      sixes));
+    const __m256d r = _mm256_add_pd(
+        rhs, _mm256_div_pd(_mm256_sub_pd(neighbors,
+                                         _mm256_mul_pd(sixes, center)),
+                           h2s));
+    _mm256_storeu_pd(residual + i, r);
+    sums = _mm256_add_pd(sums, _mm256_mul_pd(r, r));
+  }
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, sums);
+  sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+  for (; i < end; ++i) {
+    double neighbors = u[i - 1];
+    neighbors += u[i + 1];
+    neighbors += u[i - strideY];
+    neighbors += u[i + strideY];
+    neighbors += u[i - strideZ];
+    neighbors += u[i + strideZ];
+    uNext[i] = (h2 * f[i] + neighbors) / 6.0;
+    residual[i] = f[i] + ((neighbors - 6.0 * u[i]) / h2);
+    sum += residual[i] * residual[i];
+  }
+  return sum;
+}
+
+} // namespace
+
+std::string_view denseKernelInstructionSet() {
+#if defined(__AVX512F__)
+  return "AVX-512";
+#elif defined(__AVX2__)
+  return "AVX2";
+#else
+  return "scalar";
+#endif
+}
+
+double denseJacobiSweep(std::size_t extent, double h, std::span<const double> u,
+                        std::span<double> uNext, std::span<const double> f,
+                        std::span<double> residual) {
+  requireValues(u.size(), extent);
+  requireValues(uNext.size(), extent);
+  requireValues(f.size(), extent);
+  requireValues(residual.size(), extent);
+  if (extent < 3) {
+    return 0.0;
+  }
+
+  const std::size_t strideY = extent;
+  const std::size_t strideZ = extent * extent;
+  const std::size_t inner = extent - 2;
+  const double h2 = h * h;
+  const std::size_t numThreads = std::min(
+      inner, parallel::threadsFor(inner * inner * inner, MIN_CELLS_PER_THREAD));
+  std::vector<double> partialSums(numThreads, 0.0);
+  parallel::forChunks(
+      inner,
+      [&](std::size_t begin, std::size_t end, std::size_t chunk) {
+        double sum = 0.0;
+        for (std::size_t z = begin + 1; z <= end; ++z) {
+          for (std::size_t y = 1; y + 1 < extent; ++y) {
+            const std::size_t row = (y * strideY) + (z * strideZ);
+            sum += jacobiRow(u.data(), uNext.data(), f.data(), residual.data(),
+                             row + 1, row + extent - 1, strideY, strideZ, h2);
+          }
+        }
+        partialSums[chunk] = sum;
+      },
+      numThreads);
+
+  double sum = 0.0;
+  for (const double partial : partialSums) {
+    sum += partial;
+  }
+  return sum;
+}
+
+} // namespace oktal::solver
@@ -0,0 +1,378 @@
+#include "oktal/solver/Krylov.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace oktal::solver {
+
+namespace {
+
+const std::array<AdjacencyOffset, PoissonOperator::NUM_FACES> FACES{{
+    {-1, 0, 0},
+    {1, 0, 0},
+    {0, -1, 0},
+    {0, 1, 0},
+    {0, 0, -1},
+    {0, 0, 1},
+}};
+
+// Smallest number of cells a kernel hands to a thread
+constexpr std::size_t MIN_CELLS_PER_THREAD = 4096;
+
+std::size_t threadsFor(std::size_t n) {
+  return parallel::threadsFor(n, MIN_CELLS_PER_THREAD);
+}
+
+// Calls func(begin, end) on contiguous chunks of [0, n) and sums the N
+// partial results it returns; the chunks are added in order, so the sums
+// only depend on the number of threads
+template <std::size_t N, typename TFunc>
+std::array<double, N> reduce(std::size_t n, TFunc &&func) {
+  const std::size_t numThreads = threadsFor(n);
+  std::vector<std::array<double, N>> partial(numThreads);
+  parallel::forChunks(
+      n,
+      [&](std::size_t begin, std::size_t end, std::size_t chunk) {
+        partial[chunk] = func(begin, end);
+      },
+      numThreads);
+  std::array<double, N> total{};
+  for (const auto &sums : partial) {
+    for (std::size_t i = 0; i < N; ++i) {
+      total[i] += sums[i];
+    }
+  }
+  return total;
+}
+
+double dot(std::span<const double> a, std::span<const double> b) {
+  return reduce<1>(a.size(), [&](std::size_t begin, std::size_t end) {
+    double sum = 0.0;
+    for (std::size_t i = begin; i < end; ++i) {
+      sum += a[i] * b[i];
+    }
+    return std::array{sum};
+  })[0];
+}
+
+void requireCells(const PoissonOperator &op, std::size_t fieldSize) {
+  if (fieldSize < op.size()) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(
+        std::format("{}: Field holds {} values but the grid has {} cells.",
+                    sourceInfo, fieldSize, op.size()));
+  }
+}
+
+} // namespace
+
+// -------------------------------------------------------------------------
+// Poisson Operator
+// -------------------------------------------------------------------------
+PoissonOperator::PoissonOperator(const CellGrid &grid) : grid_(&grid) {
+  for (std::size_t face = 0; face < NUM_FACES; ++face) {
+    neighbors_[face] = grid.neighborIndices(FACES[face]);
+  }
+  const auto mortonIndices = grid.mortonIndices();
+  const std::size_t level =
+      mortonIndices.empty() ? 0 : mortonIndices.front().level();
+  if (!mortonIndices.empty() && mortonIndices.back().level() != level) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(std::format(
+        "{}: The Poisson operator needs the cells of a single level.",
+        sourceInfo));
+  }
+  const double h = grid.octree().geometry().dx(level);
+  inverseH2_ = 1.0 / (h * h);
+
+  unknown_.resize(grid.size());
+  for (std::size_t cell = 0; cell < grid.size(); ++cell) {
+    // Ghost cells count as missing neighbors
+    const bool complete =
+        std::ranges::all_of(neighbors_, [&](const auto &list) {
+          return list[cell] < grid.size();
+        });
+    unknown_[cell] = complete ? 1 : 0;
+  }
+}
+
+double PoissonOperator::apply(std::span<const double> x,
+                              std::span<double> y) const {
+  requireCells(*this, x.size());
+  requireCells(*this, y.size());
+  return reduce<1>(size(), [&](std::size_t begin, std::size_t end) {
+    double xy = 0.0;
+    for (std::size_t cell = begin; cell < end; ++cell) {
+      if (unknown_[cell] == 0) {
+        y[cell] = 0.0;
+        continue;
+      }
+      double neighborSum = 0.0;
+      for (const auto &neighbors : neighbors_) {
+        neighborSum += x[neighbors[cell]];
+      }
+      y[cell] = (6.0 * x[cell] - neighborSum) * inverseH2_;
+      xy += x[cell] * y[cell];
+    }
+    return std::array{xy};
+  })[0];
+}
+
+double PoissonOperator::residual(std::span<const double> u,
+                                 std::span<const double> f,
+                                 std::span<double> r) const {
+  requireCells(*this, u.size());
+  requireCells(*this, f.size());
+  requireCells(*this, r.size());
+  return reduce<1>(size(), [&](std::size_t begin, std::size_t end) {
+    double rr = 0.0;
+    for (std::size_t cell = begin; cell < end; ++cell) {
+      if (unknown_[cell] == 0) {
+        r[cell] = 0.0;
+        continue;
+      }
+      double neighborSum = 0.0;
+      for (const auto &neighbors : neighbors_) {
+        neighborSum += u[neighbors[cell]];
+      }
+      r[cell] = f[cell] - (6.0 * u[cell] - neighborSum) * inverseH2_;
+      rr += r[cell] * r[cell];
+    }
+    return std::array{rr};
+  })[0];
+}
+
+// -------------------------------------------------------------------------
+// Preconditioners
+// -------------------------------------------------------------------------
+void IdentityPreconditioner::apply(std::span<const double> r,
+                                   std::span<double> z) {
+  std::ranges::copy(r, z.begin());
+}
+
+void JacobiPreconditioner::apply(std::span<const double> r,
+                                 std::span<double> z) {
+  const double inverseDiagonal = 1.0 / (6.0 * op_->inverseH2());
+  parallel::forChunks(
+      op_->size(),
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t cell = begin; cell < end; ++cell) {
+          z[cell] = inverseDiagonal * r[cell];
+        }
+      },
+      threadsFor(op_->size()));
+}
+
+SsorPreconditioner::SsorPreconditioner(const PoissonOperator &op,
+                                       double omega)
+    : op_(&op), omega_(omega) {
+  const CellGrid &grid = op.grid();
+  const auto neighbors = op.neighbors();
+  const auto isUnknown = [&](std::size_t cell) {
+    return std::ranges::all_of(neighbors, [&](const auto &list) {
+      return list[cell] < grid.size();
+    });
+  };
+  const CellColoring coloring = grid.coloring();
+  colors_.resize(coloring.numberOfColors());
+  for (std::size_t color = 0; color < coloring.numberOfColors(); ++color) {
+    std::ranges::copy_if(coloring.cellsOf(color),
+                         std::back_inserter(colors_[color]), isUnknown);
+  }
+}
+
+void SsorPreconditioner::apply(std::span<const double> r,
+                               std::span<double> z) {
+  std::fill_n(z.begin(), op_->size(), 0.0);
+  for (const auto &cells : colors_) {
+    sweep(cells, r, z);
+  }
+  for (auto it = colors_.rbegin(); it != colors_.rend(); ++it) {
+    sweep(*it, r, z);
+  }
+}
+
+void SsorPreconditioner::sweep(const std::vector<std::size_t> &cells,
+                               std::span<const double> r,
+                               std::span<double> z) const {
+  const double h2 = 1.0 / op_->inverseH2();
+  const auto neighbors = op_->neighbors();
+  parallel::forChunks(
+      cells.size(),
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const std::size_t cell = cells[i];
+          double neighborSum = 0.0;
+          for (const auto &list : neighbors) {
+            neighborSum += z[list[cell]];
+          }
+          z[cell] = (1.0 - omega_) * z[cell] +
+                    omega_ * (h2 * r[cell] + neighborSum) / 6.0;
+        }
+      },
+      threadsFor(cells.size()));
+}
+
+void MultigridPreconditioner::apply(std::span<const double> r,
+                                    std::span<double> z) {
+  std::ranges::fill(z, 0.0);
+  multigrid_->cycle(z, r);
+}
+
+// -------------------------------------------------------------------------
+// Krylov Solvers
+// -------------------------------------------------------------------------
+KrylovResult conjugateGradient(const PoissonOperator &op, std::span<double> u,
+                               std::span<const double> f,
+                               Preconditioner &preconditioner,
+                               const KrylovOptions &options) {
+  const std::size_t n = op.size();
+  std::vector<double> r(n);
+  std::vector<double> z(n);
+  std::vector<double> p(n);
+  std::vector<double> q(n);
+
+  double rr = op.residual(u, f, r);
+  if (std::sqrt(rr) <= options.tolerance) {
+    return {0, std::sqrt(rr), true};
+  }
+  preconditioner.apply(r, z);
+  double rz = dot(r, z);
+  std::ranges::copy(z, p.begin());
+
+  for (std::size_t iteration = 1; iteration <= options.maxIterations;
+       ++iteration) {
+    const double alpha = rz / op.apply(p, q);
+    rr = reduce<1>(n, [&](std::size_t begin, std::size_t end) {
+      double sum = 0.0;
+      for (std::size_t i = begin; i < end; ++i) {
+        u[i] += alpha * p[i];
+        r[i] -= alpha * q[i];
+        sum += r[i] * r[i];
+      }
+      return std::array{sum};
+    })[0];
+    if (std::sqrt(rr) <= options.tolerance) {
+      return {iteration, std::sqrt(rr), true};
+    }
+
+    preconditioner.apply(r, z);
+    const double rzNext = dot(r, z);
+    const double beta = rzNext / rz;
+    rz = rzNext;
+    parallel::forChunks(
+        n,
+        [&](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t i = begin; i < end; ++i) {
+            p[i] = z[i] + beta * p[i];
+          }
+        },
+        threadsFor(n));
+  }
+  return {options.maxIterations, std::sqrt(rr), false};
+}
+
+KrylovResult biCgStab(const PoissonOperator &op, std::span<double> u,
+                      std::span<const double> f,
+                      Preconditioner &preconditioner,
+                      const KrylovOptions &options) {
+  const std::size_t n = op.size();
+  std::vector<double> r(n);
+  double rr = op.residual(u, f, r);
+  if (std::sqrt(rr) <= options.tolerance) {
+    return {0, std::sqrt(rr), true};
+  }
+  const std::vector<double> rHat = r;
+  std::vector<double> p(n, 0.0);
+  std::vector<double> v(n, 0.0);
+  std::vector<double> pHat(n);
+  std::vector<double> s(n);
+  std::vector<double> sHat(n);
+  std::vector<double> t(n);
+  double rho = 1.0;
+  double alpha = 1.0;
+  double omega = 1.0;
+  double rHatR = rr;
+
+  for (std::size_t iteration = 1; iteration <= options.maxIterations;
+       ++iteration) {
+    // Breakdown, the shadow residual became orthogonal to the residual
+    if (rHatR == 0.0 || omega == 0.0) {
+      return {iteration - 1, std::sqrt(rr), false};
+    }
+    const double beta = (rHatR / rho) * (alpha / omega);
+    rho = rHatR;
+    parallel::forChunks(
+        n,
+        [&](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t i = begin; i < end; ++i) {
+            p[i] = r[i] + beta * (p[i] - omega * v[i]);
+          }
+        },
+        threadsFor(n));
+
+    preconditioner.apply(p, pHat);
+    static_cast<void>(op.apply(pHat, v));
+    alpha = rho / dot(rHat, v);
+    const double ss = reduce<1>(n, [&](std::size_t begin, std::size_t end) {
+      double sum = 0.0;
+      for (std::size_t i = begin; i < end; ++i) {
+        s[i] = r[i] - alpha * v[i];
+        sum += s[i] * s[i];
+      }
+      return std::array{sum};
+    })[0];
+    if (std::sqrt(ss) <= options.tolerance) {
+      parallel::forChunks(
+          n,
+          [&](std::size_t begin, std::size_t end, std::size_t) {
+            for (std::size_t i = begin; i < end; ++i) {
+              u[i] += alpha * pHat[i];
+            }
+          },
+          threadsFor(n));
+      return {iteration, std::sqrt(ss), true};
+    }
+
+    preconditioner.apply(s, sHat);
+    static_cast<void>(op.apply(sHat, t));
+    const auto [ts, tt] =
+        reduce<2>(n, [&](std::size_t begin, std::size_t end) {
+          std::array<double, 2> sums{};
+          for (std::size_t i = begin; i < end; ++i) {
+            sums[0] += t[i] * s[i];
+            sums[1] += t[i] * t[i];
+          }
+          return sums;
+        });
+    omega = ts / tt;
+    const auto [rrNext, rHatRNext] =
+        reduce<2>(n, [&](std::size_t begin, std::size_t end) {
+          std::array<double, 2> sums{};
+          for (std::size_t i = begin; i < end; ++i) {
+            u[i] += alpha * pHat[i] + omega * sHat[i];
+            r[i] = s[i] - omega * t[i];
+            sums[0] += r[i] * r[i];
+            sums[1] += rHat[i] * r[i];
+          }
+          return sums;
+        });
+    rr = rrNext;
+    rHatR = rHatRNext;
+    if (std::sqrt(rr) <= options.tolerance) {
+      return {iteration, std::sqrt(rr), true};
+    }
+  }
+  return {options.maxIterations, std::sqrt(rr), false};
+}
+
+} // namespace oktal::solver
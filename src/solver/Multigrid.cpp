@@ -0,0 +1,254 @@
+#include "oktal/solver/Multigrid.hpp"
+#include "oktal/util/Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace oktal::solver {
+
+namespace {
+
+const std::array<AdjacencyOffset, PoissonMultigrid::NUM_FACES> FACES{{
+    {-1, 0, 0},
+    {1, 0, 0},
+    {0, -1, 0},
+    {0, 1, 0},
+    {0, 0, -1},
+    {0, 0, 1},
+}};
+
+// Smallest number of cells a kernel hands to a thread
+constexpr std::size_t MIN_CELLS_PER_THREAD = 4096;
+
+// Adds the wall-clock time of its lifetime to a level
+class LevelTimer {
+public:
+  explicit LevelTimer(double &seconds)
+      : seconds_(seconds), start_(Clock::now()) {}
+  LevelTimer(const LevelTimer &) = delete;
+  LevelTimer(LevelTimer &&) = delete;
+  LevelTimer &operator=(const LevelTimer &) = delete;
+  LevelTimer &operator=(LevelTimer &&) = delete;
+
+  ~LevelTimer() {
+    const std::chrono::duration<double> elapsed = Clock::now() - start_;
+    seconds_ += elapsed.count();
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  double &seconds_;
+  Clock::time_point start_;
+};
+
+void requireCells(std::size_t fieldSize, std::size_t numCells) {
+  if (fieldSize < numCells) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(
+        std::format("{}: Field holds {} values but the finest grid has {} "
+                    "cells.",
+                    sourceInfo, fieldSize, numCells));
+  }
+}
+
+} // namespace
+
+PoissonMultigrid::PoissonMultigrid(const GridHierarchy &hierarchy,
+                                   MultigridOptions options)
+    : hierarchy_(&hierarchy), options_(options),
+      seconds_(hierarchy.numberOfLevels(), 0.0) {
+  const auto &geometry = hierarchy.octree().geometry();
+  const std::size_t finest = hierarchy.numberOfLevels() - 1;
+  for (std::size_t lvl = 0; lvl <= finest; ++lvl) {
+    const CellGrid &grid = hierarchy.grid(lvl);
+    const std::size_t numCells = grid.size();
+    const double h = geometry.dx(lvl);
+    Level level;
+    level.lvl = lvl;
+    level.inverseH2 = 1.0 / (h * h);
+
+    // The correction vanishes at distance (h - hFinest) / 2 from the cell
+    // center, so a ghost at distance h holds -(h / distance - 1) times the
+    // cell value; the finest level has no ghosts
+    const double ghostWeight =
+        lvl == finest ? 0.0 : (2.0 * h / (h - geometry.dx(finest))) - 1.0;
+    level.diagonal.assign(numCells, 6.0);
+    std::vector<bool> complete(numCells, true);
+    for (std::size_t face = 0; face < NUM_FACES; ++face) {
+      const AdjacencyListView neighbors = grid.neighborIndices(FACES[face]);
+      level.neighbors[face].assign(neighbors.begin(),
+                                   neighbors.begin() +
+                                       static_cast<std::ptrdiff_t>(numCells));
+      for (std::size_t cell = 0; cell < numCells; ++cell) {
+        // Ghost cells of the grid count as missing neighbors
+        if (neighbors[cell] >= numCells) {
+          level.neighbors[face][cell] = numCells;
+          level.diagonal[cell] += ghostWeight;
+          complete[cell] = false;
+        }
+      }
+    }
+
+    const auto isUnknown = [&](std::size_t cell) {
+      return lvl != finest || complete[cell];
+    };
+    for (std::size_t cell = 0; cell < numCells; ++cell) {
+      if (isUnknown(cell)) {
+        level.unknowns.push_back(cell);
+      }
+    }
+    const CellColoring coloring = grid.coloring();
+    level.colors.resize(coloring.numberOfColors());
+    for (std::size_t color = 0; color < coloring.numberOfColors(); ++color) {
+      std::ranges::copy_if(coloring.cellsOf(color),
+                           std::back_inserter(level.colors[color]),
+                           isUnknown);
+    }
+    level.r.assign(numCells, 0.0);
+    level.correction.assign(numCells, 0.0);
+    if (lvl != finest) {
+      level.u.assign(numCells + 1, 0.0);
+      level.f.assign(numCells, 0.0);
+    }
+    levels_.push_back(std::move(level));
+  }
+  if (levels_.back().unknowns.empty()) {
+    const auto sourceInfo = source_info(std::source_location::current());
+    throw std::invalid_argument(std::format(
+        "{}: No cell of the finest level has all face neighbors.",
+        sourceInfo));
+  }
+}
+
+void PoissonMultigrid::cycle(std::span<double> u, std::span<const double> f) {
+  const std::size_t numCells = hierarchy_->grid(finestLevel()).size();
+  requireCells(u.size(), numCells);
+  requireCells(f.size(), numCells);
+  cycleOn(levels_.size() - 1, u, f, options_.cycle);
+}
+
+double PoissonMultigrid::residual(std::span<const double> u,
+                                  std::span<const double> f,
+                                  std::span<double> residual) const {
+  const std::size_t numCells = hierarchy_->grid(finestLevel()).size();
+  requireCells(u.size(), numCells);
+  requireCells(f.size(), numCells);
+  requireCells(residual.size(), numCells);
+  computeResidual(levels_.back(), u, f, residual);
+  double sum = 0.0;
+  for (std::size_t cell = 0; cell < numCells; ++cell) {
+    sum += residual[cell] * residual[cell];
+  }
+  return std::sqrt(sum);
+}
+
+void PoissonMultigrid::cycleOn(std::size_t index, std::span<double> u,
+                               std::span<const double> f, Cycle type) {
+  Level &level = levels_[index];
+  if (index == 0) {
+    const LevelTimer timer(seconds_[level.lvl]);
+    // Alternating directions make pairs of sweeps symmetric
+    for (std::size_t sweep = 0; sweep < options_.coarseSweeps; ++sweep) {
+      smooth(level, u, f, 1,
+             sweep % 2 == 0 ? SweepOrder::Forward : SweepOrder::Backward);
+    }
+    return;
+  }
+
+  Level &coarse = levels_[index - 1];
+  {
+    const LevelTimer timer(seconds_[level.lvl]);
+    smooth(level, u, f, options_.preSmoothing, SweepOrder::Forward);
+    computeResidual(level, u, f, level.r);
+    hierarchy_->restrictField<double>(level.lvl, level.r, coarse.f);
+    std::ranges::fill(coarse.u, 0.0);
+  }
+
+  switch (type) {
+  case Cycle::V:
+    cycleOn(index - 1, coarse.u, coarse.f, Cycle::V);
+    break;
+  case Cycle::W:
+    cycleOn(index - 1, coarse.u, coarse.f, Cycle::W);
+    cycleOn(index - 1, coarse.u, coarse.f, Cycle::W);
+    break;
+  case Cycle::F:
+    cycleOn(index - 1, coarse.u, coarse.f, Cycle::F);
+    cycleOn(index - 1, coarse.u, coarse.f, Cycle::V);
+    break;
+  }
+
+  const LevelTimer timer(seconds_[level.lvl]);
+  hierarchy_->prolongate<double>(level.lvl, coarse.u, level.correction,
+                                 options_.prolongation);
+  // Dirichlet cells keep their values
+  const std::span<const std::size_t> unknowns = level.unknowns;
+  parallel::forChunks(
+      unknowns.size(),
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          u[unknowns[i]] += level.correction[unknowns[i]];
+        }
+      },
+      parallel::threadsFor(unknowns.size(), MIN_CELLS_PER_THREAD));
+  smooth(level, u, f, options_.postSmoothing, SweepOrder::Backward);
+}
+
+void PoissonMultigrid::smooth(const Level &level, std::span<double> u,
+                              std::span<const double> f, std::size_t sweeps,
+                              SweepOrder order) const {
+  const double h2 = 1.0 / level.inverseH2;
+  const std::size_t numColors = level.colors.size();
+  for (std::size_t sweep = 0; sweep < sweeps; ++sweep) {
+    // Cells of one color only depend on cells of the other colors
+    for (std::size_t k = 0; k < numColors; ++k) {
+      const auto &cells =
+          level.colors[order == SweepOrder::Forward ? k : numColors - 1 - k];
+      parallel::forChunks(
+          cells.size(),
+          [&](std::size_t begin, std::size_t end, std::size_t) {
+            for (std::size_t i = begin; i < end; ++i) {
+              const std::size_t cell = cells[i];
+              double neighborSum = 0.0;
+              for (const auto &neighbors : level.neighbors) {
+                neighborSum += u[neighbors[cell]];
+              }
+              u[cell] = (h2 * f[cell] + neighborSum) / level.diagonal[cell];
+            }
+          },
+          parallel::threadsFor(cells.size(), MIN_CELLS_PER_THREAD));
+    }
+  }
+}
+
+void PoissonMultigrid::computeResidual(const Level &level,
+                                       std::span<const double> u,
+                                       std::span<const double> f,
+                                       std::span<double> residual) const {
+  std::ranges::fill(residual.first(hierarchy_->grid(level.lvl).size()), 0.0);
+  const std::span<const std::size_t> unknowns = level.unknowns;
+  parallel::forChunks(
+      unknowns.size(),
+      [&](std::size_t begin, std::size_t end, std::size_t) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const std::size_t cell = unknowns[i];
+          double neighborSum = 0.0;
+          for (const auto &neighbors : level.neighbors) {
+            neighborSum += u[neighbors[cell]];
+          }
+          residual[cell] =
+              f[cell] +
+              (neighborSum - level.diagonal[cell] * u[cell]) * level.inverseH2;
+        }
+      },
+      parallel::threadsFor(unknowns.size(), MIN_CELLS_PER_THREAD));
+}
+
+} // namespace oktal::solver
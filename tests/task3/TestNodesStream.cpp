@@ -1,8 +1,15 @@
 #include "advpt/testing/Testutils.hpp"
 
 #include "oktal/octree/CellOctree.hpp"
+#include "oktal/octree/PersistentOctree.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <ranges>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #define TEST_NODE true
 #define TEST_NODES_STREAM true
@@ -254,6 +261,270 @@ void testInvalidDescriptors() {
 #endif
 }
 
+void testNonPhantomRank() {
+#if TEST_NODES_STREAM
+  {
+    const CellOctree ot = CellOctree::fromDescriptor(
+        "X|XXXXPPPP|...PPPPP..P.PPPP.P..PPPP.P.PPPPP");
+
+    advpt::testing::assert_equal(ot.numberOfNonPhantomNodes(0uz), 0uz);
+    advpt::testing::assert_equal(ot.numberOfNonPhantomNodes(1uz), 0uz);
+    advpt::testing::assert_equal(ot.numberOfNonPhantomNodes(2uz), 11uz);
+    advpt::testing::assert_equal(ot.numberOfNonPhantomNodes(3uz), 0uz);
+    advpt::testing::assert_equal(ot.numberOfNonPhantomNodes(), 11uz);
+
+    advpt::testing::assert_equal(ot.levelOf(0uz), 0uz);
+    advpt::testing::assert_equal(ot.levelOf(8uz), 1uz);
+    advpt::testing::assert_equal(ot.levelOf(9uz), 2uz);
+    advpt::testing::assert_equal(ot.levelOf(40uz), 2uz);
+    advpt::testing::assert_equal(ot.levelOf(41uz), ot.numberOfLevels());
+
+    size_t expected = 0;
+    for (auto idx : std::views::iota(0uz, ot.numberOfNodes())) {
+      advpt::testing::assert_equal(ot.nonPhantomRank(idx), expected);
+      expected += ot.nodesStream()[idx].isPhantom() ? 0uz : 1uz;
+    }
+    advpt::testing::assert_equal(ot.nonPhantomRank(ot.numberOfNodes()),
+                                 expected);
+  }
+
+  {
+    // Spans several 64-bit blocks of the rank structure
+    const auto ot = CellOctree::createUniformGrid(3uz);
+    advpt::testing::assert_equal(ot->numberOfNonPhantomNodes(), 512uz);
+    advpt::testing::assert_equal(ot->numberOfNonPhantomNodes(2uz), 0uz);
+    advpt::testing::assert_equal(ot->numberOfNonPhantomNodes(3uz), 512uz);
+    for (auto idx : std::views::iota(0uz, 512uz)) {
+      advpt::testing::assert_equal(ot->nonPhantomRank(73uz + idx), idx);
+    }
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testParentIndex() {
+#if TEST_NODES_STREAM
+  auto expectParents = [](const CellOctree &ot) {
+    advpt::testing::assert_equal(ot.parentIndex(0uz),
+                                 CellOctree::NO_STREAM_INDEX);
+    advpt::testing::assert_true(ot.mortonIndexOf(0uz).isRoot());
+    for (auto idx : std::views::iota(0uz, ot.numberOfNodes())) {
+      const auto &node = ot.nodesStream()[idx];
+      if (!node.isRefined()) {
+        continue;
+      }
+      for (auto branch : std::views::iota(0uz, 8uz)) {
+        const size_t child = node.childIndex(branch);
+        advpt::testing::assert_equal(ot.parentIndex(child), idx);
+        advpt::testing::assert_true(ot.mortonIndexOf(child) ==
+                                    ot.mortonIndexOf(idx).child(branch));
+      }
+    }
+  };
+  expectParents(CellOctree::fromDescriptor(
+      "X|XXXXPPPP|...PPPPP..P.PPPP.P..PPPP.P.PPPPP"));
+  expectParents(CellOctree::fromDescriptor(
+      "R|R.R.R.R.|........................PPPPPPPX|........"));
+  // Spans several 64-bit blocks of the rank structure
+  expectParents(*CellOctree::createUniformGrid(3uz));
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testCompact() {
+#if TEST_NODES_STREAM
+  {
+    CellOctree ot = CellOctree::fromDescriptor("R|XP......|PPPPPPPP");
+    const auto remap = ot.compact();
+
+    advpt::testing::assert_equal(ot.numberOfNodes(), 9uz);
+    advpt::testing::assert_equal(ot.numberOfLevels(), 2uz);
+    advpt::testing::assert_false(ot.nodesStream(1uz)[0].isRefined());
+    advpt::testing::assert_true(ot.nodesStream(1uz)[0].isPhantom());
+
+    advpt::testing::assert_equal(remap.size(), 17uz);
+    for (auto idx : std::views::iota(0uz, 9uz)) {
+      advpt::testing::assert_equal(remap[idx], idx);
+    }
+    for (auto idx : std::views::iota(9uz, 17uz)) {
+      advpt::testing::assert_equal(remap[idx], CellOctree::NO_STREAM_INDEX);
+    }
+  }
+
+  {
+    CellOctree ot = CellOctree::fromDescriptor("R|X.R.....|PPPPPPPP........");
+    const auto remap = ot.compact();
+
+    advpt::testing::assert_equal(ot.numberOfNodes(), 17uz);
+    advpt::testing::assert_equal(ot.numberOfNodes(2uz), 8uz);
+    advpt::testing::assert_equal(ot.numberOfNonPhantomNodes(), 16uz);
+    advpt::testing::assert_true(ot.nodesStream()[3].isRefined());
+    advpt::testing::assert_equal(ot.nodesStream()[3].childrenStartIndex(),
+                                 9uz);
+    advpt::testing::assert_equal(remap[9], CellOctree::NO_STREAM_INDEX);
+    advpt::testing::assert_equal(remap[17], 9uz);
+    advpt::testing::assert_equal(remap[24], 16uz);
+  }
+
+  {
+    // Nothing to drop: phantoms with non-phantom descendants are kept
+    CellOctree ot = CellOctree::fromDescriptor(
+        "X|XXXXPPPP|...PPPPP..P.PPPP.P..PPPP.P.PPPPP");
+    const auto remap = ot.compact();
+
+    advpt::testing::assert_equal(ot.numberOfNodes(), 41uz);
+    advpt::testing::assert_range_equal(remap, std::views::iota(0uz, 41uz));
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testBooleanOperations() {
+#if TEST_NODES_STREAM
+  // Compares two trees node by node
+  auto assertSameTree = [](const CellOctree &actual,
+                           const CellOctree &expected) {
+    advpt::testing::assert_range_equal(
+        actual.getLevels() | std::views::transform([](auto level) {
+          return level.second;
+        }),
+        expected.getLevels() | std::views::transform([](auto level) {
+          return level.second;
+        }));
+    auto flags = std::views::transform([](const CellOctree::Node &node) {
+      return std::tuple{node.isRefined(), node.isPhantom(),
+                        node.isRefined() ? node.childrenStartIndex() : 0uz};
+    });
+    advpt::testing::assert_true(
+        std::ranges::equal(actual.nodesStream() | flags,
+                           expected.nodesStream() | flags));
+  };
+
+  const auto a = CellOctree::fromDescriptor("R|R.......|........");
+  const auto b = CellOctree::fromDescriptor("R|.......R|........");
+
+  assertSameTree(CellOctree::unite(a, b),
+                 CellOctree::fromDescriptor("R|R......R|................"));
+  assertSameTree(CellOctree::intersect(a, b),
+                 CellOctree::fromDescriptor("R|........"));
+  assertSameTree(CellOctree::subtract(a, b), a);
+  assertSameTree(CellOctree::subtract(a, a), CellOctree::fromDescriptor("."));
+  assertSameTree(CellOctree::subtract(CellOctree::unite(a, b), a), b);
+
+  // Operands are extended below their leaves
+  assertSameTree(CellOctree::unite(a, CellOctree{}), a);
+  assertSameTree(CellOctree::intersect(a, CellOctree{}), CellOctree{});
+
+  // Phantoms
+  const auto c = CellOctree::fromDescriptor("X|PP......");
+  const auto d = CellOctree::fromDescriptor("P");
+  assertSameTree(CellOctree::unite(c, d),
+                 CellOctree::fromDescriptor("X|PP......"));
+  assertSameTree(CellOctree::unite(c, a), a);
+  assertSameTree(CellOctree::intersect(c, a),
+                 CellOctree::fromDescriptor("X|PP......"));
+  assertSameTree(CellOctree::intersect(a, d),
+                 CellOctree::fromDescriptor("P"));
+
+  // Coarsened phantoms cover their former leaves
+  const auto e = CellOctree::fromDescriptor("X|........");
+  assertSameTree(CellOctree::subtract(e, e), CellOctree::fromDescriptor("."));
+  assertSameTree(CellOctree::subtract(c, c), CellOctree::fromDescriptor("."));
+  assertSameTree(CellOctree::subtract(CellOctree::fromDescriptor("X|PPPPPPPP"),
+                                      e),
+                 d);
+  const auto uniform = CellOctree::createUniformGrid(2);
+  assertSameTree(CellOctree::subtract(*uniform, *uniform),
+                 CellOctree::fromDescriptor("."));
+
+  advpt::testing::throws<std::invalid_argument>([&a]() {
+    auto _ = CellOctree::unite(a, CellOctree{OctreeGeometry{{1., 0., 0.}, 1.}});
+  });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testPersistentOctree() {
+#if TEST_NODES_STREAM
+  auto descriptorOf = [](const CellOctree &octree) {
+    std::string descr;
+    size_t level = 0;
+    for (auto idx : std::views::iota(0uz, octree.numberOfNodes())) {
+      if (octree.levelOf(idx) != level) {
+        descr += '|';
+        level = octree.levelOf(idx);
+      }
+      const auto &node = octree.nodesStream()[idx];
+      descr += node.isRefined() ? (node.isPhantom() ? 'X' : 'R')
+                                : (node.isPhantom() ? 'P' : '.');
+    }
+    return descr;
+  };
+
+  const std::string_view descr{"R|R.R.....|................"};
+  const PersistentOctree initial(CellOctree::fromDescriptor(descr));
+  advpt::testing::assert_equal(initial.numberOfNodes(), 25uz);
+  advpt::testing::assert_equal(descriptorOf(*initial.octree()),
+                               std::string{descr});
+
+  // Snapshots share all levels until they are modified
+  PersistentOctree current = initial.snapshot();
+  advpt::testing::assert_true(current.octree() == initial.octree());
+
+  current.refine(MortonIndex{011});
+  advpt::testing::assert_equal(
+      descriptorOf(*current.octree()),
+      std::string{"R|RRR.....|........................"});
+  advpt::testing::assert_equal(descriptorOf(*initial.octree()),
+                               std::string{descr});
+  advpt::testing::assert_false(current.sharesLevelWith(initial, 1uz));
+  advpt::testing::assert_false(current.sharesLevelWith(initial, 2uz));
+
+  current.refine(MortonIndex{0100});
+  advpt::testing::assert_equal(
+      descriptorOf(*current.octree()),
+      std::string{"R|RRR.....|R.......................|........"});
+
+  PersistentOctree next = current.snapshot();
+  next.setPhantom(MortonIndex{0101}, true);
+  advpt::testing::assert_equal(
+      descriptorOf(*next.octree()),
+      std::string{"R|RRR.....|RP......................|........"});
+  advpt::testing::assert_true(next.sharesLevelWith(current, 0uz));
+  advpt::testing::assert_true(next.sharesLevelWith(current, 1uz));
+  advpt::testing::assert_false(next.sharesLevelWith(current, 2uz));
+  advpt::testing::assert_true(next.sharesLevelWith(current, 3uz));
+
+  next.coarsen(MortonIndex{0100});
+  next.coarsen(MortonIndex{010});
+  next.refine(MortonIndex{010});
+  // Concurrent first calls assemble the octree once
+  std::vector<std::shared_ptr<const CellOctree>> assembled(4);
+  {
+    std::vector<std::jthread> threads;
+    for (auto &octree : assembled) {
+      threads.emplace_back([&next, &octree]() { octree = next.octree(); });
+    }
+  }
+  for (const auto &octree : assembled) {
+    advpt::testing::assert_true(octree == assembled.front());
+  }
+  next.coarsen(MortonIndex{010});
+  advpt::testing::assert_equal(descriptorOf(*next.octree()),
+                               std::string{"R|.RR.....|................"});
+
+  advpt::testing::throws<std::logic_error>([&next]() { next.refine(011); });
+  advpt::testing::throws<std::logic_error>([&next]() { next.coarsen(01); });
+  advpt::testing::throws<std::out_of_range>([&next]() { next.refine(0177); });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
@@ -261,6 +532,11 @@ int main(int argc, char **argv) {
       {"testNode", &testNode},
       {"testTrivialTree", &testTrivialTree},
       {"testFromDescriptor", &testFromDescriptor},
-      {"testInvalidDescriptors", &testInvalidDescriptors}}
+      {"testInvalidDescriptors", &testInvalidDescriptors},
+      {"testNonPhantomRank", &testNonPhantomRank},
+      {"testParentIndex", &testParentIndex},
+      {"testCompact", &testCompact},
+      {"testBooleanOperations", &testBooleanOperations},
+      {"testPersistentOctree", &testPersistentOctree}}
       .run(argc, argv);
 }
@@ -1,10 +1,26 @@
 #include "advpt/testing/Testutils.hpp"
 
+#include "oktal/octree/CellForest.hpp"
 #include "oktal/octree/CellGrid.hpp"
 #include "oktal/octree/CellOctree.hpp"
+#include "oktal/octree/GridHierarchy.hpp"
+#include "oktal/octree/Partition.hpp"
+#include "oktal/octree/Stencil.hpp"
+#include "oktal/solver/DenseStencil.hpp"
+#include "oktal/solver/Krylov.hpp"
+#include "oktal/solver/Multigrid.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <numeric>
 #include <ranges>
+#include <type_traits>
+#include <utility>
 
 #define TEST_ENUMERATION_INTERFACE true
 #define TEST_BUILDER true
@@ -16,6 +32,22 @@ namespace {
 
 using namespace oktal;
 
+#if TEST_ADJACENCY
+const std::vector<AdjacencyOffset> FACES{{-1, 0, 0}, {1, 0, 0}, {0, -1, 0},
+                                         {0, 1, 0},  {0, 0, -1}, {0, 0, 1}};
+
+// Returns u = 1 on the boundary cells, which is the solution for f = 0, and
+// u = 0 on the interior cells
+std::vector<double> boundaryOnes(const CellGrid &grid) {
+  std::vector<double> u(grid.size(), 1.0);
+  for (const auto range : grid.interiorRanges()) {
+    std::fill(u.begin() + static_cast<std::ptrdiff_t>(range.begin),
+              u.begin() + static_cast<std::ptrdiff_t>(range.end), 0.0);
+  }
+  return u;
+}
+#endif
+
 void testEnumerationInterface() {
 #if TEST_ENUMERATION_INTERFACE
   static_assert(
@@ -628,6 +660,1491 @@ void testCentralDifference() {
 #endif
 }
 
+void testCellForest() {
+#if TEST_ADJACENCY
+  // 4:1:1 channel of uniformly refined trees
+  const auto forest = CellForest::createUniform({4, 1, 1}, 1uz);
+  const auto &ot = forest.octree();
+
+  advpt::testing::assert_equal(forest.numberOfTrees(), 4uz);
+  advpt::testing::assert_equal(forest.rootLevel(), 2uz);
+  advpt::testing::assert_equal(ot->numberOfNonPhantomNodes(), 32uz);
+  advpt::testing::assert_equal(forest.treeRoot(0uz).getBits(), 0100uz);
+  advpt::testing::assert_equal(forest.treeRoot(3uz).getBits(), 0111uz);
+  advpt::testing::assert_equal(forest.treeOf(forest.treeRoot(2uz).child(5)),
+                               2uz);
+  advpt::testing::assert_equal(forest.treeOf(MortonIndex{0102}),
+                               CellForest::NO_TREE);
+
+  const auto cells = CellGrid::create(ot)
+                         .levels({forest.level(1uz)})
+                         .neighborhood({{1, 0, 0}, {0, 1, 0}})
+                         .build();
+  advpt::testing::assert_equal(cells.size(), 32uz);
+
+  // Cells follow the global Morton order across trees
+  advpt::testing::assert_true(std::ranges::is_sorted(
+      cells.mortonIndices(), {}, [](auto m) { return m.getBits(); }));
+
+  for (auto cell : cells) {
+    const auto center = cell.center();
+    advpt::testing::assert_true(center[0] > 0. && center[0] < 4.);
+    advpt::testing::assert_true(center[1] > 0. && center[1] < 1.);
+    advpt::testing::assert_true(center[2] > 0. && center[2] < 1.);
+
+    // Neighbors across tree boundaries exist, the brick boundary is closed
+    const auto east = cell.neighbor({1, 0, 0});
+    advpt::testing::assert_equal(static_cast<bool>(east), center[0] < 3.5);
+    if (east) {
+      advpt::testing::with_tolerance{1e-14, 0.}.assert_close(
+          east.center()[0], center[0] + 0.5);
+    }
+    advpt::testing::assert_equal(
+        static_cast<bool>(cell.neighbor({0, 1, 0})), center[1] < 0.5);
+  }
+
+  const auto periodicCells =
+      CellGrid::create(ot)
+          .levels({forest.level(1uz)})
+          .neighborhood({{1, 0, 0}})
+          .periodicityMapper(ForestTorus(forest, true, false, false))
+          .build();
+  for (auto cell : periodicCells) {
+    const auto east = cell.neighbor({1, 0, 0});
+    advpt::testing::assert_true(east);
+    advpt::testing::with_tolerance{1e-14, 0.}.assert_close(
+        east.center()[0],
+        cell.center()[0] < 3.5 ? cell.center()[0] + 0.5 : 0.25);
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testPartition() {
+#if TEST_ADJACENCY
+  const auto ot = CellOctree::createUniformGrid(3uz);
+  const auto cells = CellGrid::create(ot)
+                         .levels({3uz})
+                         .neighborhood({{-1, 0, 0},
+                                        {1, 0, 0},
+                                        {0, -1, 0},
+                                        {0, 1, 0},
+                                        {0, 0, -1},
+                                        {0, 0, 1}})
+                         .build();
+
+  // Every part is a pair of octants, i.e. an 8x4x4 slab
+  const auto uniform = partition(cells, 4uz);
+  advpt::testing::assert_equal(uniform.parts.size(), 4uz);
+  for (std::size_t p = 0; p < 4; ++p) {
+    advpt::testing::assert_true(uniform.parts[p] ==
+                                EnumerationRange{128 * p, 128 * (p + 1)});
+    advpt::testing::assert_equal(uniform.surfaceToVolume[p], 0.5);
+  }
+  advpt::testing::assert_equal(uniform.imbalance, 1.0);
+  advpt::testing::assert_equal(uniform.partOf(0uz), 0uz);
+  advpt::testing::assert_equal(uniform.partOf(300uz), 2uz);
+  advpt::testing::assert_equal(uniform.partOf(511uz), 3uz);
+
+  // The first half of the cells is three times as expensive
+  std::vector<double> weights(cells.size(), 1.0);
+  std::fill_n(weights.begin(), 256, 3.0);
+  const auto weighted = partition(cells, weights, 2uz);
+  advpt::testing::assert_true(weighted.parts[0] == EnumerationRange{0, 171});
+  advpt::testing::assert_true(weighted.parts[1] == EnumerationRange{171, 512});
+  advpt::testing::assert_equal(weighted.partWeights[0], 513.0);
+  advpt::testing::assert_equal(weighted.partWeights[1], 511.0);
+  advpt::testing::with_tolerance{1e-14, 0.}.assert_close(weighted.imbalance,
+                                                          513.0 / 512.0);
+
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() {
+    auto _ = partition(cells, std::span{weights}.first(3), 2uz);
+  });
+  for (const double bad : {-1.0, std::numeric_limits<double>::infinity(),
+                           std::numeric_limits<double>::quiet_NaN()}) {
+    std::vector<double> badWeights(cells.size(), 1.0);
+    badWeights[7] = bad;
+    advpt::testing::throws<std::invalid_argument>(
+        [&]() { auto _ = partition(cells, badWeights, 2uz); });
+  }
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = partition(cells, 0uz); });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testGhostLayer() {
+#if TEST_ADJACENCY
+  const auto ot = CellOctree::createUniformGrid(3uz);
+  const auto cells = CellGrid::create(ot)
+                         .levels({3uz})
+                         .neighborhood({{-1, 0, 0},
+                                        {1, 0, 0},
+                                        {0, -1, 0},
+                                        {0, 1, 0},
+                                        {0, 0, -1},
+                                        {0, 0, 1}})
+                         .build();
+  const auto parts = partition(cells, 4uz).parts;
+
+  // The first 8x4x4 slab touches the slabs above it in y and z
+  const auto layer = cells.ghostLayer(parts[0], parts);
+  advpt::testing::assert_equal(layer.halo.size(), 64uz);
+  advpt::testing::assert_true(std::ranges::is_sorted(layer.halo));
+  advpt::testing::assert_equal(layer.exchanges.size(), 2uz);
+  advpt::testing::assert_equal(layer.exchanges[0].part, 1uz);
+  advpt::testing::assert_equal(layer.exchanges[1].part, 2uz);
+  for (const auto &exchange : layer.exchanges) {
+    advpt::testing::assert_equal(exchange.send.size(), 32uz);
+    advpt::testing::assert_equal(exchange.receive.size(), 32uz);
+    for (auto cell : exchange.receive) {
+      advpt::testing::assert_true(parts[exchange.part].contains(cell));
+    }
+    for (auto cell : exchange.send) {
+      advpt::testing::assert_true(parts[0].contains(cell));
+    }
+  }
+
+  // Sends of one part are the receives of the other
+  const auto other = cells.ghostLayer(parts[1], parts);
+  advpt::testing::assert_equal(other.exchanges[0].part, 0uz);
+  advpt::testing::assert_range_equal(other.exchanges[0].receive,
+                                     layer.exchanges[0].send);
+  advpt::testing::assert_range_equal(other.exchanges[0].send,
+                                     layer.exchanges[0].receive);
+
+  // Matches a scan of the whole adjacency, with and without opposite offsets
+  // and periodic wrapping
+  const auto expectLayers = [](const CellGrid &grid) {
+    const auto gridParts = partition(grid, 5uz).parts;
+    const auto partOf = [&](size_t cell) {
+      return static_cast<size_t>(std::ranges::find_if(
+                                     gridParts,
+                                     [&](const EnumerationRange &range) {
+                                       return range.contains(cell);
+                                     }) -
+                                 gridParts.begin());
+    };
+    for (size_t p = 0; p < gridParts.size(); ++p) {
+      std::vector<std::vector<size_t>> send(gridParts.size());
+      std::vector<std::vector<size_t>> receive(gridParts.size());
+      for (size_t cell = 0; cell < grid.size(); ++cell) {
+        for (size_t slot = 0; slot < grid.adjacencyOffsets().size(); ++slot) {
+          const size_t neighbor = grid.neighborIndex(slot, cell);
+          if (neighbor >= grid.size() || partOf(cell) == partOf(neighbor)) {
+            continue;
+          }
+          if (partOf(cell) == p) {
+            receive[partOf(neighbor)].push_back(neighbor);
+          } else if (partOf(neighbor) == p) {
+            send[partOf(cell)].push_back(neighbor);
+          }
+        }
+      }
+      const auto layer = grid.ghostLayer(gridParts[p], gridParts);
+      size_t exchanged = 0;
+      for (size_t q = 0; q < gridParts.size(); ++q) {
+        for (auto *cellsOfPart : {&send[q], &receive[q]}) {
+          std::ranges::sort(*cellsOfPart);
+          cellsOfPart->erase(std::ranges::unique(*cellsOfPart).begin(),
+                             cellsOfPart->end());
+        }
+        if (send[q].empty() && receive[q].empty()) {
+          continue;
+        }
+        advpt::testing::assert_true(exchanged < layer.exchanges.size());
+        const auto &exchange = layer.exchanges[exchanged++];
+        advpt::testing::assert_equal(exchange.part, q);
+        advpt::testing::assert_range_equal(exchange.send, send[q]);
+        advpt::testing::assert_range_equal(exchange.receive, receive[q]);
+      }
+      advpt::testing::assert_equal(layer.exchanges.size(), exchanged);
+    }
+  };
+  expectLayers(cells);
+  expectLayers(CellGrid::create(ot)
+                   .levels({3uz})
+                   .neighborhood(
+                       {{-1, 0, 0}, {1, 0, 0}, {0, -1, 1}, {0, 1, -1}})
+                   .periodicity<periodicity::Torus<true, true, false>>()
+                   .build());
+  expectLayers(CellGrid::create(ot)
+                   .levels({3uz})
+                   .neighborhood({{1, 0, 0}, {0, 1, 1}})
+                   .build());
+
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    auto _ = cells.ghostLayer(EnumerationRange{0, 10}, parts);
+  });
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    auto _ = cells.ghostLayer(parts[0], std::span{parts}.first(3));
+  });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testInterleavedAdjacency() {
+#if TEST_ADJACENCY
+  const auto ot = std::make_shared<CellOctree>(
+      CellOctree::fromDescriptor("R|.R.R....|........P......."));
+  const std::vector<AdjacencyOffset> offsets{
+      {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {1, 1, 1}};
+
+  const auto perOffset = CellGrid::create(ot)
+                             .levels({1uz, 2uz})
+                             .neighborhood(offsets)
+                             .periodicityMapper(Torus(true, false, true))
+                             .build();
+  const auto interleaved = CellGrid::create(ot)
+                               .levels({1uz, 2uz})
+                               .neighborhood(offsets)
+                               .periodicityMapper(Torus(true, false, true))
+                               .adjacencyLayout(AdjacencyLayout::Interleaved)
+                               .build();
+
+  advpt::testing::assert_true(perOffset.adjacencyLayout() ==
+                              AdjacencyLayout::PerOffset);
+  advpt::testing::assert_true(interleaved.adjacencyLayout() ==
+                              AdjacencyLayout::Interleaved);
+  advpt::testing::assert_equal(interleaved.size(), perOffset.size());
+  advpt::testing::assert_equal(interleaved.adjacencySlot({0, 1, 0}), 3uz);
+
+  for (auto cell : interleaved) {
+    const auto neighbors = interleaved.neighbors(cell);
+    advpt::testing::assert_equal(neighbors.size(), offsets.size());
+    for (size_t slot = 0; slot < offsets.size(); ++slot) {
+      const size_t expected = perOffset.neighborIndices(offsets[slot])[cell];
+      advpt::testing::assert_equal(interleaved.neighborIndex(slot, cell),
+                                   expected);
+      advpt::testing::assert_equal(perOffset.neighborIndex(slot, cell),
+                                   expected);
+      const size_t expectedCompact = expected == CellGrid::NO_NEIGHBOR
+                                         ? CellGrid::NO_COMPACT_NEIGHBOR
+                                         : expected;
+      advpt::testing::assert_equal(size_t{neighbors[slot]}, expectedCompact);
+      advpt::testing::assert_equal(
+          cell.neighbor(offsets[slot]).enumerationIndex(), expected);
+    }
+  }
+
+  advpt::testing::throws<std::logic_error>(
+      [&]() { auto _ = interleaved.neighborIndices({1, 0, 0}); });
+  advpt::testing::throws<std::logic_error>(
+      [&]() { auto _ = perOffset.neighbors(0uz); });
+  advpt::testing::throws<std::out_of_range>(
+      [&]() { static_cast<void>(interleaved.adjacencySlot({0, 0, 1})); });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testStencilGrid() {
+#if TEST_ADJACENCY
+  using Faces = Stencil<Offset<-1, 0, 0>, Offset<1, 0, 0>, Offset<0, 0, 1>>;
+  static_assert(Faces::size == 3);
+  static_assert(Faces::slotOf<Offset<1, 0, 0>>() == 1);
+  static_assert(Faces::slotOf<Offset<0, 0, 1>>() == 2);
+  static_assert(
+      !detail::AreDistinct<Offset<1, 0, 0>, Offset<0, 1, 0>,
+                           Offset<1, 0, 0>>::value);
+
+  const auto ot = std::make_shared<CellOctree>(
+      CellOctree::fromDescriptor("R|.R.R....|........P......."));
+  const auto stencilGrid = CellGrid::create(ot).levels({2uz}).build(Faces{});
+  const auto reference = CellGrid::create(ot)
+                             .levels({2uz})
+                             .neighborhood({{-1, 0, 0}, {1, 0, 0}, {0, 0, 1}})
+                             .build();
+
+  advpt::testing::assert_true(stencilGrid.grid().adjacencyLayout() ==
+                              AdjacencyLayout::Interleaved);
+  advpt::testing::assert_equal(stencilGrid.size(), reference.size());
+  advpt::testing::assert_range_equal(stencilGrid.grid().adjacencyOffsets(),
+                                     reference.adjacencyOffsets());
+
+  auto toIndex = [](CompactNeighborIndex neighbor) {
+    return neighbor == CellGrid::NO_COMPACT_NEIGHBOR ? CellGrid::NO_NEIGHBOR
+                                                     : size_t{neighbor};
+  };
+  for (size_t cell = 0; cell < stencilGrid.size(); ++cell) {
+    advpt::testing::assert_equal(
+        toIndex(stencilGrid.neighbor<0>(cell)),
+        reference.neighborIndices({-1, 0, 0})[cell]);
+    advpt::testing::assert_equal(
+        toIndex(stencilGrid.neighbor<Offset<1, 0, 0>>(cell)),
+        reference.neighborIndices({1, 0, 0})[cell]);
+    advpt::testing::assert_equal(toIndex(stencilGrid.neighbors(cell)[2]),
+                                 reference.neighborIndices({0, 0, 1})[cell]);
+
+    size_t visited = 0;
+    stencilGrid.forEachNeighbor(cell, [&](auto slot, auto neighbor) {
+      advpt::testing::assert_equal(toIndex(neighbor),
+                                   reference.neighborIndex(slot, cell));
+      ++visited;
+    });
+    advpt::testing::assert_equal(visited, 3uz);
+  }
+
+  // Fields are added through the stencil grid, which only hands out the
+  // grid itself read-only
+  auto withFields = CellGrid::create(ot).levels({2uz}).build(Faces{});
+  static_assert(std::is_const_v<
+                std::remove_reference_t<decltype(withFields.grid())>>);
+  const auto handle = withFields.addField<double>("u");
+  withFields.field(handle)[1] = 2.0;
+  advpt::testing::assert_equal(withFields.grid().field(handle).size(),
+                               withFields.size());
+  advpt::testing::assert_equal(withFields.grid().field(handle)[1], 2.0);
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testLeafAdjacency() {
+#if TEST_ADJACENCY
+  // The first octant is refined once more than the others
+  const auto ot = std::make_shared<CellOctree>(
+      CellOctree::fromDescriptor("X|X.......|........"));
+  const auto cells = CellGrid::create(ot)
+                         .neighborhood({{-1, 0, 0}, {1, 0, 0}})
+                         .leafAdjacency()
+                         .build();
+  // Level-1 cells are 0 to 6 (branches 1 to 7), level-2 cells 7 to 14
+  advpt::testing::assert_equal(cells.size(), 15uz);
+  advpt::testing::assert_true(cells.hasLeafAdjacency());
+
+  // Coarse cell next to the refined octant sees four finer neighbors
+  const auto finer = cells.leafNeighbors(0uz, 0uz);
+  std::vector<size_t> finerCells(finer.cells.begin(), finer.cells.end());
+  std::ranges::sort(finerCells);
+  advpt::testing::assert_range_equal(finerCells,
+                                     std::vector<size_t>{8, 10, 12, 14});
+  for (auto weight : finer.weights) {
+    advpt::testing::assert_equal(weight, 0.25);
+  }
+
+  // Fine cell next to the coarse region sees one coarser neighbor
+  const auto coarser = cells.leafNeighbors(1uz, 8uz);
+  advpt::testing::assert_range_equal(coarser.cells, std::vector<size_t>{0});
+  advpt::testing::assert_range_equal(coarser.weights, std::vector<double>{1});
+
+  // Same-level neighbors and the domain boundary
+  const auto sameLevel = cells.leafNeighbors(1uz, 7uz);
+  advpt::testing::assert_range_equal(sameLevel.cells, std::vector<size_t>{8});
+  advpt::testing::assert_equal(cells.leafNeighbors(0uz, 7uz).size(), 0uz);
+  advpt::testing::assert_equal(cells.neighborIndices({1, 0, 0})[8],
+                               CellGrid::NO_NEIGHBOR);
+
+  // Periodic wrap from the coarse region into the refined octant
+  const auto periodic = CellGrid::create(ot)
+                            .neighborhood({{1, 0, 0}})
+                            .periodicityMapper(Torus(true, false, false))
+                            .leafAdjacency()
+                            .build();
+  advpt::testing::assert_equal(periodic.leafNeighbors(0uz, 0uz).size(), 4uz);
+
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    auto _ = CellGrid::create(ot)
+                 .neighborhood({{1, 1, 0}})
+                 .leafAdjacency()
+                 .build();
+  });
+  const auto plain = CellGrid::create(ot).neighborhood({{1, 0, 0}}).build();
+  advpt::testing::assert_false(plain.hasLeafAdjacency());
+  advpt::testing::throws<std::logic_error>(
+      [&]() { auto _ = plain.leafNeighbors(0uz, 0uz); });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testFieldRegistry() {
+#if TEST_ENUMERATION_INTERFACE
+  auto isAligned = [](const void *ptr) {
+    return reinterpret_cast<std::uintptr_t>(ptr) % FieldRegistry::ALIGNMENT ==
+           0;
+  };
+
+  const auto ot = CellOctree::createUniformGrid(2uz);
+  auto cells = CellGrid::create(ot).levels({2uz}).build();
+  advpt::testing::assert_equal(cells.fields().numberOfCells(), 64uz);
+
+  const auto pressure = cells.addField<double>("pressure");
+  const auto velocity = cells.addField<Vec3D>("velocity");
+  const auto flags = cells.addField<std::int32_t>("flags");
+  advpt::testing::assert_equal(cells.fields().size(), 3uz);
+
+  auto p = cells.field(pressure);
+  advpt::testing::assert_equal(p.size(), 64uz);
+  advpt::testing::assert_true(isAligned(p.data()));
+  advpt::testing::assert_true(std::ranges::all_of(p, [](double v) {
+    return v == 0.0;
+  }));
+  for (auto cell : cells) {
+    p[cell] = static_cast<double>(cell.level());
+  }
+
+  // Vector fields are stored as one aligned array per component
+  auto v = cells.field(velocity);
+  for (size_t c = 0; c < 3; ++c) {
+    advpt::testing::assert_equal(v.component(c).size(), 64uz);
+    advpt::testing::assert_true(isAligned(v.component(c).data()));
+  }
+  v.set(5uz, Vec3D{1.0, 2.0, 3.0});
+  advpt::testing::assert_equal(v.component(1)[5], 2.0);
+  advpt::testing::assert_equal(v[5uz][2], 3.0);
+  advpt::testing::assert_true(isAligned(cells.field(flags).data()));
+
+  // Handles by name, checked against the stored type
+  const auto pressureAgain = cells.fields().handle<double>("pressure");
+  advpt::testing::assert_equal(pressureAgain.index(), pressure.index());
+  advpt::testing::assert_equal(cells.field(pressureAgain)[7], 2.0);
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = cells.fields().handle<float>("pressure"); });
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = cells.fields().handle<double>("velocity"); });
+  advpt::testing::throws<std::out_of_range>(
+      [&]() { auto _ = cells.fields().handle<double>("density"); });
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = cells.addField<double>("pressure"); });
+
+  // Type-erased access as used by exporters
+  const auto info = cells.fields().info(velocity.index());
+  advpt::testing::assert_true(info.name == "velocity");
+  advpt::testing::assert_equal(info.components, 3uz);
+  advpt::testing::assert_true(info.componentType == typeid(double));
+  advpt::testing::assert_equal(
+      cells.fields().component<double>(velocity.index(), 0)[5], 1.0);
+
+  // Copies of a grid own their fields
+  const CellGrid copy = cells;
+  p[7] = 42.0;
+  advpt::testing::assert_equal(copy.field(pressure)[7], 2.0);
+
+  // Handles of other grids are rejected, while a rebuilt grid keeps the
+  // fields and handles of the grid it replaces
+  auto other = CellGrid::create(ot).levels({2uz}).build();
+  const auto otherPressure = other.addField<double>("pressure");
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = cells.field(otherPressure); });
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = std::as_const(other).field(pressure); });
+  std::vector<size_t> identity(ot->numberOfNodes());
+  std::iota(identity.begin(), identity.end(), 0uz);
+  const auto rebuilt = cells.rebuild(ot, identity);
+  advpt::testing::assert_equal(rebuilt.field(pressure)[7], 42.0);
+
+  // Huge-page backing only changes the allocation
+  FieldRegistry large{1uz << 19};
+  large.useHugePages(true);
+  const auto big = large.add<double>("big");
+  const auto bigView = large.view(big);
+  advpt::testing::assert_true(reinterpret_cast<std::uintptr_t>(
+                                  bigView.data()) %
+                                  (2uz << 20) ==
+                              0);
+  advpt::testing::assert_equal(bigView[(1uz << 19) - 1], 0.0);
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testRcmOrdering() {
+#if TEST_ADJACENCY
+  // Two levels with hanging faces between them
+  const auto ot = std::make_shared<CellOctree>(CellOctree::fromDescriptor(
+      "X|XX.XX...|................................"));
+  const auto morton =
+      CellGrid::create(ot).neighborhood(FACES).leafAdjacency().build();
+  const auto rcm = CellGrid::create(ot)
+                       .neighborhood(FACES)
+                       .leafAdjacency()
+                       .ordering(Ordering::RCM)
+                       .build();
+
+  advpt::testing::assert_true(morton.ordering() == Ordering::Morton);
+  advpt::testing::assert_true(rcm.ordering() == Ordering::RCM);
+  advpt::testing::assert_equal(rcm.size(), morton.size());
+
+  const auto before = morton.adjacencyStatistics();
+  const auto after = rcm.adjacencyStatistics();
+  advpt::testing::assert_true(after.bandwidth < before.bandwidth);
+  advpt::testing::assert_true(after.profile < before.profile);
+
+  // The renumbering is consistent across Morton indices, stream indices and
+  // both kinds of adjacency
+  for (auto cell : rcm) {
+    const size_t mortonIdx =
+        morton.getEnumerationIndex(rcm[cell].streamIndex());
+    advpt::testing::assert_equal(rcm.getEnumerationIndex(rcm[cell]),
+                                 size_t{cell});
+    advpt::testing::assert_true(morton.mortonIndices()[mortonIdx] ==
+                                cell.mortonIndex());
+    for (size_t slot = 0; slot < FACES.size(); ++slot) {
+      const auto neighbor = cell.neighbor(FACES[slot]);
+      const auto expected = morton.neighborIndices(FACES[slot])[mortonIdx];
+      advpt::testing::assert_equal(neighbor.isValid(),
+                                   expected != CellGrid::NO_NEIGHBOR);
+      if (neighbor) {
+        advpt::testing::assert_true(neighbor.mortonIndex() ==
+                                    morton.mortonIndices()[expected]);
+      }
+      advpt::testing::assert_equal(
+          rcm.leafNeighbors(slot, cell).size(),
+          morton.leafNeighbors(slot, mortonIdx).size());
+    }
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testIncrementalRebuild() {
+#if TEST_ADJACENCY
+  const auto before = std::make_shared<CellOctree>(CellOctree::fromDescriptor(
+      "X|XX.XX...|................................"));
+  // Coarsens the second and refines the seventh node of level one
+  const auto after = std::make_shared<CellOctree>(CellOctree::fromDescriptor(
+      "X|X..XX.X.|................................"));
+
+  // Maps the nodes of every cell to the node of the same cell
+  std::vector<size_t> remap(before->numberOfNodes(),
+                            CellOctree::NO_STREAM_INDEX);
+  for (auto cell : CellGrid::create(before).build()) {
+    if (const auto node = after->getCell(cell.mortonIndex())) {
+      remap[before->getCell(cell.mortonIndex())->streamIndex()] =
+          node->streamIndex();
+    }
+  }
+
+  const std::vector<AdjacencyOffset> offsets{
+      {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0}};
+  auto expectSameGrid = [](const CellGrid &rebuilt, const CellGrid &built) {
+    advpt::testing::assert_equal(rebuilt.size(), built.size());
+    advpt::testing::assert_true(rebuilt == built);
+    advpt::testing::assert_true(rebuilt.ordering() == built.ordering());
+    const size_t numSlots = built.adjacencyOffsets().size();
+    for (size_t cell = 0; cell < built.size(); ++cell) {
+      for (size_t slot = 0; slot < numSlots; ++slot) {
+        advpt::testing::assert_equal(rebuilt.neighborIndex(slot, cell),
+                                     built.neighborIndex(slot, cell));
+        if (built.hasLeafAdjacency()) {
+          const auto leaves = rebuilt.leafNeighbors(slot, cell);
+          const auto expected = built.leafNeighbors(slot, cell);
+          advpt::testing::assert_true(
+              std::ranges::equal(leaves.cells, expected.cells));
+          advpt::testing::assert_true(
+              std::ranges::equal(leaves.weights, expected.weights));
+        }
+      }
+    }
+
+    advpt::testing::assert_equal(rebuilt.numberOfGhosts(),
+                                 built.numberOfGhosts());
+    for (size_t i = 0; i < built.numberOfGhosts(); ++i) {
+      const auto &ghost = rebuilt.ghosts()[i];
+      const auto &expected = built.ghosts()[i];
+      advpt::testing::assert_equal(ghost.cell, expected.cell);
+      advpt::testing::assert_equal(ghost.slot, expected.slot);
+      advpt::testing::assert_equal(ghost.distance, expected.distance);
+      advpt::testing::assert_equal(ghost.periodicPartner,
+                                   expected.periodicPartner);
+    }
+
+    advpt::testing::assert_true(
+        std::ranges::equal(rebuilt.interiorRanges(), built.interiorRanges()));
+    advpt::testing::assert_equal(rebuilt.boundaryGroups().size(),
+                                 built.boundaryGroups().size());
+    for (size_t i = 0; i < built.boundaryGroups().size(); ++i) {
+      const auto &group = rebuilt.boundaryGroups()[i];
+      const auto &expected = built.boundaryGroups()[i];
+      advpt::testing::assert_true(group.missingSlots == expected.missingSlots);
+      advpt::testing::assert_true(group.cells == expected.cells);
+    }
+  };
+
+  for (const auto layout :
+       {AdjacencyLayout::PerOffset, AdjacencyLayout::Interleaved}) {
+    auto configure = [&](const std::shared_ptr<const CellOctree> &ot) {
+      return CellGrid::create(ot)
+          .neighborhood(offsets)
+          .adjacencyLayout(layout)
+          .periodicityMapper(Torus(true, false, true))
+          .ghostCells()
+          .geometryCache();
+    };
+    const auto grid = configure(before).build();
+    const auto rebuilt = grid.rebuild(after, remap);
+    advpt::testing::assert_true(rebuilt.adjacencyLayout() == layout);
+    expectSameGrid(rebuilt, configure(after).build());
+    for (auto cell : rebuilt) {
+      // NOLINTNEXTLINE (bugprone-unchecked-optional-access)
+      const auto expected = after->getCell(cell.mortonIndex())->center();
+      for (size_t axis = 0; axis < 3; ++axis) {
+        advpt::testing::assert_equal(rebuilt.centers(axis)[cell],
+                                     expected[axis]);
+      }
+      advpt::testing::assert_equal(size_t{rebuilt.levels()[cell]},
+                                   cell.level());
+    }
+
+    // Adapting back restores the original grid
+    std::vector<size_t> backwards(after->numberOfNodes(),
+                                  CellOctree::NO_STREAM_INDEX);
+    for (size_t node = 0; node < remap.size(); ++node) {
+      if (remap[node] != CellOctree::NO_STREAM_INDEX) {
+        backwards[remap[node]] = node;
+      }
+    }
+    expectSameGrid(rebuilt.rebuild(before, backwards), grid);
+  }
+
+  // Selected levels carry over
+  const auto finest = CellGrid::create(before).levels({2}).neighborhood(
+      offsets).build();
+  expectSameGrid(finest.rebuild(after, remap),
+                 CellGrid::create(after).levels({2}).neighborhood(offsets)
+                     .build());
+
+  // Leaf rows reach across levels
+  const auto leaves =
+      CellGrid::create(before).neighborhood(FACES).leafAdjacency().build();
+  expectSameGrid(
+      leaves.rebuild(after, remap),
+      CellGrid::create(after).neighborhood(FACES).leafAdjacency().build());
+
+  // Renumbered grids are renumbered again
+  for (const auto ordering : {Ordering::RCM, Ordering::Multicolor}) {
+    auto configure = [&](const std::shared_ptr<const CellOctree> &ot) {
+      return CellGrid::create(ot)
+          .neighborhood(FACES)
+          .leafAdjacency()
+          .ordering(ordering)
+          .ghostCells();
+    };
+    expectSameGrid(configure(before).build().rebuild(after, remap),
+                   configure(after).build());
+  }
+
+  // Fields keep their values on the persisting cells and their handles
+  auto withField = CellGrid::create(before).neighborhood(offsets).build();
+  const auto level = withField.addField<double>("level");
+  for (size_t cell = 0; cell < withField.size(); ++cell) {
+    withField.field(level)[cell] =
+        static_cast<double>(withField.mortonIndices()[cell].level()) + 1.0;
+  }
+  const auto rebuiltField = withField.rebuild(after, remap);
+  for (size_t cell = 0; cell < rebuiltField.size(); ++cell) {
+    const auto mortonIdx = rebuiltField.mortonIndices()[cell];
+    advpt::testing::assert_equal(
+        rebuiltField.field(level)[cell],
+        before->getCell(mortonIdx)
+            ? static_cast<double>(mortonIdx.level()) + 1.0
+            : 0.0);
+  }
+
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = finest.rebuild(after, std::span{remap}.first(3)); });
+
+  // A remap that swaps two cells breaks their Morton order
+  auto swapped = remap;
+  const auto first = before->getCell(MortonIndex{0100})->streamIndex();
+  const auto second = before->getCell(MortonIndex{0101})->streamIndex();
+  std::swap(swapped[first], swapped[second]);
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = finest.rebuild(after, swapped); });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testGeometryCache() {
+#if TEST_ENUMERATION_INTERFACE
+  const auto ot = std::make_shared<CellOctree>(CellOctree::fromDescriptor(
+      "X|XX.XX...|................................"));
+  const auto grid = CellGrid::create(ot)
+                        .neighborhood(FACES)
+                        .ordering(Ordering::RCM)
+                        .geometryCache()
+                        .build();
+  advpt::testing::assert_true(grid.hasGeometryCache());
+
+  for (size_t axis = 0; axis < 3; ++axis) {
+    advpt::testing::assert_equal(grid.centers(axis).size(), grid.size());
+    advpt::testing::assert_equal(
+        reinterpret_cast<std::uintptr_t>(grid.centers(axis).data()) % 64,
+        std::uintptr_t{0});
+  }
+  // The arrays follow the cell order, here the RCM numbering
+  for (auto cell : grid) {
+    // NOLINTNEXTLINE (bugprone-unchecked-optional-access)
+    const auto expected = ot->getCell(cell.mortonIndex())->center();
+    const auto coords = cell.mortonIndex().gridCoordinates();
+    for (size_t axis = 0; axis < 3; ++axis) {
+      advpt::testing::assert_equal(grid.centers(axis)[cell], expected[axis]);
+      advpt::testing::assert_equal(size_t{grid.gridCoordinates(axis)[cell]},
+                                   coords[axis]);
+    }
+    advpt::testing::assert_equal(size_t{grid.levels()[cell]}, cell.level());
+    advpt::testing::assert_true(cell.center() == expected);
+  }
+
+  advpt::testing::throws<std::out_of_range>(
+      [&]() { auto _ = grid.centers(3); });
+  const auto uncached = CellGrid::create(ot).build();
+  advpt::testing::assert_false(uncached.hasGeometryCache());
+  advpt::testing::throws<std::logic_error>(
+      [&]() { auto _ = uncached.levels(); });
+  advpt::testing::assert_true(uncached[0].center() ==
+                              CellGrid::CellView(&uncached, 0).center());
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testColoring() {
+#if TEST_ADJACENCY
+  auto expectProperColoring = [](const CellGrid &grid,
+                                 const CellColoring &coloring) {
+    std::vector<size_t> colorOf(grid.size(), CellGrid::NO_NEIGHBOR);
+    for (size_t color = 0; color < coloring.numberOfColors(); ++color) {
+      advpt::testing::assert_false(coloring.cellsOf(color).empty());
+      for (const size_t cell : coloring.cellsOf(color)) {
+        advpt::testing::assert_equal(colorOf[cell], CellGrid::NO_NEIGHBOR);
+        colorOf[cell] = color;
+      }
+    }
+    for (size_t cell = 0; cell < grid.size(); ++cell) {
+      advpt::testing::assert_true(colorOf[cell] != CellGrid::NO_NEIGHBOR);
+      for (size_t slot = 0; slot < grid.adjacencyOffsets().size(); ++slot) {
+        const size_t neighbor = grid.neighborIndex(slot, cell);
+        if (neighbor != CellGrid::NO_NEIGHBOR && neighbor != cell) {
+          advpt::testing::assert_true(colorOf[neighbor] != colorOf[cell]);
+        }
+        if (grid.hasLeafAdjacency()) {
+          for (const size_t leaf : grid.leafNeighbors(slot, cell).cells) {
+            advpt::testing::assert_true(colorOf[leaf] != colorOf[cell]);
+          }
+        }
+      }
+    }
+  };
+
+  // Red-black for face neighbors, eight colors with diagonal neighbors
+  const auto uniform = CellOctree::createUniformGrid(2);
+  const auto redBlack = CellGrid::create(uniform)
+                            .levels({2})
+                            .neighborhood(FACES)
+                            .periodicityMapper(Torus(true, true, true))
+                            .build();
+  const auto redBlackColoring = redBlack.coloring();
+  advpt::testing::assert_equal(redBlackColoring.numberOfColors(), size_t{2});
+  expectProperColoring(redBlack, redBlackColoring);
+
+  std::vector<AdjacencyOffset> box;
+  for (const std::ptrdiff_t x : {-1, 0, 1}) {
+    for (const std::ptrdiff_t y : {-1, 0, 1}) {
+      for (const std::ptrdiff_t z : {-1, 0, 1}) {
+        if (x != 0 || y != 0 || z != 0) {
+          box.push_back({x, y, z});
+        }
+      }
+    }
+  }
+  const auto eightColors =
+      CellGrid::create(uniform).levels({2}).neighborhood(box).build();
+  const auto eightColoring = eightColors.coloring();
+  advpt::testing::assert_equal(eightColoring.numberOfColors(), size_t{8});
+  expectProperColoring(eightColors, eightColoring);
+
+  // Adjacency across levels is colored greedily
+  const auto ot = std::make_shared<CellOctree>(CellOctree::fromDescriptor(
+      "X|XX.XX...|................................"));
+  const auto adaptive =
+      CellGrid::create(ot).neighborhood(FACES).leafAdjacency().build();
+  expectProperColoring(adaptive, adaptive.coloring());
+
+  // Multicolor ordering makes the colors contiguous
+  const auto ordered = CellGrid::create(ot)
+                           .neighborhood(FACES)
+                           .leafAdjacency()
+                           .ordering(Ordering::Multicolor)
+                           .build();
+  advpt::testing::assert_true(ordered.ordering() == Ordering::Multicolor);
+  const auto contiguous = ordered.coloring();
+  expectProperColoring(ordered, contiguous);
+  for (size_t i = 0; i < ordered.size(); ++i) {
+    advpt::testing::assert_equal(contiguous.cells[i], i);
+  }
+  for (auto cell : ordered) {
+    advpt::testing::assert_equal(ordered.getEnumerationIndex(ordered[cell]),
+                                 size_t{cell});
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testBoundaryGroups() {
+#if TEST_ADJACENCY
+  const auto uniform = CellOctree::createUniformGrid(2);
+  const auto grid = CellGrid::create(uniform)
+                        .levels({2})
+                        .neighborhood(FACES)
+                        .adjacencyLayout(AdjacencyLayout::Interleaved)
+                        .build();
+
+  std::vector<size_t> visits(grid.size(), 0);
+  size_t interiorCells = 0;
+  for (const auto range : grid.interiorRanges()) {
+    advpt::testing::assert_false(range.empty());
+    for (size_t cell = range.begin; cell < range.end; ++cell) {
+      ++visits[cell];
+      ++interiorCells;
+      for (const auto neighbor : grid.neighbors(cell)) {
+        advpt::testing::assert_true(neighbor != CellGrid::NO_COMPACT_NEIGHBOR);
+      }
+    }
+  }
+  // The 2x2x2 block in the middle of the 4x4x4 level
+  advpt::testing::assert_equal(interiorCells, size_t{8});
+
+  // Faces, edges and corners of the cube lack one, two or three neighbors
+  advpt::testing::assert_equal(grid.boundaryGroups().size(), size_t{26});
+  for (const auto &group : grid.boundaryGroups()) {
+    advpt::testing::assert_true(std::ranges::is_sorted(group.cells));
+    for (const size_t cell : group.cells) {
+      ++visits[cell];
+      for (size_t slot = 0; slot < FACES.size(); ++slot) {
+        advpt::testing::assert_equal(
+            grid.neighborIndex(slot, cell) == CellGrid::NO_NEIGHBOR,
+            std::ranges::find(group.missingSlots, slot) !=
+                group.missingSlots.end());
+      }
+    }
+  }
+  advpt::testing::assert_true(
+      std::ranges::all_of(visits, [](size_t n) { return n == 1; }));
+
+  // Without missing neighbors all cells form one range
+  const auto torus = CellGrid::create(uniform)
+                         .levels({2})
+                         .neighborhood(FACES)
+                         .periodicityMapper(Torus(true, true, true))
+                         .build();
+  advpt::testing::assert_equal(torus.interiorRanges().size(), size_t{1});
+  advpt::testing::assert_true(torus.interiorRanges()[0] ==
+                              EnumerationRange{0, torus.size()});
+  advpt::testing::assert_true(torus.boundaryGroups().empty());
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testGhostCells() {
+#if TEST_ADJACENCY
+  const auto uniform = CellOctree::createUniformGrid(2);
+  auto grid = CellGrid::create(uniform)
+                  .levels({2})
+                  .neighborhood(FACES)
+                  .ghostCells()
+                  .build();
+  const auto torus = CellGrid::create(uniform)
+                         .levels({2})
+                         .neighborhood(FACES)
+                         .periodicityMapper(Torus(true, true, true))
+                         .build();
+
+  // One ghost per boundary face of the 4x4x4 level
+  advpt::testing::assert_true(grid.hasGhostCells());
+  advpt::testing::assert_equal(grid.numberOfGhosts(), size_t{6 * 16});
+  advpt::testing::assert_equal(grid.interiorRanges().size(), size_t{1});
+  advpt::testing::assert_true(grid.boundaryGroups().empty());
+  for (size_t i = 0; i < grid.numberOfGhosts(); ++i) {
+    const auto &ghost = grid.ghosts()[i];
+    advpt::testing::assert_equal(grid.neighborIndex(ghost.slot, ghost.cell),
+                                 grid.size() + i);
+    advpt::testing::assert_equal(ghost.distance, 0.25);
+    advpt::testing::assert_equal(ghost.periodicPartner,
+                                 torus.neighborIndex(ghost.slot, ghost.cell));
+    advpt::testing::assert_false(CellGrid::CellView(&grid, ghost.cell)
+                                     .neighbor(FACES[ghost.slot])
+                                     .isValid());
+  }
+
+  const auto handle = grid.addField<double>("u");
+  const auto u = grid.field(handle);
+  advpt::testing::assert_equal(u.size(), grid.size() + grid.numberOfGhosts());
+  for (size_t cell = 0; cell < grid.size(); ++cell) {
+    u[cell] = static_cast<double>(cell);
+  }
+  auto ghostValue = [&](size_t i) { return u[grid.size() + i]; };
+
+  grid.fillGhosts(handle, BoundaryCondition::dirichlet(1.0));
+  for (size_t i = 0; i < grid.numberOfGhosts(); ++i) {
+    advpt::testing::assert_equal(ghostValue(i),
+                                 2.0 - u[grid.ghosts()[i].cell]);
+  }
+  grid.fillGhosts(handle, BoundaryCondition::neumann(2.0));
+  for (size_t i = 0; i < grid.numberOfGhosts(); ++i) {
+    advpt::testing::assert_equal(ghostValue(i),
+                                 u[grid.ghosts()[i].cell] + 0.5);
+  }
+  grid.fillGhosts(handle, BoundaryCondition::periodic());
+  for (size_t i = 0; i < grid.numberOfGhosts(); ++i) {
+    advpt::testing::assert_equal(ghostValue(i),
+                                 u[grid.ghosts()[i].periodicPartner]);
+  }
+
+  std::vector<double> tooShort(grid.size());
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    grid.fillGhosts(std::span{tooShort}, BoundaryCondition::periodic());
+  });
+
+  // Faces towards the phantom padding of a forest brick get ghosts too
+  const auto forest = CellForest::createUniform({4, 1, 1}, 1uz);
+  const auto brick = CellGrid::create(forest.octree())
+                         .levels({forest.level(1uz)})
+                         .neighborhood(FACES)
+                         .ghostCells()
+                         .build();
+  const auto brickTorus =
+      CellGrid::create(forest.octree())
+          .levels({forest.level(1uz)})
+          .neighborhood(FACES)
+          .periodicityMapper(ForestTorus(forest, true, true, true))
+          .build();
+  advpt::testing::assert_equal(brick.size(), 32uz);
+  advpt::testing::assert_equal(brick.numberOfGhosts(), 72uz);
+  for (size_t cell = 0; cell < brick.size(); ++cell) {
+    for (size_t slot = 0; slot < FACES.size(); ++slot) {
+      advpt::testing::assert_true(brick.neighborIndex(slot, cell) !=
+                                  CellGrid::NO_NEIGHBOR);
+    }
+  }
+  for (const auto &ghost : brick.ghosts()) {
+    advpt::testing::assert_equal(ghost.distance, 0.5);
+    advpt::testing::assert_equal(
+        ghost.periodicPartner,
+        brickTorus.neighborIndex(ghost.slot, ghost.cell));
+  }
+
+  // Interleaved stencils never see a missing neighbor
+  const auto interleaved = CellGrid::create(uniform)
+                               .levels({2})
+                               .neighborhood(FACES)
+                               .adjacencyLayout(AdjacencyLayout::Interleaved)
+                               .ghostCells()
+                               .build();
+  for (size_t cell = 0; cell < interleaved.size(); ++cell) {
+    for (const auto neighbor : interleaved.neighbors(cell)) {
+      advpt::testing::assert_true(neighbor != CellGrid::NO_COMPACT_NEIGHBOR);
+    }
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testPeriodicityPolicies() {
+#if TEST_ADJACENCY
+  // Wrapping masks negative and overflowing coordinates into the level
+  const SignedGridCoordinates wrapped =
+      periodicity::Torus<true, true, false>::map({-1, 4, 5}, 2);
+  advpt::testing::assert_true(wrapped == SignedGridCoordinates{3, 0, 5});
+  advpt::testing::assert_true(periodicity::None::map({-1, 4, 5}, 2) ==
+                              SignedGridCoordinates{-1, 4, 5});
+
+  // A mapper without wrappedAxes() goes through the virtual interface
+  class VirtualTorus : public PeriodicityMapper {
+  public:
+    [[nodiscard]]
+    SignedGridCoordinates getNeighborCoordinates(SignedGridCoordinates coords,
+                                                 size_t lvl) const override {
+      return Torus(true, false, true).getNeighborCoordinates(coords, lvl);
+    }
+  };
+
+  const auto ot = std::make_shared<CellOctree>(CellOctree::fromDescriptor(
+      "X|XX.XX...|................................"));
+  const std::vector<AdjacencyOffset> offsets{
+      {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, -1}};
+  const auto policy = CellGrid::create(ot)
+                          .neighborhood(offsets)
+                          .periodicity<periodicity::Torus<true, false, true>>()
+                          .build();
+  const auto runtime = CellGrid::create(ot)
+                           .neighborhood(offsets)
+                           .periodicityMapper(Torus(true, false, true))
+                           .build();
+  const auto dynamic = CellGrid::create(ot)
+                           .neighborhood(offsets)
+                           .periodicityMapper(VirtualTorus{})
+                           .build();
+  const auto none = CellGrid::create(ot)
+                        .neighborhood(offsets)
+                        .periodicity<periodicity::None>()
+                        .build();
+  const auto plain = CellGrid::create(ot).neighborhood(offsets).build();
+
+  for (size_t slot = 0; slot < offsets.size(); ++slot) {
+    for (size_t cell = 0; cell < policy.size(); ++cell) {
+      advpt::testing::assert_equal(policy.neighborIndex(slot, cell),
+                                   runtime.neighborIndex(slot, cell));
+      advpt::testing::assert_equal(policy.neighborIndex(slot, cell),
+                                   dynamic.neighborIndex(slot, cell));
+      advpt::testing::assert_equal(none.neighborIndex(slot, cell),
+                                   plain.neighborIndex(slot, cell));
+    }
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testGridCache() {
+#if TEST_ADJACENCY
+  const auto ot = std::make_shared<CellOctree>(CellOctree::fromDescriptor(
+      "X|XX.XX...|................................"));
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "oktal_test_grid_cache.bin";
+  std::filesystem::remove(path);
+
+  const auto grid = CellGrid::create(ot)
+                        .neighborhood(FACES)
+                        .periodicityMapper(Torus(true, false, false))
+                        .ghostCells()
+                        .build();
+  grid.save(path);
+  const auto loaded = CellGrid::load(path, ot);
+  advpt::testing::assert_equal(loaded.size(), grid.size());
+  advpt::testing::assert_equal(loaded.numberOfGhosts(), grid.numberOfGhosts());
+  for (size_t cell = 0; cell < grid.size(); ++cell) {
+    advpt::testing::assert_true(
+        CellGrid::CellView(&loaded, cell).mortonIndex() ==
+        CellGrid::CellView(&grid, cell).mortonIndex());
+    for (size_t slot = 0; slot < grid.adjacencyOffsets().size(); ++slot) {
+      advpt::testing::assert_equal(loaded.neighborIndex(slot, cell),
+                                   grid.neighborIndex(slot, cell));
+    }
+  }
+  advpt::testing::assert_true(loaded.interiorRanges().size() ==
+                              grid.interiorRanges().size());
+
+  // The builder writes the cache on the first build and reads it afterwards
+  std::filesystem::remove(path);
+  auto builder = [&]() {
+    return CellGrid::create(ot)
+        .neighborhood(FACES)
+        .adjacencyLayout(AdjacencyLayout::Interleaved)
+        .ordering(Ordering::RCM)
+        .cache(path);
+  };
+  const auto built = builder().build();
+  // Saving replaces the file, so a link to the cache only survives reads
+  std::filesystem::path link = path;
+  link += ".link";
+  std::filesystem::remove(link);
+  std::filesystem::create_hard_link(path, link);
+  const auto cached = builder().build();
+  advpt::testing::assert_true(std::filesystem::equivalent(path, link));
+  std::filesystem::remove(link);
+  advpt::testing::assert_equal(cached.ordering(), Ordering::RCM);
+  for (size_t cell = 0; cell < built.size(); ++cell) {
+    advpt::testing::assert_true(
+        CellGrid::CellView(&cached, cell).mortonIndex() ==
+        CellGrid::CellView(&built, cell).mortonIndex());
+    for (size_t slot = 0; slot < built.adjacencyOffsets().size(); ++slot) {
+      advpt::testing::assert_equal(cached.neighborIndex(slot, cell),
+                                   built.neighborIndex(slot, cell));
+    }
+  }
+
+  // A section table with an impossible size is replaced like any other
+  // unreadable cache
+  {
+    std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+    const std::uint64_t bytes = std::uint64_t{1} << 62U;
+    // Size of the first section, behind the 64 byte header and its offset
+    stream.seekp(72);
+    stream.write(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+  }
+  advpt::testing::assert_equal(builder().build().size(), built.size());
+  advpt::testing::assert_equal(CellGrid::load(path, ot).size(), built.size());
+
+  // So are caches whose sections hold out-of-range values. The table entry
+  // of section s sits at 64 + 16 s, and the options at byte 40 of the header.
+  const auto overwrite = [&](std::uint64_t position, auto value) {
+    std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+    stream.seekp(static_cast<std::streamoff>(position));
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+  const auto sectionStart = [&](std::uint64_t section) {
+    std::ifstream stream(path, std::ios::binary);
+    stream.seekg(static_cast<std::streamoff>(64 + (16 * section)));
+    std::uint64_t offset = 0;
+    stream.read(reinterpret_cast<char *>(&offset), sizeof(offset));
+    return offset;
+  };
+  const std::vector<std::function<void()>> corruptions{
+      // A neighbor behind all cells and ghosts
+      [&]() { overwrite(sectionStart(6), std::uint32_t{1U << 30U}); },
+      // An enumeration that is no permutation
+      [&]() {
+        overwrite(sectionStart(2), std::uint64_t{5});
+        overwrite(sectionStart(2) + 8, std::uint64_t{5});
+      },
+      // An unknown ordering
+      [&]() { overwrite(40, std::uint64_t{0xFF00}); },
+      // Level starts that do not match the octree
+      [&]() { overwrite(sectionStart(1), std::uint64_t{1}); }};
+  for (const auto &corrupt : corruptions) {
+    corrupt();
+    advpt::testing::throws<std::runtime_error>(
+        [&]() { auto _ = CellGrid::load(path, ot); });
+    advpt::testing::assert_equal(builder().build().size(), built.size());
+    advpt::testing::assert_equal(CellGrid::load(path, ot).size(),
+                                 built.size());
+  }
+
+  // A different configuration replaces the cache
+  const auto perOffset = CellGrid::create(ot)
+                             .neighborhood(FACES)
+                             .cache(path)
+                             .build();
+  advpt::testing::assert_equal(perOffset.adjacencyLayout(),
+                               AdjacencyLayout::PerOffset);
+
+  // A cache that cannot be written does not fail the build
+  const auto unwritable = CellGrid::create(ot)
+                              .neighborhood(FACES)
+                              .cache(path / "missing" / "cache.bin")
+                              .build();
+  advpt::testing::assert_equal(unwritable.size(), built.size());
+
+  // Grids of other octrees are rejected
+  const auto other = CellOctree::createUniformGrid(2);
+  advpt::testing::throws<std::invalid_argument>(
+      [&]() { auto _ = CellGrid::load(path, other); });
+  std::filesystem::remove(path);
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testGridHierarchy() {
+#if TEST_ADJACENCY
+  const auto uniform = CellOctree::createUniformGrid(3);
+  GridHierarchy hierarchy(CellGrid::create(uniform).geometryCache());
+  advpt::testing::assert_equal(hierarchy.numberOfLevels(), size_t{4});
+  for (size_t lvl = 0; lvl < 4; ++lvl) {
+    advpt::testing::assert_equal(hierarchy.grid(lvl).size(),
+                                 size_t{1} << (3 * lvl));
+  }
+  for (size_t cell = 0; cell < hierarchy.grid(2).size(); ++cell) {
+    for (const size_t child : hierarchy.children(2, cell)) {
+      advpt::testing::assert_equal(hierarchy.parents(3)[child], cell);
+    }
+  }
+
+  // Full weighting and trilinear interpolation reproduce linear functions,
+  // the latter wherever the stencil stays inside the domain
+  auto linear = [&](size_t lvl) {
+    const CellGrid &grid = hierarchy.grid(lvl);
+    std::vector<double> values(grid.size());
+    for (size_t cell = 0; cell < grid.size(); ++cell) {
+      values[cell] = 1.0 + 2.0 * grid.centers(0)[cell] -
+                     grid.centers(1)[cell] + 0.5 * grid.centers(2)[cell];
+    }
+    return values;
+  };
+  const auto fine = linear(3);
+  const auto exactCoarse = linear(2);
+  std::vector<double> coarse(exactCoarse.size(), 0.0);
+  hierarchy.restrictField<double>(3, fine, coarse);
+  for (size_t cell = 0; cell < coarse.size(); ++cell) {
+    advpt::testing::assert_true(std::abs(coarse[cell] - exactCoarse[cell]) <
+                                1e-12);
+  }
+  std::vector<double> interpolated(fine.size(), 0.0);
+  hierarchy.prolongate<double>(3, coarse, interpolated);
+  const auto &fineGrid = hierarchy.grid(3);
+  for (size_t cell = 0; cell < fine.size(); ++cell) {
+    const auto coords = fineGrid.mortonIndices()[cell].gridCoordinates();
+    const bool inside = std::ranges::all_of(
+        std::array{coords[0], coords[1], coords[2]},
+        [](size_t c) { return c >= 1 && c <= 6; });
+    if (inside) {
+      advpt::testing::assert_true(std::abs(interpolated[cell] - fine[cell]) <
+                                  1e-12);
+    }
+  }
+
+  // Constant interpolation copies the parent, corrections are added
+  hierarchy.prolongate<double>(3, coarse, interpolated,
+                               Prolongation::Constant);
+  std::vector<double> ones(fine.size(), 1.0);
+  const std::vector<double> coarseOnes(coarse.size(), 1.0);
+  hierarchy.addProlongated<double>(3, coarseOnes, ones);
+  for (size_t cell = 0; cell < fine.size(); ++cell) {
+    advpt::testing::assert_equal(interpolated[cell],
+                                 coarse[hierarchy.parents(3)[cell]]);
+    advpt::testing::assert_true(std::abs(ones[cell] - 2.0) < 1e-12);
+  }
+  advpt::testing::throws<std::out_of_range>(
+      [&]() { hierarchy.restrictField<double>(0, fine, coarse); });
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    hierarchy.restrictField<double>(3, std::span{fine}.first(8), coarse);
+  });
+
+  // Refined phantoms become cells, leaves of coarse levels have no children
+  const auto adaptive = std::make_shared<CellOctree>(
+      CellOctree::fromDescriptor("X|R.R.....|................"));
+  const GridHierarchy adaptiveHierarchy(CellGrid::create(adaptive));
+  advpt::testing::assert_equal(adaptiveHierarchy.grid(0).size(), size_t{1});
+  advpt::testing::assert_equal(adaptiveHierarchy.grid(2).size(), size_t{16});
+  size_t refined = 0;
+  for (size_t cell = 0; cell < adaptiveHierarchy.grid(1).size(); ++cell) {
+    const auto missing = std::ranges::count(
+        adaptiveHierarchy.children(1, cell), GridHierarchy::NO_CELL);
+    advpt::testing::assert_true(missing == 0 || missing == 8);
+    refined += missing == 0 ? 1 : 0;
+    advpt::testing::assert_equal(adaptiveHierarchy.parents(1)[cell],
+                                 size_t{0});
+  }
+  advpt::testing::assert_equal(refined, size_t{2});
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testPoissonMultigrid() {
+#if TEST_ADJACENCY
+  // The residual drops by the same factor per cycle on every resolution
+  for (const size_t lvl : {4uz, 5uz}) {
+    for (const auto cycle : {solver::Cycle::V, solver::Cycle::W}) {
+      const GridHierarchy hierarchy(
+          CellGrid::create(CellOctree::createUniformGrid(lvl))
+              .neighborhood(FACES));
+      solver::PoissonMultigrid multigrid(hierarchy, {.cycle = cycle});
+      advpt::testing::assert_equal(multigrid.finestLevel(), lvl);
+      advpt::testing::assert_equal(multigrid.coarsestLevel(), size_t{0});
+
+      const CellGrid &grid = hierarchy.grid(lvl);
+      std::vector<double> u = boundaryOnes(grid);
+      const std::vector<double> f(grid.size(), 0.0);
+      std::vector<double> residual(grid.size());
+      const double initial = multigrid.residual(u, f, residual);
+      for (size_t i = 0; i < 10; ++i) {
+        multigrid.cycle(u, f);
+      }
+      advpt::testing::assert_true(multigrid.residual(u, f, residual) <
+                                  1e-6 * initial);
+    }
+  }
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    const GridHierarchy coarse(
+        CellGrid::create(CellOctree::createUniformGrid(1)).neighborhood(FACES));
+    solver::PoissonMultigrid multigrid(coarse);
+  });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testKrylovSolvers() {
+#if TEST_ADJACENCY
+  const size_t lvl = 4;
+  const GridHierarchy hierarchy(
+      CellGrid::create(CellOctree::createUniformGrid(lvl)).neighborhood(FACES));
+  const CellGrid &grid = hierarchy.grid(lvl);
+  const solver::PoissonOperator op(grid);
+  solver::PoissonMultigrid multigrid(
+      hierarchy, {.prolongation = Prolongation::Constant});
+
+  const std::vector<double> initial = boundaryOnes(grid);
+  const std::vector<double> f(grid.size(), 0.0);
+  std::vector<double> residual(grid.size());
+  const double tolerance = 1e-8 * std::sqrt(op.residual(initial, f, residual));
+
+  solver::IdentityPreconditioner identity;
+  solver::JacobiPreconditioner jacobi(op);
+  solver::SsorPreconditioner ssor(op);
+  solver::MultigridPreconditioner mg(multigrid);
+  std::vector<size_t> cgIterations;
+  for (solver::Preconditioner *preconditioner :
+       std::initializer_list<solver::Preconditioner *>{&identity, &jacobi,
+                                                       &ssor, &mg}) {
+    for (const bool cg : {true, false}) {
+      std::vector<double> u = initial;
+      const solver::KrylovOptions options{.maxIterations = 500,
+                                          .tolerance = tolerance};
+      const auto result =
+          cg ? solver::conjugateGradient(op, u, f, *preconditioner, options)
+             : solver::biCgStab(op, u, f, *preconditioner, options);
+      advpt::testing::assert_true(result.converged);
+      advpt::testing::assert_true(result.residualNorm <= tolerance);
+      // The reported norm is the one of the true residual
+      advpt::testing::assert_true(std::sqrt(op.residual(u, f, residual)) <=
+                                  2.0 * tolerance);
+      for (size_t cell = 0; cell < grid.size(); ++cell) {
+        advpt::testing::assert_true(std::abs(u[cell] - 1.0) < 1e-6);
+      }
+      if (cg) {
+        cgIterations.push_back(result.iterations);
+      }
+    }
+  }
+  // Better preconditioners take fewer iterations
+  advpt::testing::assert_true(cgIterations[2] < cgIterations[0]);
+  advpt::testing::assert_true(cgIterations[3] < cgIterations[2]);
+  advpt::testing::assert_true(cgIterations[3] <= 10);
+
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    std::vector<double> u(grid.size() - 1);
+    static_cast<void>(solver::conjugateGradient(op, u, f, identity));
+  });
+
+  // CG needs <M^-1 x, y> = <x, M^-1 y> for vectors vanishing on the boundary
+  std::vector<double> x(grid.size());
+  std::vector<double> y(grid.size());
+  for (size_t cell = 0; cell < grid.size(); ++cell) {
+    const bool interior = initial[cell] == 0.0;
+    x[cell] = interior ? std::sin(0.7 * static_cast<double>(cell)) : 0.0;
+    y[cell] = interior ? std::cos(1.3 * static_cast<double>(cell)) : 0.0;
+  }
+  const auto inner = [](const std::vector<double> &a,
+                        const std::vector<double> &b) {
+    return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+  };
+  for (const auto cycle : {solver::Cycle::V, solver::Cycle::W}) {
+    solver::PoissonMultigrid symmetric(
+        hierarchy, {.cycle = cycle, .prolongation = Prolongation::Constant});
+    solver::MultigridPreconditioner preconditioner(symmetric);
+    std::vector<double> mx(grid.size());
+    std::vector<double> my(grid.size());
+    preconditioner.apply(x, mx);
+    preconditioner.apply(y, my);
+    const double xMy = inner(x, my);
+    advpt::testing::assert_true(std::abs(inner(mx, y) - xMy) <
+                                1e-10 * std::abs(xMy));
+  }
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testUniformLevel() {
+#if TEST_ADJACENCY
+  for (const Ordering order : {Ordering::Morton, Ordering::RCM}) {
+    const CellGrid grid = CellGrid::create(CellOctree::createUniformGrid(3))
+                              .neighborhood({{1, 0, 0}, {0, 1, 0}, {0, 0, 1}})
+                              .ordering(order)
+                              .build();
+    const auto view = grid.uniformLevel();
+    advpt::testing::assert_true(view.has_value());
+    advpt::testing::assert_equal(view->level(), size_t{3});
+    advpt::testing::assert_equal(view->extent(), size_t{8});
+    advpt::testing::assert_equal(view->size(), grid.size());
+    for (size_t cell = 0; cell < grid.size(); ++cell) {
+      const auto coords = grid.mortonIndices()[cell].gridCoordinates();
+      const size_t denseIdx = view->denseIndex(coords[0], coords[1], coords[2]);
+      advpt::testing::assert_equal(view->denseIndexOf(cell), denseIdx);
+      advpt::testing::assert_equal(view->cell(denseIdx), cell);
+    }
+
+    // Round trip through the dense layout
+    std::vector<double> field(grid.size());
+    std::iota(field.begin(), field.end(), 0.0);
+    std::vector<double> dense(view->size());
+    view->gather<double>(field, dense);
+    advpt::testing::assert_equal(dense[view->denseIndex(1, 2, 3)],
+                                 static_cast<double>(view->cell(
+                                     1 + 8 * (2 + 8 * 3))));
+    std::vector<double> back(grid.size());
+    view->scatter<double>(dense, back);
+    advpt::testing::assert_true(back == field);
+    advpt::testing::throws<std::invalid_argument>([&]() {
+      std::vector<double> tooShort(view->size() - 1);
+      view->gather<double>(field, tooShort);
+    });
+  }
+
+  // Mixed levels and partial levels have no dense view
+  const auto ot = std::make_shared<CellOctree>(
+      CellOctree::fromDescriptor("R|RR......|................"));
+  advpt::testing::assert_false(
+      CellGrid::create(ot).build().uniformLevel().has_value());
+  advpt::testing::assert_false(
+      CellGrid::create(ot).levels({2uz}).build().uniformLevel().has_value());
+  const auto level1 = CellGrid::create(ot).levels({1uz}).build().uniformLevel();
+  advpt::testing::assert_true(level1.has_value());
+  advpt::testing::assert_equal(level1->extent(), size_t{2});
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
+void testDenseJacobiSweep() {
+#if TEST_ADJACENCY
+  // Rows of 9 interior cells leave remainders for every vector width
+  const size_t n = 11;
+  const double h = 0.125;
+  std::vector<double> u(n * n * n);
+  std::vector<double> f(n * n * n);
+  for (size_t i = 0; i < u.size(); ++i) {
+    u[i] = std::sin(0.37 * static_cast<double>(i));
+    f[i] = std::cos(0.11 * static_cast<double>(i));
+  }
+  std::vector<double> uNext(u.size(), -1.0);
+  std::vector<double> residual(u.size(), -1.0);
+  const double sum =
+      solver::denseJacobiSweep(n, h, u, uNext, f, residual);
+
+  double expectedSum = 0.0;
+  const auto at = [&](size_t x, size_t y, size_t z) {
+    return x + (n * (y + (n * z)));
+  };
+  for (size_t z = 0; z < n; ++z) {
+    for (size_t y = 0; y < n; ++y) {
+      for (size_t x = 0; x < n; ++x) {
+        const size_t i = at(x, y, z);
+        if (x == 0 || y == 0 || z == 0 || x == n - 1 || y == n - 1 ||
+            z == n - 1) {
+          advpt::testing::assert_equal(uNext[i], -1.0);
+          advpt::testing::assert_equal(residual[i], -1.0);
+          continue;
+        }
+        const double neighbors = u[at(x - 1, y, z)] + u[at(x + 1, y, z)] +
+                                 u[at(x, y - 1, z)] + u[at(x, y + 1, z)] +
+                                 u[at(x, y, z - 1)] + u[at(x, y, z + 1)];
+        const double r = f[i] + ((neighbors - 6.0 * u[i]) / (h * h));
+        advpt::testing::assert_true(
+            std::abs(uNext[i] - ((h * h * f[i] + neighbors) / 6.0)) < 1e-12);
+        advpt::testing::assert_true(std::abs(residual[i] - r) <
+                                    1e-12 * (1.0 + std::abs(r)));
+        expectedSum += r * r;
+      }
+    }
+  }
+  advpt::testing::assert_true(std::abs(sum - expectedSum) <
+                              1e-12 * expectedSum);
+
+  advpt::testing::assert_equal(
+      solver::denseJacobiSweep(2, h, u, uNext, f, residual), 0.0);
+  advpt::testing::throws<std::invalid_argument>([&]() {
+    static_cast<void>(solver::denseJacobiSweep(
+        n, h, std::span(u).first(u.size() - 1), uNext, f, residual));
+  });
+#else
+  advpt::testing::dont_compile();
+#endif
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
@@ -641,6 +2158,26 @@ int main(int argc, char **argv) {
       {"testNoPeriodicity", &testNoPeriodicity},
       {"testTorus", &testTorus},
       {"testCellsRange", &testCellsRange},
-      {"testCentralDifference", &testCentralDifference}}
+      {"testCentralDifference", &testCentralDifference},
+      {"testCellForest", &testCellForest},
+      {"testPartition", &testPartition},
+      {"testGhostLayer", &testGhostLayer},
+      {"testInterleavedAdjacency", &testInterleavedAdjacency},
+      {"testStencilGrid", &testStencilGrid},
+      {"testLeafAdjacency", &testLeafAdjacency},
+      {"testFieldRegistry", &testFieldRegistry},
+      {"testRcmOrdering", &testRcmOrdering},
+      {"testIncrementalRebuild", &testIncrementalRebuild},
+      {"testGeometryCache", &testGeometryCache},
+      {"testColoring", &testColoring},
+      {"testBoundaryGroups", &testBoundaryGroups},
+      {"testGhostCells", &testGhostCells},
+      {"testPeriodicityPolicies", &testPeriodicityPolicies},
+      {"testGridCache", &testGridCache},
+      {"testGridHierarchy", &testGridHierarchy},
+      {"testPoissonMultigrid", &testPoissonMultigrid},
+      {"testKrylovSolvers", &testKrylovSolvers},
+      {"testUniformLevel", &testUniformLevel},
+      {"testDenseJacobiSweep", &testDenseJacobiSweep}}
       .run(argc, argv);
 }
@@ -5,6 +5,8 @@
 #include "oktal/octree/CellOctree.hpp"
 
 #include <algorithm>
+#include <cstdint>
+#include <vector>
 
 #define TEST_UNIFORM_GRID true
 #define TEST_VTK_EXPORT true
@@ -117,6 +119,48 @@ void testVtkExport() {
       advpt::testing::assert_range_equal(readFloats, expectedFloats);
     }
   }
+
+  {
+    // Renumbered grids write every value onto its own cell
+    const auto ot = std::make_shared<CellOctree>(
+        CellOctree::fromDescriptor("X|XX......|................"));
+    std::vector<std::vector<int64_t>> exported;
+    for (const Ordering order :
+         {Ordering::Morton, Ordering::RCM, Ordering::Multicolor}) {
+      const auto filename = tmpDir / "renumbered.vtkhdf";
+      auto cells = CellGrid::create(ot)
+                       .neighborhood({{1, 0, 0}, {0, 1, 0}, {0, 0, 1}})
+                       .ordering(order)
+                       .build();
+      if (order != Ordering::Morton) {
+        advpt::testing::assert_false(std::ranges::is_sorted(
+            cells.mortonIndices(), {}, &MortonIndex::getBits));
+      }
+      const auto bits = cells.addField<int64_t>("bits");
+      std::ranges::transform(cells.mortonIndices(),
+                             cells.field(bits).begin(),
+                             [](const MortonIndex &idx) {
+                               return static_cast<int64_t>(idx.getBits());
+                             });
+      io::vtk::exportCellGrid(cells, filename).writeFields();
+
+      const HighFive::File h5file =
+          makeH5File(filename, HighFive::File::ReadOnly);
+      h5file.getDataSet("VTKHDF/CellData/bits").read(exported.emplace_back());
+    }
+    advpt::testing::assert_equal(exported[0].size(), 25uz);
+    advpt::testing::assert_range_equal(exported[1], exported[0]);
+    advpt::testing::assert_range_equal(exported[2], exported[0]);
+  }
+
+  {
+    // Fields of other component types are not dropped silently
+    auto cells = CellGrid::create(CellOctree::createUniformGrid(1uz)).build();
+    cells.addField<uint8_t>("flags");
+    advpt::testing::throws<std::invalid_argument>([&]() {
+      io::vtk::exportCellGrid(cells, tmpDir / "flags.vtkhdf").writeFields();
+    });
+  }
 #else
   advpt::testing::dont_compile();
 #endif